@@ -0,0 +1,80 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#ifndef _FWI_BOUNDARY_H_
+#define _FWI_BOUNDARY_H_
+
+#include "fwi_domain.h"
+
+/*
+ * Boundary strips of the forward wavefield, for its reconstruction backwards
+ * in time (RECONSTRUCT propagations).
+ *
+ * Every forward timestep saves the HALO planes next to the outer frame of the
+ * global grid, the ones a stencil reaches from the frame, of every velocity
+ * and stress field. The reconstruction undoes the updates with -dt and puts
+ * the saved strips back, so the cells next to the physical boundary match
+ * the forward run whatever happened there. The strips span the whole local
+ * array along the other axes, ghost cells included: every process restores
+ * the same values its neighbours restore in the cells they own.
+ */
+typedef struct {
+    int      nboxes;
+    box_t    boxes[NFACES];
+    integer  ncells;            /* strip cells of a field                 */
+    integer  dimmz;
+    integer  dimmx;
+    int      nfields;
+    int      steps;             /* saved so far, minus the dropped ones   */
+    int      maxsteps;
+    real    *strips;
+} boundary_t;
+
+void boundary_setup ( boundary_t     *b,
+                      const domain_t *d,
+                      const int       nfields,
+                      const int       maxsteps );
+
+void boundary_release ( boundary_t *b );
+
+/* saves the strips of the 'nfields' fields as the next step */
+void boundary_save ( boundary_t *b,
+                     real       *fields[] );
+
+/* 'fields' get back the saved fields first .. first+n-1 of the last step */
+void boundary_restore ( boundary_t *b,
+                        real       *fields[],
+                        const int   first,
+                        const int   n );
+
+/* the last saved step is not needed anymore */
+void boundary_drop ( boundary_t *b );
+
+#endif /* end of _FWI_BOUNDARY_H_ definition */
@@ -0,0 +1,111 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#ifndef _FWI_CODEC_H_
+#define _FWI_CODEC_H_
+
+#include "fwi_domain.h"
+
+/*
+ * Compression of the snapshot volumes, lossy after the ZFP transform coder:
+ * every block of 4x4x4 cells is put in block floating point with the
+ * exponent of its largest value, decorrelated with an integer lifting
+ * transform along each axis, and its coefficients are coded bit plane by
+ * bit plane, most significant first, with group tests of the ones left.
+ *
+ *   CODEC_RATE       every block takes 'rate' bits per value, so sizes are
+ *                    known in advance (FWI_SNAPSHOT_RATE),
+ *   CODEC_PRECISION  every block keeps 'precision' bit planes, which bounds
+ *                    the error relative to its largest value
+ *                    (FWI_SNAPSHOT_TOLERANCE digits),
+ *   CODEC_LOSSLESS   no block transform: the bytes of the values are
+ *                    shuffled by significance and every stream goes through
+ *                    a fast LZ coder, exact values (FWI_SNAPSHOT_LOSSLESS).
+ *
+ * Blocks are coded in chunks of 4 planes along y, independent of each
+ * other, that are compressed by the OpenMP threads in parallel.
+ */
+typedef enum {
+    CODEC_NONE,
+    CODEC_RATE,
+    CODEC_PRECISION,
+    CODEC_LOSSLESS
+} codec_mode_t;
+
+typedef struct {
+    int mode;
+    int rate;           /* bits per value                      */
+    int precision;      /* bit planes of every block           */
+} codec_t;
+
+/* the codec requested through the environment, 0 when there is none */
+int codec_from_env ( codec_t *codec );
+
+/* bytes a chunk of up to 4 planes of nz x nx cells can take at most */
+size_t codec_chunk_bound ( const codec_t *codec,
+                           const integer  nz,
+                           const integer  nx );
+
+/* codes the cells of a box at most 4 planes thick, returns its bytes */
+size_t codec_encode_chunk ( const codec_t *codec,
+                            const real    *field,
+                            const box_t    b,
+                            const integer  dimmz,
+                            const integer  dimmx,
+                            uint64_t      *stream );
+
+void codec_decode_chunk ( const codec_t  *codec,
+                          const uint64_t *stream,
+                          real           *field,
+                          const box_t     b,
+                          const integer   dimmz,
+                          const integer   dimmx );
+
+/*
+ * Compressed snapshot files. A header with the codec and a table of
+ * sections, one per process, with the box it owns in global cells; every
+ * section holds the sizes of its chunks and the chunks, volume after volume.
+ * Sections are placed at the offsets of their largest size, so processes
+ * write theirs without talking to each other (with CODEC_PRECISION and
+ * CODEC_LOSSLESS the room left is a hole of the file). Readers take the chunks that overlap the
+ * cells they own from every section, whatever decomposition wrote them.
+ */
+void codec_write_volumes ( const codec_t  *codec,
+                           const char     *fname,
+                           real           *fields[],
+                           const integer   nfields,
+                           const domain_t *d );
+
+void codec_read_volumes ( const char     *fname,
+                          real           *fields[],
+                          const integer   nfields,
+                          const domain_t *d );
+
+#endif /* end of _FWI_CODEC_H_ definition */
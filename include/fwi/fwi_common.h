@@ -70,7 +70,7 @@ typedef int    integer;
 #define I "%d"     // integer printf symbol
 
 typedef enum {RTM_KERNEL, FM_KERNEL} propagator_t;
-typedef enum {FORWARD   , BACKWARD, FWMODEL}  time_d;
+typedef enum {FORWARD   , BACKWARD, FWMODEL, RECONSTRUCT}  time_d;
 
 /* simulation parameters */
 extern const integer WRITTEN_FIELDS;
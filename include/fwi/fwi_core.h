@@ -31,10 +31,14 @@
 #define _FWI_CORE_H_
 
 #include "fwi_kernel.h"
+#include "fwi_sched.h"
+#include "fwi_gradient.h"
 
-void kernel( propagator_t propagator, real waveletFreq, int shotid, char* outputfolder, char* shotfolder);
-
-void gather_shots( char* outputfolder, const real waveletFreq, const int nshots, const int numberOfCells );
+/*
+ * RTM shots add their gradient and preconditioner to 'gradient',
+ * forward modelling shots take a NULL one.
+ */
+void kernel( propagator_t propagator, real waveletFreq, int shotid, char* outputfolder, char* shotfolder, gradient_t *gradient);
 
 int execute_simulation( int argc, char* argv[] );
 
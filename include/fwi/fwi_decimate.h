@@ -0,0 +1,71 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#ifndef _FWI_DECIMATE_H_
+#define _FWI_DECIMATE_H_
+
+#include "fwi_domain.h"
+
+/*
+ * Spatially decimated snapshots. The imaging condition only needs the
+ * frequencies of the source, well below the Nyquist limit of the grid, so
+ * the snapshot files can keep one cell out of 'factor' along every axis.
+ *
+ * Coarse cell G of an axis of n fine cells is taken from fine cell
+ * min(G * factor, n - 1), after a smoothing that averages every cell with
+ * its six neighbours (a quarter for the cell, an eighth for each of them)
+ * against the aliasing of what is left above the coarse Nyquist limit. The
+ * fine cells are interpolated back when the snapshot is read, with cubic
+ * polynomials along every axis.
+ * Files hold the global coarse volumes, every process writes the coarse
+ * cells taken from the cells it owns, and reads the ones around its local
+ * box, whatever decomposition wrote them.
+ */
+
+/* the factor requested through the environment, 0 when there is none */
+int decimate_from_env ( integer *factor );
+
+/* coarse cells of an axis of 'n' fine cells */
+integer decimate_coarse_cells ( const integer n,
+                                const integer factor );
+
+void decimate_write_volumes ( const integer   factor,
+                              const char     *fname,
+                              real           *fields[],
+                              const integer   nfields,
+                              const domain_t *d );
+
+void decimate_read_volumes ( const integer   factor,
+                             const char     *fname,
+                             real           *fields[],
+                             const integer   nfields,
+                             const domain_t *d );
+
+#endif /* end of _FWI_DECIMATE_H_ definition */
@@ -0,0 +1,82 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#ifndef _FWI_DFT_H_
+#define _FWI_DFT_H_
+
+#include "fwi_common.h"
+
+/*
+ * Running discrete Fourier transform of a set of fields at a few
+ * frequencies, for an imaging condition in the frequency domain instead of
+ * the snapshots: the forward and the backward propagations add their
+ * velocities every stacki timesteps, weighted by e^(-i w t) dt, and the
+ * zero-lag cross-correlation of both wavefields is taken at the end as
+ * the sum over the frequencies of Re( F(w) conj(B(w)) ).
+ *
+ * The 'nfreqs' frequencies are spread evenly between 0.5 and 1.5 times
+ * the frequency of the wavelet (the frequency itself when there is one).
+ * Memory is 2 x nfreqs volumes per field, whatever the number of timesteps.
+ */
+typedef struct {
+    int      nfreqs;
+    int      nfields;
+    integer  ncells;
+    real     dt;                /* time between two accumulations         */
+    real    *omega;             /* angular frequencies                    */
+    real    *re;                /* nfreqs x nfields volumes               */
+    real    *im;
+} dft_t;
+
+void dft_setup ( dft_t        *dft,
+                 const int     nfreqs,
+                 const real    waveletFreq,
+                 const real    dt,
+                 const int     nfields,
+                 const integer ncells );
+
+void dft_release ( dft_t *dft );
+
+/* adds the fields at 'time' seconds */
+void dft_accumulate ( dft_t *dft,
+                      real  *fields[],
+                      const real time );
+
+/*
+ * Cross-correlation of two transforms of the same fields, summed over the
+ * frequencies, added to nfields volumes of ncells in 'gradient', and the
+ * power of the forward one, |F(w)|^2, added to 'precond'.
+ */
+void dft_image ( const dft_t *forward,
+                 const dft_t *backward,
+                 real        *gradient,
+                 real        *precond );
+
+#endif /* end of _FWI_DFT_H_ definition */
@@ -0,0 +1,235 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+#ifndef _FWI_DOMAIN_H_
+#define _FWI_DOMAIN_H_
+
+#include "fwi_common.h"
+#include "fwi_io.h"
+
+/*
+ * Cartesian decomposition of the grid among the MPI processes.
+ *
+ * The interior cells of the global grid are split along y, y-x or y-x-z
+ * (FWI_DECOMP_DIMS=1,2,3) and every process allocates its part plus HALO
+ * ghost cells at each side of every axis. Ghost cells next to another
+ * process are refreshed through the six faces of the local box; the ones
+ * at the physical boundary keep their initial values, as in a sequential run.
+ */
+
+/* axis and face identifiers, faces are numbered 2*axis + side */
+#define AXIS_Y  0
+#define AXIS_X  1
+#define AXIS_Z  2
+#define NFACES  6
+
+#if defined(USE_MPI)
+#define NO_NEIGHBOUR MPI_PROC_NULL
+#else
+#define NO_NEIGHBOUR (-1)
+#endif
+
+/* region of a local array, [z0,zf) x [x0,xf) x [y0,yf) in local cells */
+typedef struct {
+    integer z0, zf;
+    integer x0, xf;
+    integer y0, yf;
+} box_t;
+
+typedef struct {
+    integer gdimmz, gdimmx, gdimmy;  /* global grid, outer HALO cells included */
+    integer dimmz, dimmx, dimmy;     /* local grid, ghost cells included       */
+    integer z0, x0, y0;              /* global coordinates of local cell 0     */
+
+    int     rank;
+    int     nranks;
+    int     dims      [3];           /* processes along y, x and z             */
+    int     coords    [3];
+    int     neighbours[NFACES];      /* NO_NEIGHBOUR at the physical boundary  */
+    box_t  *owners;                  /* domain_owned_box of every process, in
+                                        global cells                           */
+
+#if defined(USE_MPI)
+    MPI_Comm comm;                   /* cartesian communicator                 */
+#endif
+} domain_t;
+
+#if defined(USE_MPI)
+/*
+ * Processes the grid is decomposed among (MPI_COMM_WORLD unless the shots
+ * are distributed among groups of processes).
+ */
+void domain_set_parent ( MPI_Comm comm );
+#endif
+
+void domain_setup ( domain_t     *d,
+                    const integer dimmz,
+                    const integer dimmx,
+                    const integer dimmy );
+
+/*
+ * Same decomposition, ignoring the y ranges chosen by domain_rebalance:
+ * for buffers that outlive a shot and have to line up with the ones of
+ * other groups of processes.
+ */
+void domain_setup_even ( domain_t     *d,
+                         const integer dimmz,
+                         const integer dimmx,
+                         const integer dimmy );
+
+void domain_release ( domain_t *d );
+
+/*
+ * Busy time of a process (its updates, not the communication it could not
+ * hide) over the first 'steps' timesteps of a propagation. It is the input
+ * of the load balancing of the y decomposition.
+ */
+typedef struct {
+    int    steps;
+    int    measured;
+    double seconds;
+} throughput_t;
+
+/*
+ * Recomputes the y planes of every process row from the measured
+ * throughput, the slowest process of a row setting its pace. Returns 1
+ * when the new ranges are worth it: domain_setup uses them from then on
+ * (for grids of the same size) and the fields of the current domain have
+ * to be moved with domain_migrate. Returns 0 otherwise, and in builds
+ * without MPI.
+ */
+int domain_rebalance ( const domain_t     *d,
+                       const throughput_t *throughput );
+
+/*
+ * Splits 'interior' planes among 'n' rows proportionally to their rates,
+ * with at least 2*HALO planes per row.
+ */
+void domain_balance_planes ( const integer interior,
+                             const int     n,
+                             const double *rates,
+                             integer      *planes );
+
+/*
+ * Moves the local planes of a set of fields from a domain to another one
+ * that only differs in its y ranges. Every process receives all its new
+ * planes, ghost planes included, from the processes that owned them.
+ */
+void domain_migrate ( const domain_t *from,
+                      const domain_t *to,
+                      real           *src[],
+                      real           *dst[],
+                      const integer   nfields );
+
+integer domain_local_cells ( const domain_t *d );
+
+/* the whole local array, ghost cells included */
+box_t domain_local_box ( const domain_t *d );
+
+/*
+ * Cells written by this process to a global file: its interior plus the
+ * outer HALO cells when it touches the physical boundary.
+ */
+box_t domain_owned_box ( const domain_t *d );
+
+/*
+ * Cells sent through a face and ghost cells refreshed through it, limited
+ * to the given number of planes (at most HALO) next to the interior.
+ */
+void domain_face_boxes ( const domain_t *d,
+                         const int       face,
+                         const integer   send_planes,
+                         const integer   recv_planes,
+                         box_t          *send,
+                         box_t          *recv );
+
+/*
+ * Splits the computational box in the HALO-wide slabs that are sent to a
+ * neighbour and the interior that can be computed while they are in flight.
+ * Slabs along y are always peeled (phases ONE_L/ONE_R); along x and z only
+ * when the axis is decomposed. Returns the number of slabs, ordered by face.
+ */
+int domain_split_box ( const domain_t *d,
+                       const box_t     box,
+                       box_t           slabs[NFACES],
+                       box_t          *interior );
+
+integer box_cells ( const box_t b );
+
+integer pack_box ( real* restrict       buffer,
+                   const real* restrict field,
+                   const box_t          b,
+                   const integer        dimmz,
+                   const integer        dimmx );
+
+integer unpack_box ( real* restrict       field,
+                     const real* restrict buffer,
+                     const box_t          b,
+                     const integer        dimmz,
+                     const integer        dimmx );
+
+/*
+ * Transfers a box of a local field from/to the 'volume'-th global volume
+ * stored in a file. Runs of cells contiguous in the file are moved at once.
+ */
+void domain_write_box ( io_file_t      *file,
+                        const integer   volume,
+                        const real     *field,
+                        const domain_t *d,
+                        const box_t     b );
+
+void domain_read_box ( io_file_t      *file,
+                       const integer   volume,
+                       real           *field,
+                       const domain_t *d,
+                       const box_t     b );
+
+#if defined(USE_MPI)
+/*
+ * Collective counterparts of domain_write_box/domain_read_box through
+ * MPI-IO, for the first 'nfields' volumes of a file. Every process sets a
+ * file view selecting its box of all the volumes and issues a single
+ * MPI_File_write_at_all/read_at_all straight from the fields, so the
+ * collective buffering aggregators can merge the accesses of the whole
+ * communicator. FWI_MPIIO_AGGREGATORS sets the number of aggregators.
+ */
+void domain_write_volumes ( const char     *fname,
+                            real           *fields[],
+                            const integer   nfields,
+                            const domain_t *d,
+                            const box_t     b );
+
+void domain_read_volumes ( const char     *fname,
+                           real           *fields[],
+                           const integer   nfields,
+                           const domain_t *d,
+                           const box_t     b );
+#endif
+
+#endif /* end of _FWI_DOMAIN_H_ definition */
@@ -0,0 +1,100 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#ifndef _FWI_GRADIENT_H_
+#define _FWI_GRADIENT_H_
+
+#include "fwi_domain.h"
+#include "fwi_sched.h"
+
+/*
+ * Gradient and preconditioner of a round of shots.
+ *
+ * The volumes of every shot are added in memory to the ones of the previous
+ * shots of the group, in an even decomposition of the grid (the same for all
+ * the groups, whatever y ranges the shots ran with). At the end of the round
+ * the processes at the same position of every group sum their volumes with a
+ * non-blocking MPI_Ireduce into the first group, which writes them once, as
+ * global volumes, while the next round is already propagating its shots.
+ */
+typedef struct {
+    domain_t domain;            /* even decomposition of the volumes      */
+    integer  ncells;            /* local cells of every volume            */
+    real    *gradient;          /* WRITTEN_FIELDS volumes                 */
+    real    *precond;           /* WRITTEN_FIELDS volumes                 */
+    int      shots;             /* accumulated by the group               */
+    int      total;             /* of every group, once reduced           */
+    int      reducing;
+    int      written;
+    char     fgradient[300];
+    char     fprecond [300];
+
+#if defined(USE_MPI)
+    MPI_Comm    cross;          /* same position in every group           */
+    MPI_Request requests[3];
+#endif
+} gradient_t;
+
+void gradient_setup ( gradient_t    *g,
+                      const sched_t *sched,
+                      const integer  dimmz,
+                      const integer  dimmx,
+                      const integer  dimmy,
+                      const char    *outputfolder,
+                      const real     waveletFreq );
+
+/*
+ * Adds the volumes of a shot, laid out as the local cells of 'domain',
+ * to the accumulated ones. Collective over the processes of the group.
+ */
+void gradient_accumulate ( gradient_t     *g,
+                           const domain_t *domain,
+                           real           *gradient,
+                           real           *precond );
+
+/* starts the reduction among groups: no more shots can be accumulated */
+void gradient_reduce ( gradient_t *g );
+
+/* lets the reduction progress, and writes the volumes when it is over */
+void gradient_progress ( gradient_t *g );
+
+/* waits for the reduction, writes the volumes and releases the buffers */
+void gradient_finish ( gradient_t *g );
+
+/*
+ * Writes WRITTEN_FIELDS volumes, laid out as the local cells of 'domain',
+ * as global volumes: every process writes the cells it owns. With
+ * FWI_GRADIENT_LOSSLESS they go through the lossless codec (fwi_codec.h).
+ */
+void gradient_write_volumes ( const char     *fname,
+                              real           *volumes,
+                              const domain_t *domain );
+
+#endif /* end of _FWI_GRADIENT_H_ definition */
@@ -0,0 +1,137 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+#ifndef _FWI_HALO_H_
+#define _FWI_HALO_H_
+
+#include "fwi_domain.h"
+#include "fwi_propagator.h"
+
+/*
+ * Ways of moving the halo of a face, selected at runtime through
+ * FWI_HALO_TRANSPORT.
+ */
+typedef enum {
+    HALO_TWO_SIDED = 0,     /* persistent send/receive pairs              */
+    HALO_SHARED    = 1,     /* on-node neighbours through MPI-3 shared    */
+                            /* memory windows, messages across nodes      */
+    HALO_ONE_SIDED = 2      /* MPI_Put into the neighbours' receive       */
+                            /* buffers, post-start-complete-wait epochs   */
+} halo_transport_t;
+
+/*
+ * Halo exchange engine for a set of fields sharing the same local domain.
+ *
+ * All the fields going to a neighbour are packed, face after face, into a
+ * single contiguous buffer, so a step costs one message pair per neighbour
+ * instead of one per field. Each face is sent as soon as it is packed, and
+ * received faces are unpacked in arrival order.
+ *
+ * Buffers never change during a propagation, so the messages are set up
+ * once as persistent requests and every step just restarts them.
+ *
+ * Only the ghost planes the stencils actually read are moved: each field
+ * gets, through each face, the number of planes derived from the stencil
+ * reads of the propagator that consumes it (halo_depths). Fields never
+ * differentiated along an axis do not travel along it at all.
+ *
+ * With the shared transport, faces whose neighbour lives on the same node
+ * are packed straight into a shared memory window, and the neighbour
+ * unpacks them from there: no message and no intermediate copy. Those
+ * buffers are doubled and used alternately, so one fence per exchange is
+ * enough to order the writer and its readers.
+ *
+ * With the one-sided transport, the receive buffers of all the faces are
+ * exposed as a window and every neighbour puts its packed faces into it.
+ * Epochs are opened only towards the neighbours (MPI_Win_post/start), so
+ * no process synchronises with anybody else.
+ */
+typedef struct {
+    const domain_t *domain;
+    integer         nfields;
+    real          **fields;
+    int             transport;
+
+    box_t          *send[NFACES];       /* per field, cells sent through face */
+    box_t          *recv[NFACES];       /* per field, ghosts refreshed by it  */
+    integer         sendcount[NFACES];  /* elements per message, all fields   */
+    integer         recvcount[NFACES];
+    real           *sendbuf[NFACES];
+    real           *recvbuf[NFACES];
+
+    int             nfaces;             /* faces served by messages or puts   */
+    int             faces[NFACES];
+    int             nshared;            /* faces served by shared memory      */
+    int             shared[NFACES];
+    int             parity;             /* shared buffer of this exchange     */
+
+#if defined(USE_MPI)
+    MPI_Request     sendreq[NFACES];    /* persistent, indexed as 'faces'     */
+    MPI_Request     recvreq[NFACES];
+
+    MPI_Comm        node;               /* ranks sharing memory with this one */
+    MPI_Win         win;
+    real           *shared_send[NFACES];/* two buffers in the local segment   */
+    real           *shared_recv[NFACES];/* two buffers in the neighbour's one */
+
+    MPI_Group       group;              /* neighbours, for the RMA epochs     */
+    MPI_Aint        remote[NFACES];     /* where our puts land, per face      */
+#endif
+} halo_t;
+
+const char* halo_transport_name ( const int transport );
+
+/*
+ * Ghost planes of every field read through each face by the given stencil
+ * reads: at most HALO on one side of the axis and HALO-1 on the other.
+ */
+void halo_depths ( const stencil_read_t  reads[],
+                   const integer         nreads,
+                   real                 *fields[],
+                   const integer         nfields,
+                   integer               depth[][NFACES] );
+
+/* a NULL depth exchanges the full HALO of every field */
+void halo_setup ( halo_t         *halo,
+                  const domain_t *domain,
+                  real           *fields[],
+                  const integer (*depth)[NFACES],
+                  const integer   nfields );
+
+void halo_release ( halo_t *halo );
+
+/* posts the receives, then packs and sends every face */
+void halo_start ( halo_t *halo );
+
+/* unpacks the faces as they arrive and completes the sends */
+void halo_wait ( halo_t *halo );
+
+void halo_exchange ( halo_t *halo );
+
+#endif /* end of _FWI_HALO_H_ definition */
@@ -0,0 +1,73 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#ifndef _FWI_IMAGING_H_
+#define _FWI_IMAGING_H_
+
+#include "fwi_common.h"
+
+/*
+ * Imaging condition of a shot, computed by the backward propagation every
+ * stacki timesteps, as it meets the forward wavefield of the same time:
+ *
+ *   gradient += forward * backward * dt   (zero-lag cross-correlation)
+ *   precond  += forward * forward  * dt   (illumination of the source)
+ *
+ * field by field, one volume of each per field. Both are updated by blocks
+ * of cells, one field after the other, while the block is in cache. The
+ * forward fields are either read from the snapshots into a buffer of the
+ * imaging or kept by the caller, which then gives them at setup.
+ */
+typedef struct {
+    int      nfields;
+    integer  ncells;
+    real     dt;                /* time between two correlations          */
+    real    *gradient;          /* nfields volumes, of the caller         */
+    real    *precond;           /* nfields volumes, of the caller         */
+    real    *buffer;            /* forward fields read from the snapshots */
+    real   **forward;
+} imaging_t;
+
+/* 'forward' are the fields of the caller, NULL to have them in a buffer */
+void imaging_setup ( imaging_t     *im,
+                     const int      nfields,
+                     const integer  ncells,
+                     const real     dt,
+                     real          *gradient,
+                     real          *precond,
+                     real          *forward[] );
+
+void imaging_release ( imaging_t *im );
+
+/* correlates the backward fields with the forward ones */
+void imaging_accumulate ( imaging_t *im,
+                          real      *backward[] );
+
+#endif /* end of _FWI_IMAGING_H_ definition */
@@ -0,0 +1,124 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#ifndef _FWI_IO_H_
+#define _FWI_IO_H_
+
+#include "fwi_common.h"
+
+/*
+ * Bulk file traffic (model, snapshots, gradients) goes through one of these
+ * backends, chosen at run time with FWI_IO_BACKEND:
+ *
+ *   IO_STDIO   buffered stdio streams, fseeko and fwrite/fread (0),
+ *   IO_POSIX   pwrite/pread on a file descriptor, no user space copy (1),
+ *   IO_DIRECT  O_DIRECT: the aligned part of every transfer bypasses the
+ *              page cache through an aligned staging buffer, its unaligned
+ *              ends go through pwrite/pread (2),
+ *   IO_NULL    nothing is stored: writes are dropped and reads give zeros,
+ *              to time a run without its storage (3).
+ *
+ * Builds with DO_NOT_PERFORM_IO always use IO_NULL. The bytes, requests and
+ * seconds of every backend are counted for io_stats_report.
+ */
+typedef enum {
+    IO_STDIO,
+    IO_POSIX,
+    IO_DIRECT,
+    IO_NULL,
+    IO_BACKENDS
+} io_backend_t;
+
+#define IO_DIRECT_ALIGN  4096
+#define IO_DIRECT_BUFFER (4 * 1024 * 1024)
+
+typedef struct {
+    int      backend;
+    int      write;
+    FILE    *stream;            /* IO_STDIO                               */
+    int      fd;                /* IO_POSIX, unaligned ends of IO_DIRECT  */
+    int      direct;            /* IO_DIRECT, -1 when it is not supported */
+    char    *buffer;            /* IO_DIRECT staging buffer               */
+    char     fname[400];
+} io_file_t;
+
+typedef struct {
+    double  written;            /* bytes                                  */
+    double  read;
+    double  twrite;             /* seconds                                */
+    double  tread;
+    long    writes;             /* requests                               */
+    long    reads;
+} io_stats_t;
+
+/* the backend requested through the environment */
+io_backend_t io_backend ( void );
+
+const char* io_backend_name ( const int backend );
+
+/*
+ * Opens 'fname' with the backend of the environment. For writing, the file
+ * is created if needed and resized to 'size' bytes, never truncated, so
+ * several processes can fill it at disjoint offsets.
+ */
+void io_open ( io_file_t    *f,
+               const char   *fname,
+               const int     write,
+               const size_t  size );
+
+/* same, with a given backend */
+void io_open_backend ( io_file_t   *f,
+                       const int    backend,
+                       const char  *fname,
+                       const int    write,
+                       const size_t size );
+
+void io_close ( io_file_t *f );
+
+void io_write ( io_file_t     *f,
+                const void    *ptr,
+                const size_t   bytes,
+                const int64_t  offset );
+
+void io_read ( io_file_t    *f,
+               void         *ptr,
+               const size_t  bytes,
+               const int64_t offset );
+
+/* the file will be read from the beginning to the end */
+void io_sequential ( io_file_t *f );
+
+/* traffic of a backend so far, in this process */
+void io_stats ( const int backend, io_stats_t *stats );
+
+/* logs the traffic and throughput of every backend used */
+void io_stats_report ( void );
+
+#endif /* end of _FWI_IO_H_ definition */
@@ -31,6 +31,11 @@
 #define _FWI_KERNEL_H_
 
 #include "fwi_propagator.h"
+#include "fwi_domain.h"
+#include "fwi_snapshot.h"
+#include "fwi_boundary.h"
+#include "fwi_dft.h"
+#include "fwi_imaging.h"
 
 /*
  * Ensures that the domain contains a minimum number of planes.
@@ -64,120 +69,197 @@ void check_memory_shot( const integer numberOfCells,
                         v_t     *v,
                         real    *rho);
 
+/*
+ * Flat views of the field structures, in a fixed order, for the code
+ * that has to walk over every array (halo copies, packing, ...).
+ */
+#define VELOCITY_FIELDS 12
+#define STRESS_FIELDS   24
+#define COEFF_FIELDS    21
+
+void velocity_field_list ( v_t     *v, real* fields[VELOCITY_FIELDS] );
+void stress_field_list   ( s_t     *s, real* fields[STRESS_FIELDS]   );
+void coeff_field_list    ( coeff_t *c, real* fields[COEFF_FIELDS]    );
+
 /* --------------- I/O RELATED FUNCTIONS -------------------------------------- */
 
-void load_initial_model ( const real    waveletFreq,
-                          const integer dimmz,
-                          const integer dimmx,
-                          const integer dimmy,
-                          coeff_t *c,
-                          s_t     *s,
-                          v_t     *v,
-                          real    *rho);
-
-void write_snapshot ( char         *folder,
-                      const int     suffix,
-                      v_t          *v,
-                      const integer dimmz,
-                      const integer dimmx,
-                      const integer dimmy);
-
-void read_snapshot ( char         *folder,
-                     const int     suffix,
-                     v_t          *v,
-                     const integer dimmz,
-                     const integer dimmx,
-                     const integer dimmy);
+/*
+ * Files hold global volumes: every process reads (and writes) the
+ * cells of its local domain at their global position.
+ */
+void load_initial_model ( const real      waveletFreq,
+                          const domain_t *domain,
+                          coeff_t        *c,
+                          s_t            *s,
+                          v_t            *v,
+                          real           *rho);
+
+/* zero stresses and the initial velocities, where the backward propagation starts */
+void load_initial_wavefield ( const real      waveletFreq,
+                              const domain_t *domain,
+                              s_t            *s,
+                              v_t            *v);
+
+/*
+ * Random boundary for the RTM without snapshots: the stiffness of the cells
+ * within 'width' cells of the outer frame of the global grid is scaled so
+ * that their velocity drops by a random fraction of up to
+ * RANDOM_BOUNDARY_AMPLITUDE, growing towards the frame. The waves that reach
+ * it are scattered instead of reflected coherently, and the propagation is
+ * still reversible in time. The values depend only on the global position
+ * of the cells.
+ */
+#define RANDOM_BOUNDARY_AMPLITUDE 0.5f
+
+void random_boundary_layer ( const domain_t *domain,
+                             coeff_t        *c,
+                             const integer   width );
+
+void write_snapshot ( char           *folder,
+                      const int       suffix,
+                      real           *fields[VELOCITY_FIELDS],
+                      const domain_t *domain);
+
+void read_snapshot ( char           *folder,
+                     const int       suffix,
+                     real           *fields[VELOCITY_FIELDS],
+                     const domain_t *domain);
 
 
 /* --------------- WAVE PROPAGATOR FUNCTIONS --------------------------------- */
 
-void propagate_shot ( time_d        direction,
-                     v_t           v,
-                     s_t           s,
-                     coeff_t       coeffs,
-                     real          *rho,
-                     int           timesteps,
-                     int           ntbwd,
-                     real          dt,
-                     real          dzi,
-                     real          dxi,
-                     real          dyi,
-                     integer       nz0,
-                     integer       nzf,
-                     integer       nx0,
-                     integer       nxf,
-                     integer       ny0,
-                     integer       nyf,
-                     integer       stacki,
-                     char          *folder,
-                     real          *dataflush,
-                     integer       datalen,
-                     integer       dimmz,
-                     integer       dimmx);
-
-
-/* --------------- BOUNDARY EXCHANGES ---------------------------------------- */
+/*
+ * Integration limits are given in local cells, the local extents of the
+ * arrays are taken from the domain. Velocities are taken at the beginning of
+ * every interval of stacki timesteps, and the backward propagation meets the
+ * forward one in reverse order: its timestep t with the forward timestep
+ * tlast-t, tlast being the beginning of the last interval. The forward
+ * propagation puts its snapshots in 'snapshots', with the timestep as suffix,
+ * none when it is NULL. The backward one computes the imaging condition of
+ * 'imaging' when it is not NULL, with the forward velocities it gets back
+ * from 'snapshots', or that the caller has put in place when it is NULL. The
+ * velocities are added to the running transform 'dft', at the time of the
+ * forward timestep, when it is not NULL. The busy time of the first
+ * timesteps is added to 'throughput' when it is not NULL. With a 'boundary',
+ * the forward propagation saves its strips every timestep and RECONSTRUCT
+ * runs it back in time with them, without them when it is NULL.
+ */
+void propagate_shot ( time_d          direction,
+                      v_t             v,
+                      s_t             s,
+                      coeff_t         coeffs,
+                      real           *rho,
+                      int             timesteps,
+                      int             ntbwd,
+                      real            dt,
+                      real            dzi,
+                      real            dxi,
+                      real            dyi,
+                      integer         nz0,
+                      integer         nzf,
+                      integer         nx0,
+                      integer         nxf,
+                      integer         ny0,
+                      integer         nyf,
+                      integer         stacki,
+                      snapshots_t    *snapshots,
+                      real           *dataflush,
+                      const domain_t *domain,
+                      throughput_t   *throughput,
+                      boundary_t     *boundary,
+                      dft_t          *dft,
+                      imaging_t      *imaging);
 
 /*
-NAME:exchange_boundaries
-PURPOSE: data exchanges between the boundary layers of the analyzed volume
-
-v                   (in) struct containing velocity arrays (4 points / cell x 3 components / point = 12 arrays)
-numElement          (in) Number of elements to exchange
-rank                (in) MPI process identifier
-numTasks            (in) MPI number of tasks
-idxt                (in) identifier related to the folder
-nyf                 (in) final plane to be exchanged
-ny0                 (in) intial plane to be exchanged
-
-RETURN none
-*/
-
-#if defined(USE_MPI)
-#define EXCHANGE(sendbuf, recvbuf, dst, src, count) {                             \
-    exchange_buffer((sendbuf),(recvbuf),(dst),(src),(count), __FILE__, __LINE__); \
-}                                                                                 
-static inline integer exchange_buffer (const real*   sendbuf, 
-                                             real*   recvbuf, 
-                                       const integer dst, 
-                                       const integer src, 
-                                       const integer message_size,
-                                       const char*   file,
-                                       const integer line)
-{
-    int err;
-    int tag = 100;
-    
-    print_debug( "         [BEFORE]MPI sendrecv [count:%d][dst:%d][src:%d] %s : %d", message_size,  dst, src, file, line);
-
-    MPI_Status  statuses[2];
-    MPI_Request requests[2];
-
-    {
-        MPI_Irecv( recvbuf, message_size, MPI_FLOAT, dst, tag, MPI_COMM_WORLD, &requests[0] );
-        MPI_Isend( sendbuf, message_size, MPI_FLOAT, dst, tag, MPI_COMM_WORLD, &requests[1] );
-    }
-
-    err = MPI_Waitall(2, requests, statuses);
-
-    print_debug( "         [AFTER ]MPI sendrecv                          %s : %d", file, line);
-    
-    return err;
-};
-
-void exchange_velocity_boundaries ( v_t v, 
-                                    const integer plane_size, 
-                                    const integer nyf, 
-                                    const integer ny0 );
-
-void exchange_stress_boundaries ( s_t s, 
-                                  const integer plane_size, 
-                                  const integer nyf, 
-                                  const integer ny0 );
-#else
-#define EXCHANGE(sendbuf, recvbuf, dst, src, count)
-#endif
+ * RTM of a shot without snapshots: the backward propagation needs the forward
+ * velocities of every interval of stacki timesteps in reverse order, and gets
+ * them from a forward wavefield that is recomputed from 'nslots' checkpoints
+ * in memory (see fwi_revolve.h). The imaging condition is added to
+ * 'gradient' and 'precond' (see fwi_imaging.h), a volume per velocity field.
+ * The other arguments are those of propagate_shot.
+ */
+void revolve_shot ( v_t             v,
+                    s_t             s,
+                    coeff_t         coeffs,
+                    real           *rho,
+                    int             timesteps,
+                    int             ntbwd,
+                    real            dt,
+                    real            dzi,
+                    real            dxi,
+                    real            dyi,
+                    integer         nz0,
+                    integer         nzf,
+                    integer         nx0,
+                    integer         nxf,
+                    integer         ny0,
+                    integer         nyf,
+                    integer         stacki,
+                    int             nslots,
+                    real           *gradient,
+                    real           *precond,
+                    const domain_t *domain);
+
+/*
+ * RTM of a shot without snapshots either: the forward propagation keeps its
+ * final state, and the forward wavefield is run back in time, one interval
+ * ahead of the backward propagation, to give it the velocities it needs.
+ * With 'strips', the boundary strips of every timestep are saved and put
+ * back (see fwi_boundary.h). Without them, the model is expected to have a
+ * random boundary layer (see random_boundary_layer). The imaging condition
+ * goes to 'gradient' and 'precond', as in revolve_shot.
+ */
+void reconstruct_shot ( v_t             v,
+                        s_t             s,
+                        coeff_t         coeffs,
+                        real           *rho,
+                        int             timesteps,
+                        int             ntbwd,
+                        real            dt,
+                        real            dzi,
+                        real            dxi,
+                        real            dyi,
+                        integer         nz0,
+                        integer         nzf,
+                        integer         nx0,
+                        integer         nxf,
+                        integer         ny0,
+                        integer         nyf,
+                        integer         stacki,
+                        const int       strips,
+                        real           *gradient,
+                        real           *precond,
+                        const domain_t *domain);
+
+/*
+ * RTM of a shot in the frequency domain: the forward and backward
+ * propagations keep a running transform of their velocities at 'nfreqs'
+ * frequencies around waveletFreq (see fwi_dft.h) instead of snapshots. Their
+ * cross-correlation is added to 'gradient' and the power of the forward one
+ * to 'precond', a volume per velocity field.
+ */
+void dft_shot ( v_t             v,
+                s_t             s,
+                coeff_t         coeffs,
+                real           *rho,
+                int             timesteps,
+                int             ntbwd,
+                real            dt,
+                real            dzi,
+                real            dxi,
+                real            dyi,
+                integer         nz0,
+                integer         nzf,
+                integer         nx0,
+                integer         nxf,
+                integer         ny0,
+                integer         nyf,
+                integer         stacki,
+                const int       nfreqs,
+                const real      waveletFreq,
+                real           *gradient,
+                real           *precond,
+                const domain_t *domain);
 
 
 #endif /* end of _FWI_KERNEL_H_ definition */
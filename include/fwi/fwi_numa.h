@@ -0,0 +1,107 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+#ifndef _FWI_NUMA_H_
+#define _FWI_NUMA_H_
+
+#include "fwi_kernel.h"
+
+/*
+ * Intra-process decomposition of the y-range: one sub-domain per NUMA node.
+ *
+ * Every sub-domain owns private copies of the fields, first-touched by the
+ * thread team pinned to its node, surrounded by HALO ghost planes on each
+ * side. Ghost planes are refreshed with memcpy after every velocity/stress
+ * update, so the stencils never load planes living on a remote socket.
+ */
+typedef struct {
+    integer  y0;        /* first process plane mapped (ghost planes included) */
+    integer  nplanes;   /* number of planes, including 2*HALO ghost planes     */
+    integer  nthreads;  /* size of the thread team working on the sub-domain   */
+    v_t      v;
+    s_t      s;
+    coeff_t  c;
+    real    *rho;
+} numa_domain_t;
+
+typedef struct {
+    integer        ndomains;
+    integer        dimmz;
+    integer        dimmx;
+    numa_domain_t *domains;
+    double         thalo;   /* accumulated halo copy time (seconds) */
+} numa_t;
+
+/*
+ * Number of NUMA sub-domains requested. FWI_NUMA_DOMAINS takes precedence,
+ * otherwise the number of nodes exported by the kernel (OpenMP builds only).
+ * Always one in MPI builds.
+ */
+integer numa_get_num_domains ( void );
+
+numa_t* numa_setup ( v_t           v,
+                     s_t           s,
+                     coeff_t       coeffs,
+                     real         *rho,
+                     const integer ny0,
+                     const integer nyf,
+                     const integer dimmz,
+                     const integer dimmx,
+                     const integer ndomains );
+
+void numa_release ( numa_t *numa );
+
+void numa_scatter_velocity ( numa_t *numa, v_t v );
+void numa_gather_velocity  ( numa_t *numa, v_t v );
+void numa_gather_stress    ( numa_t *numa, s_t s );
+
+void numa_velocity_propagator ( numa_t       *numa,
+                                const real    dt,
+                                const real    dzi,
+                                const real    dxi,
+                                const real    dyi,
+                                const integer nz0,
+                                const integer nzf,
+                                const integer nx0,
+                                const integer nxf );
+
+void numa_stress_propagator ( numa_t       *numa,
+                              const real    dt,
+                              const real    dzi,
+                              const real    dxi,
+                              const real    dyi,
+                              const integer nz0,
+                              const integer nzf,
+                              const integer nx0,
+                              const integer nxf );
+
+void numa_exchange_velocity_halos ( numa_t *numa );
+void numa_exchange_stress_halos   ( numa_t *numa );
+
+#endif /* end of _FWI_NUMA_H_ definition */
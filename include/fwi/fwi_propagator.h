@@ -401,6 +401,26 @@ void stress_propagator(s_t           s,
                        const integer dimmx,
                        const phase_t phase );
 
+/*
+ * Every stencil_Z/X/Y applied by a propagator: the field it reads, along
+ * which axis (AXIS_Z, AXIS_X or AXIS_Y of fwi_domain.h) and with which
+ * offset. Halo exchanges only move the ghost planes these reads reach,
+ * so the lists must follow any change in the calls of the propagators.
+ */
+typedef struct {
+    const real *field;
+    int         axis;
+    offset_t    offset;
+} stencil_read_t;
+
+#define PROPAGATOR_STENCIL_READS 36
+
+/* stress fields read by velocity_propagator */
+void velocity_propagator_reads ( s_t s, stencil_read_t reads[PROPAGATOR_STENCIL_READS] );
+
+/* velocity fields read by stress_propagator */
+void stress_propagator_reads   ( v_t v, stencil_read_t reads[PROPAGATOR_STENCIL_READS] );
+
 real cell_coeff_BR ( const real* restrict ptr, 
                      const integer z, 
                      const integer x, 
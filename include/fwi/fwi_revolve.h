@@ -0,0 +1,78 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#ifndef _FWI_REVOLVE_H_
+#define _FWI_REVOLVE_H_
+
+#include "fwi_common.h"
+
+/*
+ * Binomial checkpointing (Griewank's Revolve) of the forward propagation.
+ *
+ * The forward wavefield is needed at the beginning of 'nsteps' intervals of
+ * stacki timesteps, in reverse order. Instead of storing all of them, the
+ * schedule keeps 'nslots' checkpoints of the whole forward state (slot 0 holds
+ * the initial one) and recomputes the intervals in between. With s free slots
+ * and every interval computed at most r times, the schedule reverses up to
+ * C(s+r+1, s+1) intervals; the split points are chosen so that the number of
+ * recomputed intervals is the minimum for the given budget.
+ */
+typedef enum {
+    REVOLVE_ADVANCE,    /* forward state from 'from' to 'to'                  */
+    REVOLVE_TAKESHOT,   /* copies the forward state 'from' into 'slot'        */
+    REVOLVE_RESTORE,    /* forward state 'from' comes back from 'slot'        */
+    REVOLVE_REVERSE     /* backward interval that needs the forward state 'from' */
+} revolve_kind_t;
+
+typedef struct {
+    revolve_kind_t kind;
+    int            from;
+    int            to;
+    int            slot;
+} revolve_action_t;
+
+typedef struct {
+    int               nsteps;
+    int               nslots;
+    int               nactions;
+    int               maxactions;
+    revolve_action_t *actions;
+    int               advances;     /* intervals computed by the forward state  */
+    int               repetitions;  /* most times an interval is computed       */
+} revolve_t;
+
+/* builds the schedule, 'nslots' must be 1 or more */
+void revolve_setup ( revolve_t *r,
+                     const int  nsteps,
+                     const int  nslots );
+
+void revolve_release ( revolve_t *r );
+
+#endif /* end of _FWI_REVOLVE_H_ definition */
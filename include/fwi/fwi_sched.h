@@ -0,0 +1,86 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+#ifndef _FWI_SCHED_H_
+#define _FWI_SCHED_H_
+
+#include "fwi_common.h"
+
+/*
+ * Shot-level parallelism.
+ *
+ * MPI_COMM_WORLD is split in groups of FWI_GROUP_SIZE consecutive processes,
+ * each one decomposing the grid of the shots it takes among its members.
+ * Shots are handed out on demand: the first process of a group fetches and
+ * increments a counter exposed by rank 0 (MPI_Fetch_and_op) and broadcasts
+ * the shot to the rest of the group, so faster groups take more shots.
+ */
+
+/* source position of a shot, in meters */
+typedef struct {
+    real z, x, y;
+} shot_t;
+
+typedef struct {
+    int      nshots;
+    shot_t  *shots;
+
+    int      group;             /* group of this process                  */
+    int      ngroups;
+    int      leader;            /* first process of its group             */
+    int      taken;             /* shots taken by the group in the round  */
+
+#if defined(USE_MPI)
+    MPI_Comm comm;              /* processes of the group                 */
+    MPI_Comm cross;             /* same position in every group           */
+    MPI_Win  win;               /* next shot, stored by rank 0            */
+    int     *counter;
+#endif
+} sched_t;
+
+/*
+ * Shot geometry file: one "z x y" source position per shot. Without a
+ * file there is a single shot at the origin.
+ */
+void sched_load_geometry ( const char *fname,
+                           int        *nshots,
+                           shot_t    **shots );
+
+/* also makes the group the parent communicator of the domains */
+void sched_setup ( sched_t *sched, const char *geometry );
+
+void sched_release ( sched_t *sched );
+
+/* next shot of the round for the group of the process, -1 when none is left */
+int sched_next_shot ( sched_t *sched );
+
+/* waits for every group to finish its shots and starts a new round */
+void sched_end_round ( sched_t *sched );
+
+#endif /* end of _FWI_SCHED_H_ definition */
@@ -0,0 +1,149 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#ifndef _FWI_SNAPSHOT_H_
+#define _FWI_SNAPSHOT_H_
+
+#include "fwi_propagator.h"
+#include "fwi_domain.h"
+
+#include <pthread.h>
+
+/*
+ * Velocity snapshots of a shot, kept in three tiers:
+ *
+ *   1. memory, up to FWI_SNAPSHOT_MEMORY MB per process,
+ *   2. a node-local scratch directory (FWI_SCRATCH_DIR), up to
+ *      FWI_SNAPSHOT_SCRATCH MB per process (no limit when unset),
+ *   3. the shot folder, as global volumes (write_snapshot).
+ *
+ * The backward propagation reads the snapshots counting their suffixes down,
+ * so the lowest suffix of a full tier is the last one needed: it is the one
+ * moved to the next tier when a snapshot needed earlier arrives. Capacities
+ * are the same for every process of the domain (the smallest one), so all of
+ * them place every snapshot in the same tier.
+ *
+ * With FWI_SNAPSHOT_WRITER=N, snapshots_put copies the velocities into one of
+ * N queue buffers and returns: a background thread places them in the tiers,
+ * and the forward propagation only waits when the N buffers are taken.
+ *
+ * With FWI_SNAPSHOT_PREFETCH=N, a reader thread loads the next N snapshots
+ * the backward propagation needs from the scratch and folder tiers into
+ * staging buffers while the current interval is computed.
+ */
+typedef enum {
+    SNAPSHOT_MEMORY,
+    SNAPSHOT_SCRATCH,
+    SNAPSHOT_FOLDER,
+    SNAPSHOT_TIERS
+} snapshot_tier_t;
+
+typedef struct {
+    int   suffix;
+    int   tier;
+    real *volumes;              /* VELOCITY_FIELDS local volumes (memory) */
+} snapshot_entry_t;
+
+typedef struct {
+    char           *folder;
+    char            scratch[300];
+    const domain_t *domain;
+    integer         ncells;     /* local cells of a volume                */
+
+    int             capacity[SNAPSHOT_TIERS];   /* -1: no limit            */
+    int             count   [SNAPSHOT_TIERS];
+
+    int               nentries;
+    int               maxentries;
+    snapshot_entry_t *entries;
+
+    /* background writer, depth 0 without it */
+    int             depth;
+    real          **buffers;
+    int            *suffixes;
+    int             head;       /* oldest queued buffer                   */
+    int             queued;
+    int             stop;
+    real           *donor;      /* buffer the memory tier can keep        */
+    pthread_t       writer;
+    pthread_mutex_t lock;       /* shared by the writer and the reader    */
+    pthread_cond_t  changed;
+
+    /* read-ahead of the backward propagation, depth 0 without it */
+    int             ahead;
+    real          **staging;
+    int            *staged;     /* suffix of every staging buffer         */
+    int            *staged_tier;
+    int             first;      /* next staging buffer to be consumed     */
+    int             scheduled;
+    int             loaded;     /* buffers read, counting from 'first'    */
+    int             lowest;     /* lowest suffix scheduled so far         */
+    pthread_t       reader;
+
+    /* statistics */
+    int             stored  [SNAPSHOT_TIERS];
+    int             demoted;
+    double          tput;       /* spent by the caller of snapshots_put   */
+    double          tget;
+    double          twriter;    /* spent by the background writer         */
+    double          tstall;
+    int             stalls;
+    int             maxqueued;
+    double          treader;    /* spent by the background reader         */
+    double          twait;
+    int             hits;       /* staged before they were needed         */
+    int             waits;
+} snapshots_t;
+
+void snapshots_setup ( snapshots_t    *store,
+                       char           *folder,
+                       const domain_t *domain );
+
+/* logs the statistics, removes the scratch files and frees the memory */
+void snapshots_release ( snapshots_t *store );
+
+/* 'fields' are the VELOCITY_FIELDS local volumes of the velocity */
+void snapshots_put ( snapshots_t *store,
+                     const int    suffix,
+                     real        *fields[] );
+
+/* the snapshot leaves the memory and scratch tiers once it is read */
+void snapshots_get ( snapshots_t *store,
+                     const int    suffix,
+                     real        *fields[] );
+
+/*
+ * Moves the snapshots held in memory and scratch to the decomposition 'to',
+ * which replaces the one of the store (see domain_migrate).
+ */
+void snapshots_migrate ( snapshots_t    *store,
+                         const domain_t *to );
+
+#endif /* end of _FWI_SNAPSHOT_H_ definition */
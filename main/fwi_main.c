@@ -32,7 +32,7 @@
 int main(int argc, char* argv[])
 {
     if (argc < 3) {
-        fprintf(stderr, "Usage: %s <params_file> <frequency_file>\n", argv[0]);
+        fprintf(stderr, "Usage: %s <params_file> <frequency_file> [<shots_geometry_file>]\n", argv[0]);
         exit(0);
     }
 
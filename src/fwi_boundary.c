@@ -0,0 +1,115 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#include "fwi/fwi_boundary.h"
+
+void boundary_setup ( boundary_t     *b,
+                      const domain_t *d,
+                      const int       nfields,
+                      const int       maxsteps )
+{
+    const box_t local = domain_local_box( d );
+
+    b->nboxes   = 0;
+    b->ncells   = 0;
+    b->dimmz    = d->dimmz;
+    b->dimmx    = d->dimmx;
+    b->nfields  = nfields;
+    b->steps    = 0;
+    b->maxsteps = maxsteps;
+
+    /* only the faces at the physical boundary */
+    for (int face = 0; face < NFACES; face++)
+    {
+        if ( d->neighbours[face] != NO_NEIGHBOUR ) continue;
+
+        const int axis = face / 2;
+        const int side = face % 2;
+
+        box_t strip = local;
+        integer *lo, *hi;
+
+        if      ( axis == AXIS_Y ) { lo = &strip.y0; hi = &strip.yf; }
+        else if ( axis == AXIS_X ) { lo = &strip.x0; hi = &strip.xf; }
+        else                       { lo = &strip.z0; hi = &strip.zf; }
+
+        if ( side == 0 ) { *lo = *lo + HALO; *hi = *lo + HALO; }
+        else             { *hi = *hi - HALO; *lo = *hi - HALO; }
+
+        b->boxes[ b->nboxes++ ] = strip;
+        b->ncells += box_cells( strip );
+    }
+
+    const size_t bytes = (size_t) maxsteps * nfields * b->ncells * sizeof(real);
+    b->strips = (real*) __malloc( ALIGN_REAL, bytes );
+
+    print_debug("Boundary strips: %d faces, " I " cells per field and timestep, %lf GB for %d timesteps",
+               b->nboxes, b->ncells, TOGB(bytes), maxsteps);
+};
+
+void boundary_release ( boundary_t *b )
+{
+    __free( b->strips );
+};
+
+void boundary_save ( boundary_t *b,
+                     real       *fields[] )
+{
+    if ( b->steps == b->maxsteps )
+    {
+        print_error("No room for the boundary strips of step %d", b->steps);
+        abort();
+    }
+
+    real *strip = b->strips + (size_t) b->steps * b->nfields * b->ncells;
+
+    for (int f = 0; f < b->nfields; f++)
+        for (int i = 0; i < b->nboxes; i++)
+            strip += pack_box( strip, fields[f], b->boxes[i], b->dimmz, b->dimmx );
+
+    b->steps++;
+};
+
+void boundary_restore ( boundary_t *b,
+                        real       *fields[],
+                        const int   first,
+                        const int   n )
+{
+    const real *strip = b->strips + ((size_t) (b->steps - 1) * b->nfields + first) * b->ncells;
+
+    for (int f = 0; f < n; f++)
+        for (int i = 0; i < b->nboxes; i++)
+            strip += unpack_box( fields[f], strip, b->boxes[i], b->dimmz, b->dimmx );
+};
+
+void boundary_drop ( boundary_t *b )
+{
+    b->steps--;
+};
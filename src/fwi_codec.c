@@ -0,0 +1,947 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#include "fwi/fwi_codec.h"
+#include "fwi/fwi_propagator.h"
+
+#define BLOCK_VALUES  64
+#define INT_PRECISION 32
+#define EXPONENT_BITS 8
+#define EXPONENT_BIAS 127
+
+/* largest block in CODEC_PRECISION: the raw values and their exponent */
+#define MAX_BLOCK_BITS ( BLOCK_VALUES * INT_PRECISION + 1 + EXPONENT_BITS )
+
+#define CODEC_MAGIC   "FWICODEC"
+#define CODEC_VERSION 1
+
+/* coefficients by increasing sequency (sum of the indices along z, x, y) */
+static const unsigned char sequency[BLOCK_VALUES] = {
+     0,  1,  4, 16,  5, 17, 20,  2,  8, 32, 21,  6,  9, 18, 24, 33,
+    36,  3, 12, 48, 22, 25, 37, 10, 34, 40,  7, 13, 19, 28, 49, 52,
+    26, 38, 41, 23, 29, 53, 11, 14, 35, 44, 50, 56, 42, 27, 30, 39,
+    45, 54, 57, 15, 51, 60, 43, 46, 58, 31, 55, 61, 47, 59, 62, 63
+};
+
+int codec_from_env ( codec_t *codec )
+{
+    const int rate   = parse_env("FWI_SNAPSHOT_RATE");
+    const int digits = parse_env("FWI_SNAPSHOT_TOLERANCE");
+
+    codec->mode      = CODEC_NONE;
+    codec->rate      = 0;
+    codec->precision = 0;
+
+    if ( rate > 0 )
+    {
+        codec->mode = CODEC_RATE;
+        codec->rate = ( rate < INT_PRECISION ) ? rate : INT_PRECISION;
+    }
+    else if ( digits > 0 )
+    {
+        /* the error of a block stays below 2^(emax - precision + 8) */
+        const int precision = (int) ceil( digits * log2(10.0) ) + 8;
+
+        codec->mode      = CODEC_PRECISION;
+        codec->precision = ( precision < INT_PRECISION ) ? precision : INT_PRECISION;
+    }
+    else if ( parse_env("FWI_SNAPSHOT_LOSSLESS") > 0 )
+    {
+        codec->mode = CODEC_LOSSLESS;
+    }
+
+    return ( codec->mode != CODEC_NONE );
+};
+
+/* ------------------------------------------------------------------------- */
+/*                            BIT STREAMS                                    */
+/* ------------------------------------------------------------------------- */
+
+/* 64-bit words, filled from the least significant bit */
+typedef struct {
+    uint64_t *ptr;
+    uint64_t  buffer;
+    int       bits;     /* buffered, to write or already read */
+} bitstream_t;
+
+/* writes the n lowest bits of value, returns the ones above them */
+static inline uint64_t write_bits ( bitstream_t *s, const uint64_t value, const int n )
+{
+    if ( n == 0 ) return value;
+
+    const uint64_t v = ( n < 64 ) ? value & ((1ULL << n) - 1) : value;
+
+    s->buffer |= v << s->bits;
+    s->bits   += n;
+
+    if ( s->bits >= 64 )
+    {
+        *s->ptr++  = s->buffer;
+        s->bits   -= 64;
+        s->buffer  = ( s->bits > 0 ) ? v >> (n - s->bits) : 0;
+    }
+
+    return ( n < 64 ) ? value >> n : 0;
+};
+
+static inline int write_bit ( bitstream_t *s, const int bit )
+{
+    write_bits( s, (uint64_t) bit, 1 );
+    return bit;
+};
+
+static inline void write_zeros ( bitstream_t *s, int n )
+{
+    for (; n > 0; n -= 64) write_bits( s, 0, ( n < 64 ) ? n : 64 );
+};
+
+static inline void flush_bits ( bitstream_t *s )
+{
+    if ( s->bits > 0 ) *s->ptr++ = s->buffer;
+    s->buffer = 0;
+    s->bits   = 0;
+};
+
+static inline uint64_t read_bits ( bitstream_t *s, const int n )
+{
+    uint64_t value = s->buffer;
+
+    if ( s->bits < n )
+    {
+        const uint64_t w    = *s->ptr++;
+        const int      used = n - s->bits;
+
+        value     |= w << s->bits;
+        s->buffer  = ( used < 64 ) ? w >> used : 0;
+        s->bits    = 64 - used;
+    }
+    else
+    {
+        s->buffer  = ( n < 64 ) ? s->buffer >> n : 0;
+        s->bits   -= n;
+    }
+
+    return ( n < 64 ) ? value & ((1ULL << n) - 1) : value;
+};
+
+static inline int read_bit ( bitstream_t *s )
+{
+    return (int) read_bits( s, 1 );
+};
+
+static inline void skip_bits ( bitstream_t *s, int n )
+{
+    for (; n > 0; n -= 64) read_bits( s, ( n < 64 ) ? n : 64 );
+};
+
+/* ------------------------------------------------------------------------- */
+/*                            BLOCK CODER                                    */
+/* ------------------------------------------------------------------------- */
+
+/* decorrelating transform of 4 values 's' apart */
+static inline void forward_lift ( int32_t *p, const int s )
+{
+    int32_t x = p[0], y = p[s], z = p[2*s], w = p[3*s];
+
+    x += w; x >>= 1; w -= x;
+    z += y; z >>= 1; y -= z;
+    x += z; x >>= 1; z -= x;
+    w += y; w >>= 1; y -= w;
+    w += y >> 1; y -= w >> 1;
+
+    p[0] = x; p[s] = y; p[2*s] = z; p[3*s] = w;
+};
+
+static inline void inverse_lift ( int32_t *p, const int s )
+{
+    int32_t x = p[0], y = p[s], z = p[2*s], w = p[3*s];
+
+    y += w >> 1; w -= y >> 1;
+    y += w; w <<= 1; w -= y;
+    z += x; x <<= 1; x -= z;
+    y += z; z <<= 1; z -= y;
+    w += x; x <<= 1; x -= w;
+
+    p[0] = x; p[s] = y; p[2*s] = z; p[3*s] = w;
+};
+
+/* block values are laid out as the fields, z first, then x and y */
+static void forward_transform ( int32_t *p )
+{
+    for (int y = 0; y < 4; y++)
+        for (int x = 0; x < 4; x++) forward_lift( p + 4*x + 16*y, 1 );
+    for (int y = 0; y < 4; y++)
+        for (int z = 0; z < 4; z++) forward_lift( p + z + 16*y, 4 );
+    for (int x = 0; x < 4; x++)
+        for (int z = 0; z < 4; z++) forward_lift( p + z + 4*x, 16 );
+};
+
+static void inverse_transform ( int32_t *p )
+{
+    for (int x = 0; x < 4; x++)
+        for (int z = 0; z < 4; z++) inverse_lift( p + z + 4*x, 16 );
+    for (int y = 0; y < 4; y++)
+        for (int z = 0; z < 4; z++) inverse_lift( p + z + 16*y, 4 );
+    for (int y = 0; y < 4; y++)
+        for (int x = 0; x < 4; x++) inverse_lift( p + 4*x + 16*y, 1 );
+};
+
+/* negabinary, so that small magnitudes have their leading bits clear */
+#define NBMASK 0xaaaaaaaau
+
+static inline uint32_t int2uint ( const int32_t x ) { return ((uint32_t) x + NBMASK) ^ NBMASK; };
+static inline int32_t  uint2int ( const uint32_t x ) { return (int32_t) ((x ^ NBMASK) - NBMASK); };
+
+/*
+ * Bit planes from the most significant one: the bits of the coefficients
+ * already found significant go verbatim, the rest are run-length coded
+ * with group tests. Returns the bits written, at most maxbits.
+ */
+static int encode_ints ( bitstream_t *s, const int maxbits, const int maxprec, const uint32_t *data )
+{
+    const int kmin = ( INT_PRECISION > maxprec ) ? INT_PRECISION - maxprec : 0;
+    int bits = maxbits;
+    int n    = 0;
+
+    for (int k = INT_PRECISION; bits && k-- > kmin;)
+    {
+        uint64_t x = 0;
+        for (int i = 0; i < BLOCK_VALUES; i++)
+            x += (uint64_t) ((data[i] >> k) & 1u) << i;
+
+        const int m = ( n < bits ) ? n : bits;
+        bits -= m;
+        x = write_bits( s, x, m );
+
+        for (; n < BLOCK_VALUES && bits && (bits--, write_bit( s, x != 0 )); x >>= 1, n++)
+            for (; n < BLOCK_VALUES - 1 && bits && (bits--, !write_bit( s, (int) (x & 1u) )); x >>= 1, n++)
+                ;
+    }
+
+    return maxbits - bits;
+};
+
+static int decode_ints ( bitstream_t *s, const int maxbits, const int maxprec, uint32_t *data )
+{
+    const int kmin = ( INT_PRECISION > maxprec ) ? INT_PRECISION - maxprec : 0;
+    int bits = maxbits;
+    int n    = 0;
+
+    for (int i = 0; i < BLOCK_VALUES; i++) data[i] = 0;
+
+    for (int k = INT_PRECISION; bits && k-- > kmin;)
+    {
+        const int m = ( n < bits ) ? n : bits;
+        bits -= m;
+        uint64_t x = read_bits( s, m );
+
+        for (; n < BLOCK_VALUES && bits && (bits--, read_bit( s )); x += (uint64_t) 1 << n++)
+            for (; n < BLOCK_VALUES - 1 && bits && (bits--, !read_bit( s )); n++)
+                ;
+
+        for (int i = 0; x; i++, x >>= 1)
+            data[i] += (uint32_t) (x & 1u) << k;
+    }
+
+    return maxbits - bits;
+};
+
+static void block_limits ( const codec_t *codec, int *maxbits, int *minbits, int *maxprec )
+{
+    if ( codec->mode == CODEC_RATE )
+    {
+        *maxbits = BLOCK_VALUES * codec->rate;
+        *minbits = *maxbits;
+        *maxprec = INT_PRECISION;
+    }
+    else
+    {
+        *maxbits = MAX_BLOCK_BITS;
+        *minbits = 0;
+        *maxprec = codec->precision;
+    }
+};
+
+static void encode_block ( bitstream_t *s, const codec_t *codec, const real *block )
+{
+    int maxbits, minbits, maxprec;
+    block_limits( codec, &maxbits, &minbits, &maxprec );
+
+    real fmax = 0.f;
+    for (int i = 0; i < BLOCK_VALUES; i++)
+        if ( fabsf(block[i]) > fmax ) fmax = fabsf(block[i]);
+
+    int bits = 1;
+
+    if ( fmax > 0.f )
+    {
+        int emax;
+        frexpf( fmax, &emax );
+        if ( emax < 1 - EXPONENT_BIAS ) emax = 1 - EXPONENT_BIAS;
+
+        write_bits( s, 2 * (uint64_t) (emax + EXPONENT_BIAS) + 1, 1 + EXPONENT_BITS );
+        bits += EXPONENT_BITS;
+
+        /* block floating point, the largest value below 2^30 */
+        int32_t  iblock[BLOCK_VALUES];
+        uint32_t ublock[BLOCK_VALUES];
+
+        const double scale = ldexp( 1.0, INT_PRECISION - 2 - emax );
+
+        for (int i = 0; i < BLOCK_VALUES; i++)
+            iblock[i] = (int32_t) (scale * block[i]);
+
+        forward_transform( iblock );
+
+        for (int i = 0; i < BLOCK_VALUES; i++)
+            ublock[i] = int2uint( iblock[ sequency[i] ] );
+
+        bits += encode_ints( s, maxbits - bits, maxprec, ublock );
+    }
+    else
+        write_bit( s, 0 );
+
+    if ( bits < minbits ) write_zeros( s, minbits - bits );
+};
+
+static void decode_block ( bitstream_t *s, const codec_t *codec, real *block )
+{
+    int maxbits, minbits, maxprec;
+    block_limits( codec, &maxbits, &minbits, &maxprec );
+
+    int bits = 1;
+
+    if ( read_bit( s ) )
+    {
+        const int emax = (int) read_bits( s, EXPONENT_BITS ) - EXPONENT_BIAS;
+        bits += EXPONENT_BITS;
+
+        int32_t  iblock[BLOCK_VALUES];
+        uint32_t ublock[BLOCK_VALUES];
+
+        bits += decode_ints( s, maxbits - bits, maxprec, ublock );
+
+        for (int i = 0; i < BLOCK_VALUES; i++)
+            iblock[ sequency[i] ] = uint2int( ublock[i] );
+
+        inverse_transform( iblock );
+
+        const double scale = ldexp( 1.0, emax - (INT_PRECISION - 2) );
+
+        for (int i = 0; i < BLOCK_VALUES; i++)
+            block[i] = (real) (scale * iblock[i]);
+    }
+    else
+        for (int i = 0; i < BLOCK_VALUES; i++) block[i] = 0.f;
+
+    if ( bits < minbits ) skip_bits( s, minbits - bits );
+};
+
+/* ------------------------------------------------------------------------- */
+/*                         LOSSLESS BYTE CODER                               */
+/* ------------------------------------------------------------------------- */
+
+/*
+ * LZ77 sequences, as LZ4: a token with the number of literals (high nibble)
+ * and the match length minus LZ_MIN_MATCH (low nibble), 15 meaning that
+ * bytes of 255 and a last smaller one follow, the literals, and the 16-bit
+ * distance of the match. The last sequence has literals only.
+ */
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 13
+#define LZ_MAX_DIST  65535
+
+static inline uint32_t load32 ( const uint8_t *p )
+{
+    uint32_t v;
+    memcpy( &v, p, sizeof(v) );
+    return v;
+};
+
+static inline uint32_t lz_hash ( const uint32_t v )
+{
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+};
+
+static inline uint8_t *lz_length ( uint8_t *op, size_t length )
+{
+    for (; length >= 255; length -= 255) *op++ = 255;
+    *op++ = (uint8_t) length;
+    return op;
+};
+
+/* returns the bytes written, 0 when they would not be fewer than n */
+static size_t lz_compress ( const uint8_t *in, const size_t n, uint8_t *out )
+{
+    uint32_t table[1 << LZ_HASH_BITS];
+    memset( table, 0, sizeof(table) );
+
+    const uint8_t *end = out + n;
+    uint8_t *op     = out;
+    size_t   ip     = 0;
+    size_t   anchor = 0;
+
+    while ( ip + LZ_MIN_MATCH <= n )
+    {
+        const uint32_t seq = load32( in + ip );
+        const uint32_t h   = lz_hash( seq );
+        const size_t   ref = table[h];      /* position + 1, 0 when empty */
+        table[h] = (uint32_t) (ip + 1);
+
+        if ( ref == 0 || ip - (ref - 1) > LZ_MAX_DIST || load32( in + ref - 1 ) != seq )
+        {
+            /* faster over runs without matches, as noisy mantissas */
+            ip += 1 + ((ip - anchor) >> 6);
+            continue;
+        }
+
+        size_t length = LZ_MIN_MATCH;
+        while ( ip + length < n && in[ref - 1 + length] == in[ip + length] ) length++;
+
+        const size_t literals = ip - anchor;
+        if ( op + 1 + literals + literals / 255 + 2 + length / 255 + 1 >= end ) return 0;
+
+        uint8_t *token = op++;
+        *token = (uint8_t) (((literals < 15) ? literals : 15) << 4);
+        if ( literals >= 15 ) op = lz_length( op, literals - 15 );
+        memcpy( op, in + anchor, literals );
+        op += literals;
+
+        const size_t distance = ip - (ref - 1);
+        *op++ = (uint8_t) (distance & 0xff);
+        *op++ = (uint8_t) (distance >> 8);
+
+        const size_t extra = length - LZ_MIN_MATCH;
+        *token |= (uint8_t) ((extra < 15) ? extra : 15);
+        if ( extra >= 15 ) op = lz_length( op, extra - 15 );
+
+        ip    += length;
+        anchor = ip;
+    }
+
+    const size_t literals = n - anchor;
+    if ( literals > 0 )
+    {
+        if ( op + 1 + literals + literals / 255 + 1 >= end ) return 0;
+
+        *op++ = (uint8_t) (((literals < 15) ? literals : 15) << 4);
+        if ( literals >= 15 ) op = lz_length( op, literals - 15 );
+        memcpy( op, in + anchor, literals );
+        op += literals;
+    }
+
+    return (size_t) (op - out);
+};
+
+static inline const uint8_t *lz_read_length ( const uint8_t *ip, size_t *length )
+{
+    uint8_t b;
+    do { b = *ip++; *length += b; } while ( b == 255 );
+    return ip;
+};
+
+static void lz_decompress ( const uint8_t *in, uint8_t *out, const size_t n )
+{
+    size_t op = 0;
+
+    while ( op < n )
+    {
+        const uint8_t token = *in++;
+
+        size_t literals = token >> 4;
+        if ( literals == 15 ) in = lz_read_length( in, &literals );
+        memcpy( out + op, in, literals );
+        in += literals;
+        op += literals;
+
+        if ( op >= n ) break;
+
+        const size_t distance = in[0] | ((size_t) in[1] << 8);
+        in += 2;
+
+        size_t length = token & 15;
+        if ( length == 15 ) in = lz_read_length( in, &length );
+        length += LZ_MIN_MATCH;
+
+        /* byte by byte, matches may overlap what they copy */
+        for (size_t i = 0; i < length; i++, op++) out[op] = out[op - distance];
+    }
+};
+
+/*
+ * The values of every column along z are mapped to integers in the order of
+ * the floats and replaced by their differences, folded so that small ones of
+ * either sign have their high bytes at zero. Their bytes are shuffled into
+ * sizeof(real) streams, so the signs and exponents of a smooth field, and its
+ * zeros, make long matches. Every stream has a 32-bit length, the top bit
+ * set when it is stored as is.
+ */
+#define STORED_STREAM 0x80000000u
+
+static inline uint32_t ordered ( const uint32_t u )
+{
+    return ( u & 0x80000000u ) ? ~u : u | 0x80000000u;
+};
+
+static inline uint32_t unordered ( const uint32_t m )
+{
+    return ( m & 0x80000000u ) ? m & 0x7fffffffu : ~m;
+};
+
+static size_t encode_lossless_chunk ( const real    *field,
+                                      const box_t    b,
+                                      const integer  dimmz,
+                                      const integer  dimmx,
+                                      uint64_t      *stream )
+{
+    const size_t n = (size_t) box_cells( b );
+    uint8_t *shuffled = (uint8_t*) __malloc( ALIGN_REAL, n * sizeof(real) );
+
+    size_t i = 0;
+    for (integer y = b.y0; y < b.yf; y++)
+        for (integer x = b.x0; x < b.xf; x++)
+        {
+            const uint32_t *column = (const uint32_t*) &field[ IDX(b.z0, x, y, dimmz, dimmx) ];
+            uint32_t previous = 0;
+
+            for (integer z = 0; z < b.zf - b.z0; z++, i++)
+            {
+                const uint32_t m = ordered( column[z] );
+                const uint32_t d = m - previous;
+                const uint32_t r = (d << 1) ^ (0u - (d >> 31));
+                previous = m;
+
+                for (size_t k = 0; k < sizeof(real); k++) shuffled[k * n + i] = (uint8_t) (r >> (8 * k));
+            }
+        }
+
+    uint8_t *op = (uint8_t*) stream;
+
+    for (size_t k = 0; k < sizeof(real); k++)
+    {
+        uint32_t length = (uint32_t) lz_compress( shuffled + k * n, n, op + sizeof(uint32_t) );
+
+        if ( length == 0 )
+        {
+            memcpy( op + sizeof(uint32_t), shuffled + k * n, n );
+            length = (uint32_t) n | STORED_STREAM;
+        }
+
+        memcpy( op, &length, sizeof(uint32_t) );
+        op += sizeof(uint32_t) + (length & ~STORED_STREAM);
+    }
+
+    __free( shuffled );
+
+    /* whole words, as the other chunks */
+    size_t bytes = (size_t) (op - (uint8_t*) stream);
+    for (; bytes % sizeof(uint64_t); bytes++) *op++ = 0;
+
+    return bytes;
+};
+
+static void decode_lossless_chunk ( const uint64_t *stream,
+                                    real           *field,
+                                    const box_t     b,
+                                    const integer   dimmz,
+                                    const integer   dimmx )
+{
+    const size_t n = (size_t) box_cells( b );
+    uint8_t *shuffled = (uint8_t*) __malloc( ALIGN_REAL, n * sizeof(real) );
+
+    const uint8_t *ip = (const uint8_t*) stream;
+
+    for (size_t k = 0; k < sizeof(real); k++)
+    {
+        uint32_t length;
+        memcpy( &length, ip, sizeof(uint32_t) );
+        ip += sizeof(uint32_t);
+
+        if ( length & STORED_STREAM ) memcpy( shuffled + k * n, ip, n );
+        else                          lz_decompress( ip, shuffled + k * n, n );
+
+        ip += length & ~STORED_STREAM;
+    }
+
+    size_t i = 0;
+    for (integer y = b.y0; y < b.yf; y++)
+        for (integer x = b.x0; x < b.xf; x++)
+        {
+            uint32_t *column = (uint32_t*) &field[ IDX(b.z0, x, y, dimmz, dimmx) ];
+            uint32_t previous = 0;
+
+            for (integer z = 0; z < b.zf - b.z0; z++, i++)
+            {
+                uint32_t r = 0;
+                for (size_t k = 0; k < sizeof(real); k++) r |= (uint32_t) shuffled[k * n + i] << (8 * k);
+
+                previous += (r >> 1) ^ (0u - (r & 1));
+                column[z] = unordered( previous );
+            }
+        }
+
+    __free( shuffled );
+};
+
+/* ------------------------------------------------------------------------- */
+/*                               CHUNKS                                      */
+/* ------------------------------------------------------------------------- */
+
+static inline integer nblocks ( const integer n ) { return (n + 3) / 4; };
+
+size_t codec_chunk_bound ( const codec_t *codec,
+                           const integer  nz,
+                           const integer  nx )
+{
+    /* the streams stored as they are */
+    if ( codec->mode == CODEC_LOSSLESS )
+        return (sizeof(real) * (sizeof(uint32_t) + 4 * (size_t) nz * nx) + sizeof(uint64_t) - 1)
+             / sizeof(uint64_t) * sizeof(uint64_t);
+
+    int maxbits, minbits, maxprec;
+    block_limits( codec, &maxbits, &minbits, &maxprec );
+
+    const uint64_t bits = (uint64_t) nblocks(nz) * nblocks(nx) * maxbits;
+    return (size_t) ((bits + 63) / 64) * sizeof(uint64_t);
+};
+
+size_t codec_encode_chunk ( const codec_t *codec,
+                            const real    *field,
+                            const box_t    b,
+                            const integer  dimmz,
+                            const integer  dimmx,
+                            uint64_t      *stream )
+{
+    if ( codec->mode == CODEC_LOSSLESS )
+        return encode_lossless_chunk( field, b, dimmz, dimmx, stream );
+
+    bitstream_t s = { stream, 0, 0 };
+    real block[BLOCK_VALUES];
+
+    for (integer bx = b.x0; bx < b.xf; bx += 4)
+        for (integer bz = b.z0; bz < b.zf; bz += 4)
+        {
+            /* partial blocks repeat their last cells */
+            for (int y = 0; y < 4; y++)
+                for (int x = 0; x < 4; x++)
+                    for (int z = 0; z < 4; z++)
+                    {
+                        const integer cy = ( b.y0 + y < b.yf ) ? b.y0 + y : b.yf - 1;
+                        const integer cx = ( bx   + x < b.xf ) ? bx   + x : b.xf - 1;
+                        const integer cz = ( bz   + z < b.zf ) ? bz   + z : b.zf - 1;
+
+                        block[z + 4*x + 16*y] = field[ IDX(cz, cx, cy, dimmz, dimmx) ];
+                    }
+
+            encode_block( &s, codec, block );
+        }
+
+    flush_bits( &s );
+    return (size_t) (s.ptr - stream) * sizeof(uint64_t);
+};
+
+void codec_decode_chunk ( const codec_t  *codec,
+                          const uint64_t *stream,
+                          real           *field,
+                          const box_t     b,
+                          const integer   dimmz,
+                          const integer   dimmx )
+{
+    if ( codec->mode == CODEC_LOSSLESS )
+    {
+        decode_lossless_chunk( stream, field, b, dimmz, dimmx );
+        return;
+    }
+
+    bitstream_t s = { (uint64_t*) stream, 0, 0 };
+    real block[BLOCK_VALUES];
+
+    for (integer bx = b.x0; bx < b.xf; bx += 4)
+        for (integer bz = b.z0; bz < b.zf; bz += 4)
+        {
+            decode_block( &s, codec, block );
+
+            for (int y = 0; y < 4 && b.y0 + y < b.yf; y++)
+                for (int x = 0; x < 4 && bx + x < b.xf; x++)
+                    for (int z = 0; z < 4 && bz + z < b.zf; z++)
+                        field[ IDX(bz + z, bx + x, b.y0 + y, dimmz, dimmx) ] = block[z + 4*x + 16*y];
+        }
+};
+
+/* ------------------------------------------------------------------------- */
+/*                                FILES                                      */
+/* ------------------------------------------------------------------------- */
+
+typedef struct {
+    char    magic[8];
+    int64_t version;
+    int64_t mode;
+    int64_t rate;
+    int64_t precision;
+    int64_t nfields;
+    int64_t gdimmz, gdimmx, gdimmy;
+    int64_t nsections;
+} codec_header_t;
+
+typedef struct {
+    int64_t z0, zf, x0, xf, y0, yf;     /* owned box, global cells */
+    int64_t offset;
+    int64_t bound;
+} codec_section_t;
+
+static inline integer imin ( const integer a, const integer b ) { return ( a < b ) ? a : b; };
+static inline integer imax ( const integer a, const integer b ) { return ( a > b ) ? a : b; };
+
+/* chunk sizes, then the chunks of every volume */
+static int64_t section_bound ( const codec_t *codec, const box_t b, const integer nfields )
+{
+    const integer nchunks = nfields * nblocks( b.yf - b.y0 );
+
+    return (int64_t) nchunks * sizeof(int64_t)
+         + (int64_t) nchunks * codec_chunk_bound( codec, b.zf - b.z0, b.xf - b.x0 );
+};
+
+void codec_write_volumes ( const codec_t  *codec,
+                           const char     *fname,
+                           real           *fields[],
+                           const integer   nfields,
+                           const domain_t *d )
+{
+    PUSH_RANGE
+
+#if defined(LOG_IO_STATS)
+    const double tstart = dtime();
+#endif
+
+    /* every process knows where every section goes */
+    codec_section_t *table = (codec_section_t*) __malloc( ALIGN_INT, d->nranks * sizeof(codec_section_t) );
+
+    int64_t offset = sizeof(codec_header_t) + d->nranks * sizeof(codec_section_t);
+
+    for (int r = 0; r < d->nranks; r++)
+    {
+        const box_t o = d->owners[r];
+        const codec_section_t section = { o.z0, o.zf, o.x0, o.xf, o.y0, o.yf,
+                                          offset, section_bound( codec, o, nfields ) };
+        table[r] = section;
+        offset  += section.bound;
+    }
+
+    /* the box owned by this process, in local cells */
+    const box_t   owned   = domain_owned_box( d );
+    const integer nplanes = nblocks( owned.yf - owned.y0 );
+    const integer nchunks = nfields * nplanes;
+    const size_t  cbound  = codec_chunk_bound( codec, owned.zf - owned.z0, owned.xf - owned.x0 );
+
+    int64_t  *sizes  = (int64_t* ) __malloc( ALIGN_REAL, table[d->rank].bound );
+    uint64_t *chunks = (uint64_t*) ( sizes + nchunks );
+
+#if defined(_OPENMP)
+    #pragma omp parallel for schedule(dynamic)
+#endif
+    for (integer c = 0; c < nchunks; c++)
+    {
+        const integer f = c / nplanes;
+        const integer p = c % nplanes;
+
+        box_t chunk = owned;
+        chunk.y0 = owned.y0 + 4 * p;
+        chunk.yf = ( chunk.y0 + 4 < owned.yf ) ? chunk.y0 + 4 : owned.yf;
+
+        sizes[c] = (int64_t) codec_encode_chunk( codec, fields[f], chunk, d->dimmz, d->dimmx,
+                                                 chunks + c * (cbound / sizeof(uint64_t)) );
+    }
+
+    /* chunks one after the other */
+    char   *packed = (char*) chunks;
+    int64_t bytes  = nchunks * sizeof(int64_t);
+
+    for (integer c = 0; c < nchunks; c++)
+    {
+        memmove( packed, (char*) chunks + c * cbound, sizes[c] );
+        packed += sizes[c];
+        bytes  += sizes[c];
+    }
+
+    io_file_t file;
+    io_open( &file, fname, 1, offset );
+
+    if ( d->rank == 0 )
+    {
+        codec_header_t header = { CODEC_MAGIC, CODEC_VERSION, codec->mode, codec->rate, codec->precision,
+                                  nfields, d->gdimmz, d->gdimmx, d->gdimmy, d->nranks };
+
+        io_write( &file, &header, sizeof(header), 0 );
+        io_write( &file, table, d->nranks * sizeof(codec_section_t), sizeof(header) );
+    }
+
+    io_write( &file, sizes, bytes, table[d->rank].offset );
+    io_close( &file );
+
+#if defined(LOG_IO_STATS)
+    const double  seconds = dtime() - tstart;
+    const integer ncells  = box_cells( owned );
+
+    print_stats("Compressed snapshot (%lf GB to %lf GB, %.1lfx) coded and written in %lf seconds (%lf MB/s)",
+                TOGB( (size_t) ncells * nfields * sizeof(real) ), TOGB( bytes ),
+                (double) ncells * nfields * sizeof(real) / bytes, seconds,
+                ((double) ncells * nfields * sizeof(real) / (1000.0 * 1000.0)) / seconds);
+#endif
+
+    __free( sizes );
+    __free( table );
+
+    POP_RANGE
+};
+
+void codec_read_volumes ( const char     *fname,
+                          real           *fields[],
+                          const integer   nfields,
+                          const domain_t *d )
+{
+    PUSH_RANGE
+
+    io_file_t file;
+    io_open( &file, fname, 0, 0 );
+
+    /* nothing was kept */
+    if ( file.backend == IO_NULL )
+    {
+        for (integer f = 0; f < nfields; f++)
+            memset( fields[f], 0, (size_t) domain_local_cells( d ) * sizeof(real) );
+
+        io_close( &file );
+        POP_RANGE
+        return;
+    }
+
+    codec_header_t header;
+    io_read( &file, &header, sizeof(header), 0 );
+
+    if ( memcmp( header.magic, CODEC_MAGIC, sizeof(header.magic) ) != 0 || header.version != CODEC_VERSION ||
+         header.nfields < nfields || header.gdimmz != d->gdimmz || header.gdimmx != d->gdimmx || header.gdimmy != d->gdimmy )
+    {
+        print_error("%s is not a compressed snapshot of this grid", fname);
+        abort();
+    }
+
+    const codec_t codec = { (int) header.mode, (int) header.rate, (int) header.precision };
+
+    codec_section_t *table = (codec_section_t*) __malloc( ALIGN_INT, header.nsections * sizeof(codec_section_t) );
+    io_read( &file, table, header.nsections * sizeof(codec_section_t), sizeof(header) );
+
+    /* the cells owned by this process, in global cells: its ghost cells are
+     * refreshed by the halo exchange of the first velocity update */
+    box_t owned = domain_owned_box( d );
+    owned.z0 += d->z0; owned.zf += d->z0;
+    owned.x0 += d->x0; owned.xf += d->x0;
+    owned.y0 += d->y0; owned.yf += d->y0;
+
+    for (int64_t r = 0; r < header.nsections; r++)
+    {
+        const codec_section_t *section = &table[r];
+
+        const box_t overlap = { imax( section->z0, owned.z0 ), imin( section->zf, owned.zf ),
+                                imax( section->x0, owned.x0 ), imin( section->xf, owned.xf ),
+                                imax( section->y0, owned.y0 ), imin( section->yf, owned.yf ) };
+
+        if ( overlap.z0 >= overlap.zf || overlap.x0 >= overlap.xf || overlap.y0 >= overlap.yf ) continue;
+
+        /* the chunks of the planes that overlap, in every volume */
+        const integer nz      = section->zf - section->z0;
+        const integer nx      = section->xf - section->x0;
+        const integer nplanes = nblocks( section->yf - section->y0 );
+        const integer p0      = (overlap.y0 - section->y0) / 4;
+        const integer p1      = (overlap.yf - 1 - section->y0) / 4 + 1;
+        const integer nread   = p1 - p0;
+
+        int64_t *sizes = (int64_t*) __malloc( ALIGN_INT, header.nfields * nplanes * sizeof(int64_t) );
+        io_read( &file, sizes, header.nfields * nplanes * sizeof(int64_t), section->offset );
+
+        /* where every chunk lands in memory, the runs of every volume one after the other */
+        int64_t *starts = (int64_t*) __malloc( ALIGN_INT, (nfields * nread + 1) * sizeof(int64_t) );
+        starts[0] = 0;
+
+        for (integer f = 0; f < nfields; f++)
+            for (integer p = p0; p < p1; p++)
+                starts[f * nread + p - p0 + 1] = starts[f * nread + p - p0] + sizes[f * nplanes + p];
+
+        char *chunks = (char*) __malloc( ALIGN_REAL, starts[nfields * nread] + sizeof(uint64_t) );
+
+        int64_t at = section->offset + header.nfields * nplanes * sizeof(int64_t);
+
+        for (integer f = 0; f < nfields; f++)
+        {
+            int64_t first = at;
+            for (integer p = 0; p < p0; p++) first += sizes[f * nplanes + p];
+
+            io_read( &file, chunks + starts[f * nread], starts[(f + 1) * nread] - starts[f * nread], first );
+
+            for (integer p = 0; p < nplanes; p++) at += sizes[f * nplanes + p];
+        }
+
+#if defined(_OPENMP)
+        #pragma omp parallel
+#endif
+        {
+            real *planes = (real*) __malloc( ALIGN_REAL, (size_t) 4 * nz * nx * sizeof(real) );
+
+#if defined(_OPENMP)
+            #pragma omp for schedule(dynamic)
+#endif
+            for (integer c = 0; c < nfields * nread; c++)
+            {
+                const integer f  = c / nread;
+                const integer y0 = section->y0 + 4 * (p0 + c % nread);
+                const box_t   b  = { 0, nz, 0, nx, 0, imin( 4, section->yf - y0 ) };
+
+                codec_decode_chunk( &codec, (const uint64_t*) (chunks + starts[c]), planes, b, nz, nx );
+
+                /* the overlapping cells go to the local field */
+                for (integer y = imax( y0, overlap.y0 ); y < imin( y0 + 4, overlap.yf ); y++)
+                    for (integer x = overlap.x0; x < overlap.xf; x++)
+                        memcpy( &fields[f][ IDX(overlap.z0 - d->z0, x - d->x0, y - d->y0, d->dimmz, d->dimmx) ],
+                                &planes[ IDX(overlap.z0 - section->z0, x - section->x0, y - y0, nz, nx) ],
+                                (overlap.zf - overlap.z0) * sizeof(real) );
+            }
+
+            __free( planes );
+        }
+
+        __free( chunks );
+        __free( starts );
+        __free( sizes  );
+    }
+
+    io_close( &file );
+    __free( table );
+
+    POP_RANGE
+};
@@ -35,7 +35,64 @@
  * /system/support/bscgeo/src/wavelet.c
  * functions can be used.
  */
-void kernel( propagator_t propagator, real waveletFreq, int shotid, char* outputfolder, char* shotfolder)
+/*
+ * Moves the fields of a shot to the domain set up with the y ranges
+ * chosen by domain_rebalance.
+ */
+static void migrate_shot ( domain_t    *domain,
+                           coeff_t     *c,
+                           s_t         *s,
+                           v_t         *v,
+                           real       **rho,
+                           real       **image,
+                           snapshots_t *snapshots )
+{
+    domain_t balanced;
+    domain_setup( &balanced, domain->gdimmz, domain->gdimmx, domain->gdimmy );
+
+    const integer numberOfCells = domain_local_cells( &balanced );
+
+    coeff_t bc;
+    s_t     bs;
+    v_t     bv;
+    real   *brho;
+    alloc_memory_shot( numberOfCells, &bc, &bs, &bv, &brho );
+
+    real *from[VELOCITY_FIELDS + STRESS_FIELDS + COEFF_FIELDS + 1];
+    real *to  [VELOCITY_FIELDS + STRESS_FIELDS + COEFF_FIELDS + 1];
+
+    velocity_field_list( v,   from );
+    stress_field_list  ( s,   from + VELOCITY_FIELDS );
+    coeff_field_list   ( c,   from + VELOCITY_FIELDS + STRESS_FIELDS );
+    velocity_field_list( &bv, to   );
+    stress_field_list  ( &bs, to   + VELOCITY_FIELDS );
+    coeff_field_list   ( &bc, to   + VELOCITY_FIELDS + STRESS_FIELDS );
+    from[VELOCITY_FIELDS + STRESS_FIELDS + COEFF_FIELDS] = *rho;
+    to  [VELOCITY_FIELDS + STRESS_FIELDS + COEFF_FIELDS] = brho;
+
+    const double start_t = dtime();
+    domain_migrate( domain, &balanced, from, to, VELOCITY_FIELDS + STRESS_FIELDS + COEFF_FIELDS + 1 );
+    snapshots_migrate( snapshots, &balanced );
+    print_stats("Fields migrated to the new y ranges in %lf seconds", dtime() - start_t );
+
+    free_memory_shot( c, s, v, rho );
+    *c   = bc;
+    *s   = bs;
+    *v   = bv;
+    *rho = brho;
+
+    /* nothing has been imaged yet, the volumes just follow the cells */
+    const size_t image_bytes = 2 * numberOfCells * sizeof(real) * WRITTEN_FIELDS;
+
+    __free( *image );
+    *image = (real*) __malloc( ALIGN_REAL, image_bytes );
+    memset( *image, 0, image_bytes );
+
+    domain_release( domain );
+    *domain = balanced;
+};
+
+void kernel( propagator_t propagator, real waveletFreq, int shotid, char* outputfolder, char* shotfolder, gradient_t *gradient)
 {   
     /* local variables */
     int stacki;
@@ -45,41 +102,23 @@ void kernel( propagator_t propagator, real waveletFreq, int shotid, char* output
 
     load_shot_parameters( shotid, &stacki, &dt, &forw_steps, &back_steps, &dz, &dx, &dy, &dimmz, &dimmx, &dimmy, outputfolder, waveletFreq );
 
-#if defined(USE_MPI)
-    /* find ourselves into the MPI space */
-    int mpi_rank, Subdomains;
-    MPI_Comm_size( MPI_COMM_WORLD, &Subdomains);
-    MPI_Comm_rank( MPI_COMM_WORLD, &mpi_rank);
-
-    /* number of cell for each MPI rank */
-    const integer planesPerSubdomain = ((dimmy-2*HALO)/Subdomains);
-    const integer planesRemaining    = ((dimmy-2*HALO)%Subdomains);
-
-    /* Compute local computing limits */
-    const integer y0 = planesPerSubdomain * mpi_rank; 
-    const integer yF = y0 + planesPerSubdomain + 2*HALO + ((mpi_rank == Subdomains-1) ? planesRemaining : 0);
-    assert(yF <= dimmy);
+    /* find ourselves into the (MPI) process grid */
+    domain_t domain;
+    domain_setup( &domain, dimmz, dimmx, dimmy );
 
-    print_debug( "MPI rank " I " compute from y=" I " to=" I ". #planes per subdomain " I " ", 
-            mpi_rank, y0, yF, planesPerSubdomain);
+    integer numberOfCells = domain_local_cells( &domain );
 
-    const integer edimmy = (yF - y0);
-    const integer numberOfCells = dimmz * dimmx * edimmy;
-
-    /* set GLOBAL integration limits */
-    const integer nyf = edimmy;
-#else
-    const integer numberOfCells = dimmz * dimmx * dimmy;
-
-    /* set GLOBAL integration limits */
-    const integer nyf = dimmy;
-#endif
-    /* set GLOBAL integration limits -COMMON PART-*/
+    /* set LOCAL integration limits */
     const integer nz0 = 0;
     const integer ny0 = 0;
     const integer nx0 = 0;
-    const integer nzf = dimmz;
-    const integer nxf = dimmx;
+    const integer nzf = domain.dimmz;
+    const integer nxf = domain.dimmx;
+    integer       nyf = domain.dimmy;
+
+    /* throughput of the first forward timesteps drives the y ranges */
+    throughput_t throughput = { parse_env("FWI_LOAD_BALANCE"), 0, 0.0 };
+    if ( throughput.steps < 0 ) throughput.steps = forw_steps;
     
     real    *rho;
     v_t     v;
@@ -91,16 +130,20 @@ void kernel( propagator_t propagator, real waveletFreq, int shotid, char* output
     /* allocate shot memory */
     alloc_memory_shot  ( numberOfCells, &coeffs, &s, &v, &rho);
 
-#if defined(USE_MPI)
-    /* load initial model from a binary file */
-    load_initial_model ( waveletFreq, dimmz, dimmx, edimmy, &coeffs, &s, &v, rho);
-#else
     /* load initial model from a binary file */
-    load_initial_model ( waveletFreq, dimmz, dimmx, dimmy, &coeffs, &s, &v, rho);
-#endif
+    load_initial_model ( waveletFreq, &domain, &coeffs, &s, &v, rho);
 
-    /* Allocate memory for IO buffer */
-    real* io_buffer = (real*) __malloc( ALIGN_REAL, numberOfCells * sizeof(real) * WRITTEN_FIELDS );
+    /* RTM by time reversal scatters the reflections of the outer frame, not
+     * when checkpoints or boundary strips take precedence */
+    const int     reversal     = ( propagator == RTM_KERNEL && parse_env("FWI_CHECKPOINTS") <= 0 &&
+                                   parse_env("FWI_BOUNDARY_SAVING") == 0 );
+    const integer random_width = ( reversal ) ? parse_env("FWI_RANDOM_BOUNDARY") : 0;
+    if ( random_width > 0 ) random_boundary_layer( &domain, &coeffs, random_width );
+
+    /* gradient and preconditioner of the shot, a volume per velocity field */
+    const size_t image_bytes = 2 * numberOfCells * sizeof(real) * WRITTEN_FIELDS;
+    real*        image       = (real*) __malloc( ALIGN_REAL, image_bytes );
+    memset( image, 0, image_bytes );
 
     /* inspects every array positions for leaks. Enabled when DEBUG flag is defined */
     check_memory_shot  ( numberOfCells, &coeffs, &s, &v, rho);
@@ -110,65 +153,149 @@ void kernel( propagator_t propagator, real waveletFreq, int shotid, char* output
     {
     case( RTM_KERNEL ):
     {
-        start_t = dtime();
-
-        propagate_shot ( FORWARD,
-                         v, s, coeffs, rho,
-                         forw_steps, back_steps -1,
-                         dt,dz,dx,dy,
-                         nz0, nzf, nx0, nxf, ny0, nyf,
-                         stacki,
-                         shotfolder,
-                         io_buffer,
-                         dimmz, dimmx, dimmy);
+        /* snapshots are recomputed from checkpoints when given a budget,
+         * or from boundary strips, or from a random boundary, or replaced
+         * by running transforms at a few frequencies */
+        const int checkpoints = parse_env("FWI_CHECKPOINTS");
+        const int strips      = parse_env("FWI_BOUNDARY_SAVING");
+        const int frequencies = parse_env("FWI_DFT_FREQUENCIES");
 
-        end_t = dtime();
+        real *shot_gradient = image;
+        real *shot_precond  = image + numberOfCells * WRITTEN_FIELDS;
 
-        print_stats("Forward propagation finished in %lf seconds", end_t - start_t );
+        if ( checkpoints > 0 )
+        {
+            start_t = dtime();
+
+            revolve_shot ( v, s, coeffs, rho,
+                           forw_steps, back_steps -1,
+                           dt,dz,dx,dy,
+                           nz0, nzf, nx0, nxf, ny0, nyf,
+                           stacki,
+                           checkpoints,
+                           shot_gradient,
+                           shot_precond,
+                           &domain );
+
+            print_stats("Checkpointed forward and backward propagation finished in %lf seconds", dtime() - start_t );
+        }
+        else if ( strips || random_width > 0 )
+        {
+            start_t = dtime();
+
+            reconstruct_shot ( v, s, coeffs, rho,
+                               forw_steps, back_steps -1,
+                               dt,dz,dx,dy,
+                               nz0, nzf, nx0, nxf, ny0, nyf,
+                               stacki,
+                               strips,
+                               shot_gradient,
+                               shot_precond,
+                               &domain );
+
+            print_stats("Forward, reconstruction and backward propagation finished in %lf seconds", dtime() - start_t );
+        }
+        else if ( frequencies > 0 )
+        {
+            start_t = dtime();
+
+            dft_shot ( v, s, coeffs, rho,
+                       forw_steps, back_steps -1,
+                       dt,dz,dx,dy,
+                       nz0, nzf, nx0, nxf, ny0, nyf,
+                       stacki,
+                       frequencies,
+                       waveletFreq,
+                       shot_gradient,
+                       shot_precond,
+                       &domain );
+
+            print_stats("Frequency domain forward and backward propagation finished in %lf seconds", dtime() - start_t );
+        }
+        else
+        {
+            snapshots_t snapshots;
+            snapshots_setup( &snapshots, shotfolder, &domain );
+
+            start_t = dtime();
+
+            propagate_shot ( FORWARD,
+                             v, s, coeffs, rho,
+                             forw_steps, back_steps -1,
+                             dt,dz,dx,dy,
+                             nz0, nzf, nx0, nxf, ny0, nyf,
+                             stacki,
+                             &snapshots,
+                             NULL,
+                             &domain,
+                             (throughput.steps > 0) ? &throughput : NULL,
+                             NULL,
+                             NULL,
+                             NULL);
+
+            end_t = dtime();
+
+            print_stats("Forward propagation finished in %lf seconds", end_t - start_t );
+
+            /* the backward propagation already runs with the new y ranges */
+            if ( throughput.steps > 0 && domain_rebalance( &domain, &throughput ) )
+            {
+                migrate_shot( &domain, &coeffs, &s, &v, &rho, &image, &snapshots );
 
-        start_t = dtime();
-        
-        propagate_shot ( BACKWARD,
-                         v, s, coeffs, rho,
-                         forw_steps, back_steps -1,
-                         dt,dz,dx,dy,
-                         nz0, nzf, nx0, nxf, ny0, nyf,
-                         stacki,
-                         shotfolder,
-                         io_buffer,
-                         dimmz, dimmx, dimmy);
+                numberOfCells = domain_local_cells( &domain );
+                nyf           = domain.dimmy;
+                shot_gradient = image;
+                shot_precond  = image + numberOfCells * WRITTEN_FIELDS;
+            }
 
-        end_t = dtime();
+            /* it starts from the initial wavefield, as without snapshots */
+            load_initial_wavefield( waveletFreq, &domain, &s, &v );
 
-        print_stats("Backward propagation finished in %lf seconds", end_t - start_t );
+            imaging_t imaging;
+            imaging_setup( &imaging, VELOCITY_FIELDS, numberOfCells, stacki * dt,
+                           shot_gradient, shot_precond, NULL );
 
-#if defined(DO_NOT_PERFORM_IO)
-        print_info("Warning: we are not creating gradient nor preconditioner "
-                   "fields, because IO is not enabled for this execution" );
-#else
+            start_t = dtime();
+        
+            propagate_shot ( BACKWARD,
+                             v, s, coeffs, rho,
+                             forw_steps, back_steps -1,
+                             dt,dz,dx,dy,
+                             nz0, nzf, nx0, nxf, ny0, nyf,
+                             stacki,
+                             &snapshots,
+                             NULL,
+                             &domain,
+                             NULL,
+                             NULL,
+                             NULL,
+                             &imaging);
+
+            end_t = dtime();
+
+            print_stats("Backward propagation finished in %lf seconds", end_t - start_t );
+
+            imaging_release( &imaging );
+            snapshots_release( &snapshots );
+        }
 
-#if defined(USE_MPI)
-        if ( mpi_rank == 0 ) 
-#endif
+        /* per shot volumes only on request, the round keeps their sum */
+        if ( parse_env("FWI_SHOT_GRADIENTS") )
         {
             char fnameGradient[300];
             char fnamePrecond[300];
             sprintf( fnameGradient, "%s/gradient_%05d.dat", shotfolder, shotid );
             sprintf( fnamePrecond , "%s/precond_%05d.dat" , shotfolder, shotid );
 
-            FILE* fgradient = safe_fopen( fnameGradient, "wb", __FILE__, __LINE__ );
-            FILE* fprecond  = safe_fopen( fnamePrecond , "wb", __FILE__, __LINE__ );
+            gradient_write_volumes( fnameGradient, shot_gradient, &domain );
+            gradient_write_volumes( fnamePrecond , shot_precond , &domain );
+        }
 
-            print_info("Storing local preconditioner field in %s", fnameGradient );
-            safe_fwrite( io_buffer, sizeof(real), numberOfCells * 12, fgradient, __FILE__, __LINE__ );
+        start_t = dtime();
 
-            print_info("Storing local gradient field in %s", fnamePrecond);
-            safe_fwrite( io_buffer, sizeof(real), numberOfCells * 12, fprecond , __FILE__, __LINE__ );
+        gradient_accumulate( gradient, &domain, shot_gradient, shot_precond );
 
-            safe_fclose( fnameGradient, fgradient, __FILE__, __LINE__ );
-            safe_fclose( fnamePrecond , fprecond , __FILE__, __LINE__ );
-        }
-#endif /* end DO_NOT_PERFORM_IO */
+        print_stats("Gradient and preconditioner accumulated in %lf seconds", dtime() - start_t );
 
         break;
     }
@@ -182,14 +309,20 @@ void kernel( propagator_t propagator, real waveletFreq, int shotid, char* output
                          dt,dz,dx,dy,
                          nz0, nzf, nx0, nxf, ny0, nyf,
                          stacki,
-                         shotfolder,
-                         io_buffer,
-                         numberOfCells,
-                         dimmz, dimmx);
+                         NULL,
+                         NULL,
+                         &domain,
+                         (throughput.steps > 0) ? &throughput : NULL,
+                         NULL,
+                         NULL,
+                         NULL);
 
         end_t = dtime();
 
         print_stats("Forward Modelling finished in %lf seconds", end_t - start_t );
+
+        /* nothing to migrate, the next shots start with the new y ranges */
+        if ( throughput.steps > 0 ) domain_rebalance( &domain, &throughput );
        
         break;
     }
@@ -202,111 +335,9 @@ void kernel( propagator_t propagator, real waveletFreq, int shotid, char* output
 
     // liberamos la memoria alocatada en el shot
     free_memory_shot  ( &coeffs, &s, &v, &rho);
-    __free( io_buffer );
-};
-
-void gather_shots( char* outputfolder, const real waveletFreq, const int nshots, const int numberOfCells )
-{
-#ifdef DO_NOT_PERFORM_IO
-    print_info("Warning: we are not gathering the results because the IO is disabled "
-               "for this execution");
-#else
-    /* ---------  GLOBAL PRECONDITIONER ACCUMULATION --------- */
-    print_info("Gathering local preconditioner fields");
-
-    /* variables for timming */
-    double start_t, end_t;
-
-    /* buffers to read and accumulate the fields */
-    real* sumbuffer  = (real*)  __malloc( ALIGN_REAL, numberOfCells * sizeof(real) * WRITTEN_FIELDS ); 
-    real* readbuffer = (real*)  __malloc( ALIGN_REAL, numberOfCells * sizeof(real) * WRITTEN_FIELDS );
-    
-    start_t = dtime();
-
-    /* set buffer positions to zero */
-    memset ( sumbuffer, 0, numberOfCells * sizeof(real) * WRITTEN_FIELDS );
-
-    for( int shot=0; shot < nshots; shot++)
-    {
-        char readfilename[300];
-        sprintf( readfilename, "%s/shot.%2.1f.%05d/precond_%05d.dat", 
-                outputfolder, waveletFreq, shot, shot);
-
-        print_info("Reading preconditioner file '%s'", readfilename );
-
-        FILE* freadfile = safe_fopen( readfilename, "rb", __FILE__, __LINE__ );
-        safe_fread ( readbuffer, sizeof(real), numberOfCells * WRITTEN_FIELDS, freadfile, __FILE__, __LINE__ );
-
-#if defined(_OPENMP)
-        #pragma omp parallel for
-#endif
-#if defined(__INTEL_COMPILER)
-        #pragma simd
-#endif
-        for( int i = 0; i < numberOfCells * WRITTEN_FIELDS; i++)
-            sumbuffer[i] += readbuffer[i];
-
-        fclose (freadfile);
-    }
-
-    char precondfilename[300];
-    sprintf( precondfilename, "%s/Preconditioner.%2.1f", outputfolder, waveletFreq );
-    FILE* precondfile = safe_fopen( precondfilename, "wb", __FILE__, __LINE__ );
-    safe_fwrite ( sumbuffer, sizeof(real), numberOfCells * WRITTEN_FIELDS, precondfile, __FILE__, __LINE__ );
-    safe_fclose( precondfilename, precondfile, __FILE__, __LINE__ );
-
-    end_t = dtime();
-
-    print_stats("Gatering process for preconditioner %s (freq %2.1f) " 
-                "completed in: %lf seconds",  
-                precondfilename, waveletFreq, end_t - start_t  );
-
-    /* ---------  GLOBAL GRADIENT ACCUMULATION --------- */
-    print_info("Gathering local gradient fields");
+    __free( image );
 
-    start_t = dtime();
-
-    /* set buffer positions to zero */
-    memset ( sumbuffer, 0, numberOfCells * sizeof(real) * WRITTEN_FIELDS );
-
-    for( int shot=0; shot < nshots; shot++)
-    {
-        char readfilename[300];
-        sprintf( readfilename, "%s/shot.%2.1f.%05d/gradient_%05d.dat", 
-                outputfolder, waveletFreq, shot, shot);
-
-        print_info("Reading gradient file %s", readfilename );
-
-        FILE* freadfile = safe_fopen( readfilename, "rb", __FILE__, __LINE__ );
-        safe_fread ( readbuffer, sizeof(real), numberOfCells * WRITTEN_FIELDS, freadfile, __FILE__, __LINE__ );
-
-#if defined(_OPENMP)
-        #pragma omp parallel for
-#endif
-#ifdef __INTEL_COMPILER
-        #pragma simd
-#endif
-        for( int i = 0; i < numberOfCells * WRITTEN_FIELDS; i++)
-            sumbuffer[i] += readbuffer[i];
-
-        fclose (freadfile);
-    }
-
-    char gradientfilename[300];
-    sprintf( gradientfilename, "%s/Gradient.%2.1f", outputfolder, waveletFreq );
-    FILE* gradientfile = safe_fopen( gradientfilename, "wb", __FILE__, __LINE__ );
-    safe_fwrite ( sumbuffer, sizeof(real), numberOfCells * WRITTEN_FIELDS, gradientfile, __FILE__, __LINE__ );
-    safe_fclose( gradientfilename, gradientfile, __FILE__, __LINE__ );
-
-    end_t = dtime();
-
-    print_stats("Gatering process for gradient %s (freq %2.1f) "        
-                "completed in: %lf seconds", 
-                precondfilename, waveletFreq, end_t - start_t  );
-
-    __free(  sumbuffer);
-    __free( readbuffer);
-#endif
+    domain_release( &domain );
 };
 
 int execute_simulation( int argc, char* argv[] )
@@ -315,9 +346,20 @@ int execute_simulation( int argc, char* argv[] )
     int mpi_rank;
 
     int subdomains;
+#if defined(_OPENMP)
+    /* the halo exchanges may be progressed by the master thread of a
+     * parallel region while the rest of the team computes (FWI_COMM_THREAD) */
+    int thread_level;
+    MPI_Init_thread ( &argc, &argv, MPI_THREAD_FUNNELED, &thread_level );
+#else
     MPI_Init ( &argc, &argv );
+#endif
     MPI_Comm_size( MPI_COMM_WORLD, &subdomains);
     MPI_Comm_rank( MPI_COMM_WORLD, &mpi_rank);
+#if defined(_OPENMP)
+    if ( thread_level < MPI_THREAD_FUNNELED )
+        print_info("MPI library does not support MPI_THREAD_FUNNELED, communication thread disabled");
+#endif
 #elif !defined(USE_MPI) && defined(_OPENACC)
     //TODO: fix name
     int mpi_rank = 0;
@@ -337,13 +379,20 @@ int execute_simulation( int argc, char* argv[] )
 
     read_fwi_parameters( argv[1], &lenz, &lenx, &leny, &vmin, &srclen, &rcvlen, outputfolder);
 
-    const int nshots = 1;
+    /* shots from the geometry file, handed out to groups of processes */
+    sched_t sched;
+    sched_setup( &sched, (argc > 3) ? argv[3] : NULL );
+
     const int ngrads = 1;
     //const int ntest  = 0;
 
     int   nfreqs;
     real *frequencies;
 
+    /* the reduction of a round overlaps the shots of the next one */
+    gradient_t pending;
+    int        has_pending = 0;
+
     load_freqlist( argv[2], &nfreqs, &frequencies );
 
     for(int i=0; i<nfreqs; i++)
@@ -368,10 +417,10 @@ int execute_simulation( int argc, char* argv[] )
         /* dynamic I/O */
         integer stacki = floor( 0.25 / (2.5 * waveletFreq * dt) );
 
-        const integer numberOfCells = dimmz * dimmx * dimmx;
+        const integer numberOfCells = dimmz * dimmx * dimmy;
         const size_t VolumeMemory  = numberOfCells * sizeof(real) * 58;
 
-        print_stats("Local domain size for freq %f [%d][%d][%d] is %lu bytes (%lf GB)", 
+        print_stats("Global domain size for freq %f [%d][%d][%d] is %lu bytes (%lf GB)", 
                     waveletFreq, dimmz, dimmx, dimmy, VolumeMemory, TOGB(VolumeMemory) );
 
         /* compute time steps */
@@ -383,13 +432,17 @@ int execute_simulation( int argc, char* argv[] )
             fprintf(stderr, "Processing %d-th gradient iteration.\n", grad);
             print_info("Processing %d-gradient iteration", grad);
 
-            for(int shot=0; shot<nshots; shot++)
+            gradient_t gradient;
+            gradient_setup( &gradient, &sched, dimmz, dimmx, dimmy, outputfolder, waveletFreq );
+
+            int shot;
+            while ( (shot = sched_next_shot( &sched )) >= 0 )
             {
                 char shotfolder[200];
                 sprintf(shotfolder, "%s/shot.%2.1f.%05d", outputfolder, waveletFreq, shot);
                 
 #if defined(USE_MPI)
-                if ( mpi_rank == 0 ) 
+                if ( sched.leader ) 
                 {
                     create_folder( shotfolder );
 
@@ -398,7 +451,7 @@ int execute_simulation( int argc, char* argv[] )
                                            &dimmz, &dimmx, &dimmy, 
                                            outputfolder, waveletFreq );
                 }
-                MPI_Barrier( MPI_COMM_WORLD );
+                MPI_Barrier( sched.comm );
 #else
                 create_folder( shotfolder );
 
@@ -408,7 +461,9 @@ int execute_simulation( int argc, char* argv[] )
                                        outputfolder, waveletFreq );
 #endif
 
-                kernel( RTM_KERNEL, waveletFreq, shot, outputfolder, shotfolder);
+                kernel( RTM_KERNEL, waveletFreq, shot, outputfolder, shotfolder, &gradient);
+
+                if ( has_pending ) gradient_progress( &pending );
 
                 fprintf(stderr, "\tGradient loop processed for the %d-th shot\n", shot);
                 print_info("\tGradient loop processed for %d-th shot", shot);
@@ -416,17 +471,14 @@ int execute_simulation( int argc, char* argv[] )
                 //update_shot()
             }
 
-#if defined(USE_MPI)
-            MPI_Barrier( MPI_COMM_WORLD );
-            
-            if ( mpi_rank == 0 ) { 
-                gather_shots( outputfolder, waveletFreq, nshots, numberOfCells );    
-            }
-            
-            MPI_Barrier( MPI_COMM_WORLD );
-#else
-            gather_shots( outputfolder, waveletFreq, nshots, numberOfCells );
-#endif
+            /* every shot of the iteration is done */
+            sched_end_round( &sched );
+
+            if ( has_pending ) gradient_finish( &pending );
+
+            pending     = gradient;
+            has_pending = 1;
+            gradient_reduce( &pending );
 
             #if 0
             for(int test=0; test<ntest; test++)
@@ -434,7 +486,7 @@ int execute_simulation( int argc, char* argv[] )
                 fprintf(stderr, "\tProcessing %d-th test iteration.\n", test);
                 print_info("\tProcessing %d-th test iteration", test);
                 
-                for(int shot=0; shot<nshots; shot++)
+                for(int shot=0; shot<sched.nshots; shot++)
                 {
                     char shotfolder[200];
                     sprintf(shotfolder, "%s/test.%05d.shot.%2.1f.%05d", 
@@ -452,7 +504,7 @@ int execute_simulation( int argc, char* argv[] )
 
                     MPI_Barrier( MPI_COMM_WORLD );
 
-                    kernel( FM_KERNEL , waveletFreq, shot, outputfolder, shotfolder);
+                    kernel( FM_KERNEL , waveletFreq, shot, outputfolder, shotfolder, NULL);
                 
                     fprintf(stderr, "\t\tTest loop processed for the %d-th shot\n", shot);
                     print_info("\t\tTest loop processed for the %d-th shot", shot);
@@ -462,6 +514,13 @@ int execute_simulation( int argc, char* argv[] )
         } /* end of gradient loop */
     } /* end of frequency loop */
 
+    if ( has_pending ) gradient_finish( &pending );
+
+    sched_release( &sched );
+
+    /* what every I/O backend moved in this process */
+    io_stats_report();
+
 #ifdef USE_MPI
     MPI_Barrier(MPI_COMM_WORLD);
     MPI_Finalize();
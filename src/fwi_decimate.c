@@ -0,0 +1,324 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#include "fwi/fwi_decimate.h"
+#include "fwi/fwi_propagator.h"
+
+static inline integer imin ( const integer a, const integer b ) { return ( a < b ) ? a : b; };
+static inline integer imax ( const integer a, const integer b ) { return ( a > b ) ? a : b; };
+
+static inline integer ceil_div ( const integer a, const integer b ) { return (a + b - 1) / b; };
+
+int decimate_from_env ( integer *factor )
+{
+    *factor = parse_env("FWI_SNAPSHOT_DECIMATION");
+
+    if ( *factor < 2 ) *factor = 0;
+
+    /* processes own 2*HALO planes or more, and keep a coarse one at least */
+    if ( *factor > 2*HALO ) *factor = 2*HALO;
+
+    return ( *factor != 0 );
+};
+
+integer decimate_coarse_cells ( const integer n,
+                                const integer factor )
+{
+    return ceil_div( n - 1, factor ) + 1;
+};
+
+/*
+ * Coarse cells [*c0,*cf) taken from the fine cells [f0,ff) of an axis of
+ * 'n' cells: the multiples of the factor, and the last coarse cell for the
+ * process that has the last fine cell.
+ */
+static void owned_coarse ( const integer  f0,
+                           const integer  ff,
+                           const integer  n,
+                           const integer  factor,
+                           integer       *c0,
+                           integer       *cf )
+{
+    *c0 = ceil_div( f0, factor );
+    *cf = ( ff == n ) ? decimate_coarse_cells( n, factor ) : ceil_div( ff, factor );
+};
+
+/*
+ * The same decomposition seen on the coarse grid, for domain_write_box and
+ * domain_read_box: the local array is the coarse box 'b', in global cells.
+ */
+static domain_t coarse_domain ( const domain_t *d,
+                                const integer   factor,
+                                const box_t     b )
+{
+    domain_t c = *d;
+
+    c.gdimmz = decimate_coarse_cells( d->gdimmz, factor );
+    c.gdimmx = decimate_coarse_cells( d->gdimmx, factor );
+    c.gdimmy = decimate_coarse_cells( d->gdimmy, factor );
+    c.dimmz  = b.zf - b.z0;
+    c.dimmx  = b.xf - b.x0;
+    c.dimmy  = b.yf - b.y0;
+    c.z0     = b.z0;
+    c.x0     = b.x0;
+    c.y0     = b.y0;
+
+    return c;
+};
+
+/* the cell given in global cells, averaged with its six neighbours */
+static inline real smoothed ( const real     *field,
+                              const domain_t *d,
+                              const integer   z,
+                              const integer   x,
+                              const integer   y )
+{
+    const integer lz = z - d->z0, zm = imax( z - 1, 0 ) - d->z0, zp = imin( z + 1, d->gdimmz - 1 ) - d->z0;
+    const integer lx = x - d->x0, xm = imax( x - 1, 0 ) - d->x0, xp = imin( x + 1, d->gdimmx - 1 ) - d->x0;
+    const integer ly = y - d->y0, ym = imax( y - 1, 0 ) - d->y0, yp = imin( y + 1, d->gdimmy - 1 ) - d->y0;
+
+    const integer dimmz = d->dimmz;
+    const integer dimmx = d->dimmx;
+
+    return 0.25f  *   field[IDX(lz, lx, ly, dimmz, dimmx)]
+         + 0.125f * ( field[IDX(zm, lx, ly, dimmz, dimmx)] + field[IDX(zp, lx, ly, dimmz, dimmx)]
+                    + field[IDX(lz, xm, ly, dimmz, dimmx)] + field[IDX(lz, xp, ly, dimmz, dimmx)]
+                    + field[IDX(lz, lx, ym, dimmz, dimmx)] + field[IDX(lz, lx, yp, dimmz, dimmx)] );
+};
+
+void decimate_write_volumes ( const integer   factor,
+                              const char     *fname,
+                              real           *fields[],
+                              const integer   nfields,
+                              const domain_t *d )
+{
+    PUSH_RANGE
+
+#if defined(LOG_IO_STATS)
+    const double tstart = dtime();
+#endif
+
+    /* the coarse cells taken from the cells this process owns */
+    const box_t owned = domain_owned_box( d );
+    box_t coarse;
+
+    owned_coarse( owned.z0 + d->z0, owned.zf + d->z0, d->gdimmz, factor, &coarse.z0, &coarse.zf );
+    owned_coarse( owned.x0 + d->x0, owned.xf + d->x0, d->gdimmx, factor, &coarse.x0, &coarse.xf );
+    owned_coarse( owned.y0 + d->y0, owned.yf + d->y0, d->gdimmy, factor, &coarse.y0, &coarse.yf );
+
+    const domain_t c      = coarse_domain( d, factor, coarse );
+    const box_t    all    = domain_local_box( &c );
+    const integer  ncells = box_cells( all );
+    const size_t   bytes  = (size_t) c.gdimmz * c.gdimmx * c.gdimmy * sizeof(real) * nfields;
+
+    real *buffer = (real*) __malloc( ALIGN_REAL, (size_t) ncells * sizeof(real) );
+
+    io_file_t file;
+    io_open( &file, fname, 1, bytes );
+
+    for (integer f = 0; ncells > 0 && f < nfields; f++)
+    {
+#if defined(_OPENMP)
+        #pragma omp parallel for
+#endif
+        for (integer y = 0; y < c.dimmy; y++)
+            for (integer x = 0; x < c.dimmx; x++)
+                for (integer z = 0; z < c.dimmz; z++)
+                    buffer[IDX(z, x, y, c.dimmz, c.dimmx)] =
+                        smoothed( fields[f], d, imin( (z + c.z0) * factor, d->gdimmz - 1 ),
+                                                imin( (x + c.x0) * factor, d->gdimmx - 1 ),
+                                                imin( (y + c.y0) * factor, d->gdimmy - 1 ) );
+
+        domain_write_box( &file, f, buffer, &c, all );
+    }
+
+    io_close( &file );
+
+#if defined(LOG_IO_STATS)
+    const double seconds = dtime() - tstart;
+
+    print_stats("Decimated snapshot (%lf GB to %lf GB) written in %lf seconds",
+                TOGB( (size_t) box_cells( owned ) * nfields * sizeof(real) ),
+                TOGB( (size_t) ncells * nfields * sizeof(real) ), seconds);
+#endif
+
+    __free( buffer );
+
+    POP_RANGE
+};
+
+/*
+ * Interpolation of every local fine cell of an axis of 'gn' cells from the
+ * coarse cells lo[i] .. lo[i]+3, with the weights w[4*i] .. w[4*i+3]: cubic
+ * (Lagrange) between the two coarse cells around it, linear next to the ends
+ * of the axis. The local cells start at global cell g0 and the coarse ones
+ * at c0.
+ */
+static void interpolation_axis ( const integer  g0,
+                                 const integer  n,
+                                 const integer  gn,
+                                 const integer  c0,
+                                 const integer  factor,
+                                 integer       *lo,
+                                 real          *w )
+{
+    const integer last = decimate_coarse_cells( gn, factor ) - 1;
+
+    for (integer i = 0; i < n; i++)
+    {
+        const integer g    = g0 + i;
+        const integer G    = g / factor;
+        const integer next = imin( (G + 1) * factor, gn - 1 );
+        const real    t    = ( next > G * factor ) ? (real) (g - G * factor) / (next - G * factor) : 0.f;
+
+        real *wi = w + 4 * i;
+
+        if ( G >= 1 && (G + 2) * factor <= gn - 1 )
+        {
+            lo[i] = G - 1 - c0;
+            wi[0] = -t * (t - 1.f) * (t - 2.f) / 6.f;
+            wi[1] = (t + 1.f) * (t - 1.f) * (t - 2.f) / 2.f;
+            wi[2] = -(t + 1.f) * t * (t - 2.f) / 2.f;
+            wi[3] = (t + 1.f) * t * (t - 1.f) / 6.f;
+        }
+        else
+        {
+            /* the last fine cell sits on the last coarse one */
+            lo[i] = imin( G, last - 1 ) - c0;
+            wi[0] = ( G < last ) ? 1.f - t : 0.f;
+            wi[1] = ( G < last ) ? t : 1.f;
+            wi[2] = 0.f;
+            wi[3] = 0.f;
+        }
+    }
+};
+
+void decimate_read_volumes ( const integer   factor,
+                             const char     *fname,
+                             real           *fields[],
+                             const integer   nfields,
+                             const domain_t *d )
+{
+    PUSH_RANGE
+
+    /* the coarse cells around the local box, ghost cells included */
+    const integer gdimmz = decimate_coarse_cells( d->gdimmz, factor );
+    const integer gdimmx = decimate_coarse_cells( d->gdimmx, factor );
+    const integer gdimmy = decimate_coarse_cells( d->gdimmy, factor );
+
+    const box_t coarse = { imax( d->z0 / factor - 1, 0 ), imin( (d->z0 + d->dimmz - 1) / factor + 3, gdimmz ),
+                           imax( d->x0 / factor - 1, 0 ), imin( (d->x0 + d->dimmx - 1) / factor + 3, gdimmx ),
+                           imax( d->y0 / factor - 1, 0 ), imin( (d->y0 + d->dimmy - 1) / factor + 3, gdimmy ) };
+
+    const domain_t c   = coarse_domain( d, factor, coarse );
+    const box_t    all = domain_local_box( &c );
+
+    const integer nz = d->dimmz, nx = d->dimmx, ny = d->dimmy;
+    const integer cz = c.dimmz,  cx = c.dimmx,  cy = c.dimmy;
+
+    integer *lo = (integer*) __malloc( ALIGN_INTEGER, (nz + nx + ny) * sizeof(integer) );
+    real    *w  = (real*   ) __malloc( ALIGN_REAL,    (nz + nx + ny) * 4 * sizeof(real) );
+
+    integer *loz = lo, *lox = lo + nz,    *loy = lox + nx;
+    real    *wz  = w,  *wx  = w  + 4*nz,  *wy  = wx  + 4*nx;
+
+    interpolation_axis( d->z0, nz, d->gdimmz, c.z0, factor, loz, wz );
+    interpolation_axis( d->x0, nx, d->gdimmx, c.x0, factor, lox, wx );
+    interpolation_axis( d->y0, ny, d->gdimmy, c.y0, factor, loy, wy );
+
+    /* the coarse volume, and the volume interpolated along z, then x */
+    real *buffer = (real*) __malloc( ALIGN_REAL, (size_t) box_cells( all ) * sizeof(real) );
+    real *alongz = (real*) __malloc( ALIGN_REAL, (size_t) nz * cx * cy * sizeof(real) );
+    real *alongx = (real*) __malloc( ALIGN_REAL, (size_t) nz * nx * cy * sizeof(real) );
+
+    io_file_t file;
+    io_open( &file, fname, 0, 0 );
+
+    for (integer f = 0; f < nfields; f++)
+    {
+        domain_read_box( &file, f, buffer, &c, all );
+
+        real *field = fields[f];
+
+#if defined(_OPENMP)
+        #pragma omp parallel
+#endif
+        {
+#if defined(_OPENMP)
+            #pragma omp for
+#endif
+            for (integer y = 0; y < cy; y++)
+                for (integer x = 0; x < cx; x++)
+                    for (integer z = 0; z < nz; z++)
+                    {
+                        real v = 0.f;
+                        for (integer j = 0; j < 4; j++)
+                            v += wz[4*z + j] * buffer[IDX(imin( loz[z] + j, cz - 1 ), x, y, cz, cx)];
+                        alongz[IDX(z, x, y, nz, cx)] = v;
+                    }
+
+#if defined(_OPENMP)
+            #pragma omp for
+#endif
+            for (integer y = 0; y < cy; y++)
+                for (integer x = 0; x < nx; x++)
+                    for (integer z = 0; z < nz; z++)
+                    {
+                        real v = 0.f;
+                        for (integer j = 0; j < 4; j++)
+                            v += wx[4*x + j] * alongz[IDX(z, imin( lox[x] + j, cx - 1 ), y, nz, cx)];
+                        alongx[IDX(z, x, y, nz, nx)] = v;
+                    }
+
+#if defined(_OPENMP)
+            #pragma omp for
+#endif
+            for (integer y = 0; y < ny; y++)
+                for (integer x = 0; x < nx; x++)
+                    for (integer z = 0; z < nz; z++)
+                    {
+                        real v = 0.f;
+                        for (integer j = 0; j < 4; j++)
+                            v += wy[4*y + j] * alongx[IDX(z, x, imin( loy[y] + j, cy - 1 ), nz, nx)];
+                        field[IDX(z, x, y, nz, nx)] = v;
+                    }
+        }
+    }
+
+    io_close( &file );
+
+    __free( buffer );
+    __free( alongz );
+    __free( alongx );
+    __free( lo );
+    __free( w );
+
+    POP_RANGE
+};
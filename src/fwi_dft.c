@@ -0,0 +1,166 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#include "fwi/fwi_dft.h"
+
+/* cells of a field updated at once for all the frequencies, while in cache */
+#define DFT_BLOCK 2048
+
+#define DFT_PI 3.14159265358979323846
+
+void dft_setup ( dft_t        *dft,
+                 const int     nfreqs,
+                 const real    waveletFreq,
+                 const real    dt,
+                 const int     nfields,
+                 const integer ncells )
+{
+    const size_t bytes = (size_t) nfreqs * nfields * ncells * sizeof(real);
+
+    dft->nfreqs  = nfreqs;
+    dft->nfields = nfields;
+    dft->ncells  = ncells;
+    dft->dt      = dt;
+    dft->omega   = (real*) __malloc( ALIGN_REAL, nfreqs * sizeof(real) );
+    dft->re      = (real*) __malloc( ALIGN_REAL, bytes );
+    dft->im      = (real*) __malloc( ALIGN_REAL, bytes );
+
+    for (int k = 0; k < nfreqs; k++)
+    {
+        const real scale = ( nfreqs > 1 ) ? 0.5f + (real) k / (nfreqs - 1) : 1.f;
+        dft->omega[k] = 2.0 * DFT_PI * scale * waveletFreq;
+    }
+
+    memset( dft->re, 0, bytes );
+    memset( dft->im, 0, bytes );
+};
+
+void dft_release ( dft_t *dft )
+{
+    __free( dft->omega );
+    __free( dft->re );
+    __free( dft->im );
+};
+
+void dft_accumulate ( dft_t *dft,
+                      real  *fields[],
+                      const real time )
+{
+    PUSH_RANGE
+
+    const int     nfreqs = dft->nfreqs;
+    const integer ncells = dft->ncells;
+
+    /* e^(-i w t) dt of every frequency */
+    real *c = (real*) __malloc( ALIGN_REAL, 2 * nfreqs * sizeof(real) );
+    real *s = c + nfreqs;
+
+    for (int k = 0; k < nfreqs; k++)
+    {
+        c[k] =  cos( dft->omega[k] * time ) * dft->dt;
+        s[k] = -sin( dft->omega[k] * time ) * dft->dt;
+    }
+
+#if defined(_OPENMP)
+    #pragma omp parallel for
+#endif
+    for (integer i0 = 0; i0 < ncells; i0 += DFT_BLOCK)
+    {
+        const integer i1 = ( i0 + DFT_BLOCK < ncells ) ? i0 + DFT_BLOCK : ncells;
+
+        for (int f = 0; f < dft->nfields; f++)
+        {
+            const real* restrict u = fields[f];
+
+            for (int k = 0; k < nfreqs; k++)
+            {
+                real* restrict re = dft->re + ((size_t) k * dft->nfields + f) * ncells;
+                real* restrict im = dft->im + ((size_t) k * dft->nfields + f) * ncells;
+                const real ck = c[k];
+                const real sk = s[k];
+
+#if defined(__INTEL_COMPILER)
+                #pragma simd
+#endif
+                for (integer i = i0; i < i1; i++)
+                {
+                    re[i] += ck * u[i];
+                    im[i] += sk * u[i];
+                }
+            }
+        }
+    }
+
+    __free( c );
+
+    POP_RANGE
+};
+
+void dft_image ( const dft_t *forward,
+                 const dft_t *backward,
+                 real        *gradient,
+                 real        *precond )
+{
+    PUSH_RANGE
+
+    const integer ncells  = forward->ncells;
+    const int     nfields = forward->nfields;
+
+    for (int f = 0; f < nfields; f++)
+    {
+        real* restrict g = gradient + (size_t) f * ncells;
+        real* restrict p = precond  + (size_t) f * ncells;
+
+        for (int k = 0; k < forward->nfreqs; k++)
+        {
+            const size_t volume = ((size_t) k * nfields + f) * ncells;
+
+            const real* restrict fre = forward ->re + volume;
+            const real* restrict fim = forward ->im + volume;
+            const real* restrict bre = backward->re + volume;
+            const real* restrict bim = backward->im + volume;
+
+            /* Re( F conj(B) ) and |F|^2 */
+#if defined(_OPENMP)
+            #pragma omp parallel for
+#endif
+#if defined(__INTEL_COMPILER)
+            #pragma simd
+#endif
+            for (integer i = 0; i < ncells; i++)
+            {
+                g[i] += fre[i] * bre[i] + fim[i] * bim[i];
+                p[i] += fre[i] * fre[i] + fim[i] * fim[i];
+            }
+        }
+    }
+
+    POP_RANGE
+};
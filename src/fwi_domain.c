@@ -0,0 +1,672 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+#include "fwi/fwi_domain.h"
+#include "fwi/fwi_propagator.h"
+
+static const char axis_name[3] = { 'y', 'x', 'z' };
+
+/* y planes of every process row chosen by the last rebalancing */
+static integer *balanced_planes = NULL;
+static int      balanced_rows   = 0;
+static integer  balanced_gdimmy = 0;
+
+#if defined(USE_MPI)
+static MPI_Comm parent_comm;
+static int      parent_set = 0;
+
+void domain_set_parent ( MPI_Comm comm )
+{
+    parent_comm = comm;
+    parent_set  = 1;
+};
+#endif
+
+static void setup_domain ( domain_t     *d,
+                           const integer dimmz,
+                           const integer dimmx,
+                           const integer dimmy,
+                           const int     balanced )
+{
+    const integer gdimm[3] = { dimmy, dimmx, dimmz };
+    integer dimm  [3];
+    integer origin[3];
+
+    d->gdimmz = dimmz;
+    d->gdimmx = dimmx;
+    d->gdimmy = dimmy;
+
+#if defined(USE_MPI)
+    /* number of decomposed axes, taken in y, x, z order */
+    int ndims = parse_env("FWI_DECOMP_DIMS");
+    if ( ndims == 0 ) ndims = 1;
+    if ( ndims < 1 || ndims > 3 )
+    {
+        print_info("FWI_DECOMP_DIMS=%d is not valid, using a 1D decomposition along y", ndims);
+        ndims = 1;
+    }
+
+    MPI_Comm parent = ( parent_set ) ? parent_comm : MPI_COMM_WORLD;
+    MPI_Comm_size( parent, &d->nranks );
+
+    for (int a = 0; a < 3; a++)
+        d->dims[a] = ( a < ndims ) ? 0 : 1;
+
+    MPI_Dims_create( d->nranks, 3, d->dims );
+
+    /* keep the ranks of the parent: y-slowest order, as the files */
+    const int periods[3] = { 0, 0, 0 };
+    MPI_Cart_create( parent, 3, d->dims, periods, 0, &d->comm );
+    MPI_Comm_rank  ( d->comm, &d->rank );
+    MPI_Cart_coords( d->comm, d->rank, 3, d->coords );
+
+    for (int a = 0; a < 3; a++)
+        MPI_Cart_shift( d->comm, a, 1, &d->neighbours[2*a], &d->neighbours[2*a+1] );
+#else
+    d->rank   = 0;
+    d->nranks = 1;
+
+    for (int a = 0; a < 3; a++)
+    {
+        d->dims  [a]         = 1;
+        d->coords[a]         = 0;
+        d->neighbours[2*a]   = NO_NEIGHBOUR;
+        d->neighbours[2*a+1] = NO_NEIGHBOUR;
+    }
+#endif
+
+    /* the last process of each axis gets the remaining cells */
+    for (int a = 0; a < 3; a++)
+    {
+        const integer interior   = gdimm[a] - 2*HALO;
+        const integer per_domain = interior / d->dims[a];
+        const integer remaining  = interior % d->dims[a];
+
+        if ( per_domain < 2*HALO )
+        {
+            print_error("Splitting axis %c among %d processes leaves " I " cells per process, "
+                        "at least " I " are needed", axis_name[a], d->dims[a], per_domain, 2*HALO);
+            abort();
+        }
+
+        origin[a] = per_domain * d->coords[a];
+        dimm  [a] = per_domain + 2*HALO + ((d->coords[a] == d->dims[a]-1) ? remaining : 0);
+
+        /* uneven y ranges, once the throughput of the processes is known */
+        if ( a == AXIS_Y && balanced && balanced_planes != NULL &&
+             balanced_rows == d->dims[a] && balanced_gdimmy == gdimm[a] )
+        {
+            origin[a] = 0;
+            for (int c = 0; c < d->coords[a]; c++)
+                origin[a] += balanced_planes[c];
+
+            dimm[a] = balanced_planes[ d->coords[a] ] + 2*HALO;
+        }
+    }
+
+    d->dimmy = dimm[AXIS_Y]; d->y0 = origin[AXIS_Y];
+    d->dimmx = dimm[AXIS_X]; d->x0 = origin[AXIS_X];
+    d->dimmz = dimm[AXIS_Z]; d->z0 = origin[AXIS_Z];
+
+    /* files written by sections need the boxes of all the processes */
+    box_t owned = domain_owned_box( d );
+    owned.z0 += d->z0; owned.zf += d->z0;
+    owned.x0 += d->x0; owned.xf += d->x0;
+    owned.y0 += d->y0; owned.yf += d->y0;
+
+    d->owners = (box_t*) __malloc( ALIGN_INT, d->nranks * sizeof(box_t) );
+#if defined(USE_MPI)
+    MPI_Allgather( &owned, 6, MPI_INT, d->owners, 6, MPI_INT, d->comm );
+#else
+    d->owners[0] = owned;
+#endif
+
+    print_info("Process %d of %d at (y:%d,x:%d,z:%d) in a %dx%dx%d grid, local domain "
+               "zxy[" I "][" I "][" I "] from global cell (" I "," I "," I ")",
+               d->rank, d->nranks, d->coords[AXIS_Y], d->coords[AXIS_X], d->coords[AXIS_Z],
+               d->dims[AXIS_Y], d->dims[AXIS_X], d->dims[AXIS_Z],
+               d->dimmz, d->dimmx, d->dimmy, d->z0, d->x0, d->y0);
+};
+
+void domain_setup ( domain_t     *d,
+                    const integer dimmz,
+                    const integer dimmx,
+                    const integer dimmy )
+{
+    setup_domain( d, dimmz, dimmx, dimmy, 1 );
+};
+
+void domain_setup_even ( domain_t     *d,
+                         const integer dimmz,
+                         const integer dimmx,
+                         const integer dimmy )
+{
+    setup_domain( d, dimmz, dimmx, dimmy, 0 );
+};
+
+void domain_release ( domain_t *d )
+{
+    __free( d->owners );
+#if defined(USE_MPI)
+    MPI_Comm_free( &d->comm );
+#endif
+};
+
+void domain_balance_planes ( const integer interior,
+                             const int     n,
+                             const double *rates,
+                             integer      *planes )
+{
+    double total = 0.0;
+    for (int c = 0; c < n; c++)
+        total += rates[c];
+
+    integer assigned = 0;
+    for (int c = 0; c < n; c++)
+    {
+        const double ideal = interior * rates[c] / total;
+
+        planes[c] = (integer) ideal;
+        if ( planes[c] < 2*HALO ) planes[c] = 2*HALO;
+        assigned += planes[c];
+    }
+
+    /* planes left (or taken) one at a time, where the share is the most off */
+    while ( assigned != interior )
+    {
+        int    pick = -1;
+        double best = 0.0;
+
+        for (int c = 0; c < n; c++)
+        {
+            const double excess = planes[c] - interior * rates[c] / total;
+
+            if ( assigned < interior && (pick < 0 || -excess > best) )
+            {
+                pick = c; best = -excess;
+            }
+            if ( assigned > interior && planes[c] > 2*HALO && (pick < 0 || excess > best) )
+            {
+                pick = c; best = excess;
+            }
+        }
+
+        planes[pick] += ( assigned < interior ) ? 1 : -1;
+        assigned     += ( assigned < interior ) ? 1 : -1;
+    }
+};
+
+int domain_rebalance ( const domain_t     *d,
+                       const throughput_t *throughput )
+{
+#if defined(USE_MPI)
+    const int rows = d->dims[AXIS_Y];
+    if ( rows < 2 ) return 0;
+
+    /* busy seconds of the slowest process of every row, and its planes */
+    double  *seconds = (double* ) __malloc( ALIGN_REAL, rows * sizeof(double)  );
+    integer *current = (integer*) __malloc( ALIGN_INT,  rows * sizeof(integer) );
+    integer *planes  = (integer*) __malloc( ALIGN_INT,  rows * sizeof(integer) );
+    double  *rates   = (double* ) __malloc( ALIGN_REAL, rows * sizeof(double)  );
+
+    for (int c = 0; c < rows; c++)
+    {
+        seconds[c] = 0.0;
+        current[c] = 0;
+    }
+    seconds[ d->coords[AXIS_Y] ] = ( throughput->measured > 0 ) ? throughput->seconds : 0.0;
+    current[ d->coords[AXIS_Y] ] = d->dimmy - 2*HALO;
+
+    MPI_Allreduce( MPI_IN_PLACE, seconds, rows, MPI_DOUBLE, MPI_MAX, d->comm );
+    MPI_Allreduce( MPI_IN_PLACE, current, rows, MPI_INT,    MPI_MAX, d->comm );
+
+    int measured = 1;
+    for (int c = 0; c < rows; c++)
+    {
+        if ( seconds[c] <= 0.0 ) measured = 0;
+        else rates[c] = current[c] / seconds[c];
+    }
+
+    int changed = 0;
+
+    if ( measured )
+    {
+        domain_balance_planes( d->gdimmy - 2*HALO, rows, rates, planes );
+
+        /* time of a step is set by the slowest row */
+        double before = 0.0, after = 0.0;
+        for (int c = 0; c < rows; c++)
+        {
+            if ( current[c] / rates[c] > before ) before = current[c] / rates[c];
+            if ( planes [c] / rates[c] > after  ) after  = planes [c] / rates[c];
+        }
+
+        /* small gains are not worth moving the fields, nor the noise */
+        changed = ( after < 0.95 * before );
+
+        print_info("Load balance: slowest row %lf s before, %lf s expected with the new y ranges (%s)",
+                   before, after, (changed) ? "applied" : "kept the current ones");
+
+        if ( changed )
+        {
+            if ( balanced_planes != NULL ) __free( balanced_planes );
+
+            balanced_planes = planes;
+            balanced_rows   = rows;
+            balanced_gdimmy = d->gdimmy;
+            planes          = NULL;
+
+            for (int c = 0; c < rows; c++)
+                print_info("Load balance: process row %d gets " I " y planes (" I " before), %.1lf planes/s",
+                           c, balanced_planes[c], current[c], rates[c]);
+        }
+    }
+
+    __free( seconds );
+    __free( current );
+    __free( rates   );
+    if ( planes != NULL ) __free( planes );
+
+    return changed;
+#else
+    (void) d;
+    (void) throughput;
+    return 0;
+#endif
+};
+
+#if defined(USE_MPI)
+/*
+ * Global y planes a row owned before the migration: its interior, plus the
+ * outer HALO at the physical boundary. 'ranges' holds y0,dimmy per row.
+ */
+static void owned_planes ( const integer *ranges,
+                           const int      rows,
+                           const int      c,
+                           integer       *lo,
+                           integer       *hi )
+{
+    *lo = ranges[4*c] + ((c == 0)      ? 0 : HALO);
+    *hi = ranges[4*c] + ranges[4*c+1] - ((c == rows-1) ? 0 : HALO);
+};
+#endif
+
+void domain_migrate ( const domain_t *from,
+                      const domain_t *to,
+                      real           *src[],
+                      real           *dst[],
+                      const integer   nfields )
+{
+#if defined(USE_MPI)
+    PUSH_RANGE
+
+    /* processes of the same x-z column, ranked by their y coordinate */
+    const int remain[3] = { 1, 0, 0 };
+    MPI_Comm column;
+    MPI_Cart_sub( from->comm, remain, &column );
+
+    const int rows = from->dims[AXIS_Y];
+    const int me   = from->coords[AXIS_Y];
+
+    integer  ranges[4] = { from->y0, from->dimmy, to->y0, to->dimmy };
+    integer *all = (integer*) __malloc( ALIGN_INT, 4 * rows * sizeof(integer) );
+    MPI_Allgather( ranges, 4, MPI_INT, all, 4, MPI_INT, column );
+
+    int *sendcounts = (int*) __malloc( ALIGN_INT, rows * sizeof(int) );
+    int *sdispls    = (int*) __malloc( ALIGN_INT, rows * sizeof(int) );
+    int *recvcounts = (int*) __malloc( ALIGN_INT, rows * sizeof(int) );
+    int *rdispls    = (int*) __malloc( ALIGN_INT, rows * sizeof(int) );
+
+    for (int p = 0; p < rows; p++)
+    {
+        integer lo, hi;
+
+        owned_planes( all, rows, me, &lo, &hi );
+        if ( all[4*p+2]              > lo ) lo = all[4*p+2];
+        if ( all[4*p+2] + all[4*p+3] < hi ) hi = all[4*p+2] + all[4*p+3];
+
+        sendcounts[p] = ( hi > lo ) ? hi - lo : 0;
+        sdispls   [p] = ( hi > lo ) ? lo - from->y0 : 0;
+
+        owned_planes( all, rows, p, &lo, &hi );
+        if ( to->y0              > lo ) lo = to->y0;
+        if ( to->y0 + to->dimmy  < hi ) hi = to->y0 + to->dimmy;
+
+        recvcounts[p] = ( hi > lo ) ? hi - lo : 0;
+        rdispls   [p] = ( hi > lo ) ? lo - to->y0 : 0;
+    }
+
+    /* x-z planes are the same size in both domains */
+    MPI_Datatype plane;
+    MPI_Type_contiguous( from->dimmz * from->dimmx, MPI_FLOAT, &plane );
+    MPI_Type_commit( &plane );
+
+    for (integer f = 0; f < nfields; f++)
+        MPI_Alltoallv( src[f], sendcounts, sdispls, plane,
+                       dst[f], recvcounts, rdispls, plane, column );
+
+    MPI_Type_free( &plane );
+    MPI_Comm_free( &column );
+
+    __free( all );
+    __free( sendcounts );
+    __free( sdispls    );
+    __free( recvcounts );
+    __free( rdispls    );
+
+    POP_RANGE
+#else
+    for (integer f = 0; f < nfields; f++)
+        memcpy( dst[f], src[f], domain_local_cells(to) * sizeof(real) );
+
+    (void) from;
+#endif
+};
+
+integer domain_local_cells ( const domain_t *d )
+{
+    return d->dimmz * d->dimmx * d->dimmy;
+};
+
+box_t domain_local_box ( const domain_t *d )
+{
+    const box_t b = { 0, d->dimmz, 0, d->dimmx, 0, d->dimmy };
+    return b;
+};
+
+box_t domain_owned_box ( const domain_t *d )
+{
+    box_t b = domain_local_box( d );
+
+    if ( d->neighbours[2*AXIS_Y  ] != NO_NEIGHBOUR ) b.y0 += HALO;
+    if ( d->neighbours[2*AXIS_Y+1] != NO_NEIGHBOUR ) b.yf -= HALO;
+    if ( d->neighbours[2*AXIS_X  ] != NO_NEIGHBOUR ) b.x0 += HALO;
+    if ( d->neighbours[2*AXIS_X+1] != NO_NEIGHBOUR ) b.xf -= HALO;
+    if ( d->neighbours[2*AXIS_Z  ] != NO_NEIGHBOUR ) b.z0 += HALO;
+    if ( d->neighbours[2*AXIS_Z+1] != NO_NEIGHBOUR ) b.zf -= HALO;
+
+    return b;
+};
+
+void domain_face_boxes ( const domain_t *d,
+                         const int       face,
+                         const integer   send_planes,
+                         const integer   recv_planes,
+                         box_t          *send,
+                         box_t          *recv )
+{
+    const int axis = face / 2;
+    const int side = face % 2;
+
+    /* interior cells along the other axes */
+    box_t b = { HALO, d->dimmz - HALO, HALO, d->dimmx - HALO, HALO, d->dimmy - HALO };
+
+    integer *lo = (axis == AXIS_Y) ? &b.y0 : (axis == AXIS_X) ? &b.x0 : &b.z0;
+    integer *hi = (axis == AXIS_Y) ? &b.yf : (axis == AXIS_X) ? &b.xf : &b.zf;
+    const integer dimm = (axis == AXIS_Y) ? d->dimmy : (axis == AXIS_X) ? d->dimmx : d->dimmz;
+
+    /* the planes closest to the face on both sides of it */
+    *lo = (side == 0) ? HALO : dimm - HALO - send_planes;
+    *hi = *lo + send_planes;
+    *send = b;
+
+    *lo = (side == 0) ? HALO - recv_planes : dimm - HALO;
+    *hi = *lo + recv_planes;
+    *recv = b;
+};
+
+int domain_split_box ( const domain_t *d,
+                       const box_t     box,
+                       box_t           slabs[NFACES],
+                       box_t          *interior )
+{
+    int nslabs = 0;
+    box_t core = box;
+
+    /* y slabs span the whole x-z range: phases ONE_L and ONE_R */
+    slabs[nslabs] = core; slabs[nslabs].yf = core.y0 + HALO; nslabs++;
+    slabs[nslabs] = core; slabs[nslabs].y0 = core.yf - HALO; nslabs++;
+    core.y0 += HALO;
+    core.yf -= HALO;
+
+    if ( d->dims[AXIS_X] > 1 )
+    {
+        slabs[nslabs] = core; slabs[nslabs].xf = core.x0 + HALO; nslabs++;
+        slabs[nslabs] = core; slabs[nslabs].x0 = core.xf - HALO; nslabs++;
+        core.x0 += HALO;
+        core.xf -= HALO;
+    }
+
+    if ( d->dims[AXIS_Z] > 1 )
+    {
+        slabs[nslabs] = core; slabs[nslabs].zf = core.z0 + HALO; nslabs++;
+        slabs[nslabs] = core; slabs[nslabs].z0 = core.zf - HALO; nslabs++;
+        core.z0 += HALO;
+        core.zf -= HALO;
+    }
+
+    *interior = core;
+    return nslabs;
+};
+
+integer box_cells ( const box_t b )
+{
+    return (b.zf - b.z0) * (b.xf - b.x0) * (b.yf - b.y0);
+};
+
+integer pack_box ( real* restrict       buffer,
+                   const real* restrict field,
+                   const box_t          b,
+                   const integer        dimmz,
+                   const integer        dimmx )
+{
+    const integer nz = b.zf - b.z0;
+    integer n = 0;
+
+    for (integer y = b.y0; y < b.yf; y++)
+        for (integer x = b.x0; x < b.xf; x++, n += nz)
+            memcpy( &buffer[n], &field[IDX(b.z0, x, y, dimmz, dimmx)], nz * sizeof(real) );
+
+    return n;
+};
+
+integer unpack_box ( real* restrict       field,
+                     const real* restrict buffer,
+                     const box_t          b,
+                     const integer        dimmz,
+                     const integer        dimmx )
+{
+    const integer nz = b.zf - b.z0;
+    integer n = 0;
+
+    for (integer y = b.y0; y < b.yf; y++)
+        for (integer x = b.x0; x < b.xf; x++, n += nz)
+            memcpy( &field[IDX(b.z0, x, y, dimmz, dimmx)], &buffer[n], nz * sizeof(real) );
+
+    return n;
+};
+
+static void transfer_box ( io_file_t      *file,
+                           const integer   volume,
+                           real           *field,
+                           const domain_t *d,
+                           const box_t     b,
+                           const int       write )
+{
+    const size_t  volumeCells = (size_t) d->gdimmz * d->gdimmx * d->gdimmy;
+    const integer nz = b.zf - b.z0;
+    const integer nx = b.xf - b.x0;
+    const integer ny = b.yf - b.y0;
+
+    /* whole z columns (and x rows) are contiguous in both layouts */
+    const int full_z = (nz == d->gdimmz);
+    const int full_x = full_z && (nx == d->gdimmx);
+
+    const integer step_x = (full_z) ? nx : 1;
+    const integer step_y = (full_x) ? ny : 1;
+    const size_t  count  = (size_t) nz * step_x * step_y;
+
+    for (integer y = b.y0; y < b.yf; y += step_y)
+    {
+        for (integer x = b.x0; x < b.xf; x += step_x)
+        {
+            const size_t cell = (( (size_t) (y + d->y0) * d->gdimmx) + (x + d->x0)) * d->gdimmz + (b.z0 + d->z0);
+            real *ptr = &field[IDX(b.z0, x, y, d->dimmz, d->dimmx)];
+
+            const int64_t offset = (int64_t) (volume * volumeCells + cell) * sizeof(real);
+
+            if ( write ) io_write( file, ptr, count * sizeof(real), offset );
+            else         io_read ( file, ptr, count * sizeof(real), offset );
+        }
+    }
+};
+
+void domain_write_box ( io_file_t      *file,
+                        const integer   volume,
+                        const real     *field,
+                        const domain_t *d,
+                        const box_t     b )
+{
+    transfer_box( file, volume, (real*) field, d, b, 1 );
+};
+
+void domain_read_box ( io_file_t      *file,
+                       const integer   volume,
+                       real           *field,
+                       const domain_t *d,
+                       const box_t     b )
+{
+    transfer_box( file, volume, field, d, b, 0 );
+};
+
+#if defined(USE_MPI)
+static void transfer_volumes ( const char     *fname,
+                               real           *fields[],
+                               const integer   nfields,
+                               const domain_t *d,
+                               const box_t     b,
+                               const int       write )
+{
+    MPI_Info info;
+    MPI_Info_create( &info );
+    MPI_Info_set( info, "romio_cb_write", "enable" );
+    MPI_Info_set( info, "romio_cb_read",  "enable" );
+
+    const int aggregators = parse_env("FWI_MPIIO_AGGREGATORS");
+    if ( aggregators > 0 )
+    {
+        char value[16];
+        sprintf( value, "%d", aggregators );
+        MPI_Info_set( info, "cb_nodes", value );
+    }
+
+    MPI_File fh;
+    const int amode = ( write ) ? MPI_MODE_WRONLY | MPI_MODE_CREATE : MPI_MODE_RDONLY;
+
+    if ( MPI_File_open( d->comm, (char*) fname, amode, info, &fh ) != MPI_SUCCESS )
+    {
+        print_error("Cant open file %s through MPI-IO", fname);
+        abort();
+    }
+
+    /* the box of every volume in the file... */
+    const int gsizes[4] = { nfields, d->gdimmy, d->gdimmx, d->gdimmz };
+    const int bsizes[4] = { nfields, b.yf - b.y0, b.xf - b.x0, b.zf - b.z0 };
+    const int gstart[4] = { 0, d->y0 + b.y0, d->x0 + b.x0, d->z0 + b.z0 };
+
+    MPI_Datatype filetype;
+    MPI_Type_create_subarray( 4, gsizes, bsizes, gstart, MPI_ORDER_C, MPI_FLOAT, &filetype );
+    MPI_Type_commit( &filetype );
+
+    /* ...and in every local array, at its absolute address */
+    const int lsizes[3] = { d->dimmy, d->dimmx, d->dimmz };
+    const int lstart[3] = { b.y0, b.x0, b.z0 };
+
+    MPI_Datatype boxtype, memtype;
+    MPI_Type_create_subarray( 3, lsizes, bsizes + 1, lstart, MPI_ORDER_C, MPI_FLOAT, &boxtype );
+
+    int          *blocks = (int*)          __malloc( ALIGN_INT, nfields * sizeof(int) );
+    MPI_Aint     *displs = (MPI_Aint*)     __malloc( ALIGN_INT, nfields * sizeof(MPI_Aint) );
+    MPI_Datatype *types  = (MPI_Datatype*) __malloc( ALIGN_INT, nfields * sizeof(MPI_Datatype) );
+
+    for (integer f = 0; f < nfields; f++)
+    {
+        blocks[f] = 1;
+        types [f] = boxtype;
+        MPI_Get_address( fields[f], &displs[f] );
+    }
+
+    MPI_Type_create_struct( nfields, blocks, displs, types, &memtype );
+    MPI_Type_commit( &memtype );
+
+    if ( write )
+        MPI_File_set_size( fh, (MPI_Offset) nfields * d->gdimmz * d->gdimmx * d->gdimmy * sizeof(real) );
+
+    MPI_File_set_view( fh, 0, MPI_FLOAT, filetype, "native", info );
+
+    const int rc = ( write )
+        ? MPI_File_write_at_all( fh, 0, MPI_BOTTOM, 1, memtype, MPI_STATUS_IGNORE )
+        : MPI_File_read_at_all ( fh, 0, MPI_BOTTOM, 1, memtype, MPI_STATUS_IGNORE );
+
+    if ( rc != MPI_SUCCESS )
+    {
+        print_error("Error %s file %s through MPI-IO", (write) ? "writing" : "reading", fname);
+        abort();
+    }
+
+    MPI_File_close( &fh );
+
+    MPI_Type_free( &memtype  );
+    MPI_Type_free( &boxtype  );
+    MPI_Type_free( &filetype );
+    MPI_Info_free( &info );
+
+    __free( blocks );
+    __free( displs );
+    __free( types  );
+};
+
+void domain_write_volumes ( const char     *fname,
+                            real           *fields[],
+                            const integer   nfields,
+                            const domain_t *d,
+                            const box_t     b )
+{
+    transfer_volumes( fname, fields, nfields, d, b, 1 );
+};
+
+void domain_read_volumes ( const char     *fname,
+                           real           *fields[],
+                           const integer   nfields,
+                           const domain_t *d,
+                           const box_t     b )
+{
+    transfer_volumes( fname, fields, nfields, d, b, 0 );
+};
+#endif
@@ -0,0 +1,255 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#include "fwi/fwi_gradient.h"
+#include "fwi/fwi_codec.h"
+
+void gradient_setup ( gradient_t    *g,
+                      const sched_t *sched,
+                      const integer  dimmz,
+                      const integer  dimmx,
+                      const integer  dimmy,
+                      const char    *outputfolder,
+                      const real     waveletFreq )
+{
+    domain_setup_even( &g->domain, dimmz, dimmx, dimmy );
+
+    g->ncells   = domain_local_cells( &g->domain );
+    g->shots    = 0;
+    g->total    = 0;
+    g->reducing = 0;
+    g->written  = 0;
+
+    const size_t bytes = g->ncells * sizeof(real) * WRITTEN_FIELDS;
+
+    g->gradient = (real*) __malloc( ALIGN_REAL, bytes );
+    g->precond  = (real*) __malloc( ALIGN_REAL, bytes );
+    memset( g->gradient, 0, bytes );
+    memset( g->precond , 0, bytes );
+
+    sprintf( g->fgradient, "%s/Gradient.%2.1f"      , outputfolder, waveletFreq );
+    sprintf( g->fprecond , "%s/Preconditioner.%2.1f", outputfolder, waveletFreq );
+
+#if defined(USE_MPI)
+    g->cross = sched->cross;
+    for (int r = 0; r < 3; r++)
+        g->requests[r] = MPI_REQUEST_NULL;
+#else
+    (void) sched;
+#endif
+};
+
+void gradient_accumulate ( gradient_t     *g,
+                           const domain_t *domain,
+                           real           *gradient,
+                           real           *precond )
+{
+    PUSH_RANGE
+
+    real *shot_gradient = gradient;
+    real *shot_precond  = precond;
+    real *migrated      = NULL;
+
+    /* the shot ran with the y ranges of domain_rebalance */
+    int moved = ( domain->y0 != g->domain.y0 || domain->dimmy != g->domain.dimmy );
+#if defined(USE_MPI)
+    MPI_Allreduce( MPI_IN_PLACE, &moved, 1, MPI_INT, MPI_MAX, domain->comm );
+#endif
+
+    if ( moved )
+    {
+        const integer shot_cells = domain_local_cells( domain );
+
+        migrated = (real*) __malloc( ALIGN_REAL, 2 * WRITTEN_FIELDS * g->ncells * sizeof(real) );
+
+        real **from = (real**) __malloc( ALIGN_REAL, 2 * WRITTEN_FIELDS * sizeof(real*) );
+        real **to   = (real**) __malloc( ALIGN_REAL, 2 * WRITTEN_FIELDS * sizeof(real*) );
+
+        for (integer f = 0; f < WRITTEN_FIELDS; f++)
+        {
+            from[f]                  = gradient + f * shot_cells;
+            from[WRITTEN_FIELDS + f] = precond  + f * shot_cells;
+            to  [f]                  = migrated + f * g->ncells;
+            to  [WRITTEN_FIELDS + f] = migrated + (WRITTEN_FIELDS + f) * g->ncells;
+        }
+
+        domain_migrate( domain, &g->domain, from, to, 2 * WRITTEN_FIELDS );
+
+        shot_gradient = migrated;
+        shot_precond  = migrated + WRITTEN_FIELDS * g->ncells;
+
+        __free( from );
+        __free( to   );
+    }
+
+    real* restrict sum_gradient = g->gradient;
+    real* restrict sum_precond  = g->precond;
+    const integer  n            = WRITTEN_FIELDS * g->ncells;
+
+#if defined(_OPENMP)
+    #pragma omp parallel for
+#endif
+#if defined(__INTEL_COMPILER)
+    #pragma simd
+#endif
+    for (integer i = 0; i < n; i++)
+    {
+        sum_gradient[i] += shot_gradient[i];
+        sum_precond [i] += shot_precond [i];
+    }
+
+    if ( migrated != NULL ) __free( migrated );
+
+    g->shots++;
+
+    POP_RANGE
+};
+
+void gradient_reduce ( gradient_t *g )
+{
+    PUSH_RANGE
+
+    g->reducing = 1;
+
+#if defined(USE_MPI)
+    const int n = WRITTEN_FIELDS * g->ncells;
+    int rank;
+    MPI_Comm_rank( g->cross, &rank );
+
+    /* the first group gets the sums in place */
+    if ( rank == 0 )
+    {
+        MPI_Ireduce( MPI_IN_PLACE, g->gradient, n, MPI_FLOAT, MPI_SUM, 0, g->cross, &g->requests[0] );
+        MPI_Ireduce( MPI_IN_PLACE, g->precond , n, MPI_FLOAT, MPI_SUM, 0, g->cross, &g->requests[1] );
+    }
+    else
+    {
+        MPI_Ireduce( g->gradient, NULL, n, MPI_FLOAT, MPI_SUM, 0, g->cross, &g->requests[0] );
+        MPI_Ireduce( g->precond , NULL, n, MPI_FLOAT, MPI_SUM, 0, g->cross, &g->requests[1] );
+    }
+
+    MPI_Ireduce( &g->shots, &g->total, 1, MPI_INT, MPI_SUM, 0, g->cross, &g->requests[2] );
+#else
+    g->total = g->shots;
+#endif
+
+    POP_RANGE
+};
+
+/* the first group writes the reduced volumes */
+static void write_reduced ( gradient_t *g )
+{
+    g->written = 1;
+
+#if defined(USE_MPI)
+    int rank;
+    MPI_Comm_rank( g->cross, &rank );
+    if ( rank != 0 ) return;
+#endif
+
+    print_stats("Gradient and preconditioner of %d shots reduced", g->total );
+
+    gradient_write_volumes( g->fgradient, g->gradient, &g->domain );
+    gradient_write_volumes( g->fprecond , g->precond , &g->domain );
+};
+
+void gradient_progress ( gradient_t *g )
+{
+    if ( !g->reducing || g->written ) return;
+
+#if defined(USE_MPI)
+    int done;
+    MPI_Testall( 3, g->requests, &done, MPI_STATUSES_IGNORE );
+    if ( !done ) return;
+#endif
+
+    write_reduced( g );
+};
+
+void gradient_finish ( gradient_t *g )
+{
+    PUSH_RANGE
+
+    if ( !g->reducing ) gradient_reduce( g );
+
+#if defined(USE_MPI)
+    const double start_t = dtime();
+    MPI_Waitall( 3, g->requests, MPI_STATUSES_IGNORE );
+    print_stats("Gradient reduction exposed %lf seconds", dtime() - start_t );
+#endif
+
+    if ( !g->written ) write_reduced( g );
+
+    __free( g->gradient );
+    __free( g->precond  );
+    domain_release( &g->domain );
+
+    POP_RANGE
+};
+
+void gradient_write_volumes ( const char     *fname,
+                              real           *volumes,
+                              const domain_t *domain )
+{
+#if defined(DO_NOT_PERFORM_IO)
+    print_info("Warning: we are not writing %s because IO is not enabled for this execution", fname);
+
+    (void) volumes;
+    (void) domain;
+#else
+    const box_t   owned = domain_owned_box  ( domain );
+    const integer cells = domain_local_cells( domain );
+    const size_t  bytes = (size_t) domain->gdimmz * domain->gdimmx * domain->gdimmy
+                        * sizeof(real) * WRITTEN_FIELDS;
+
+    print_info("Storing %s", fname);
+
+    /* the exact values, compressed, for large runs */
+    if ( parse_env("FWI_GRADIENT_LOSSLESS") > 0 )
+    {
+        const codec_t codec = { CODEC_LOSSLESS, 0, 0 };
+
+        real *fields[WRITTEN_FIELDS];
+        for (integer f = 0; f < WRITTEN_FIELDS; f++)
+            fields[f] = volumes + f * cells;
+
+        codec_write_volumes( &codec, fname, fields, WRITTEN_FIELDS, domain );
+        return;
+    }
+
+    io_file_t file;
+    io_open( &file, fname, 1, bytes );
+
+    for (integer f = 0; f < WRITTEN_FIELDS; f++)
+        domain_write_box( &file, f, volumes + f * cells, domain, owned );
+
+    io_close( &file );
+#endif
+};
@@ -0,0 +1,486 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+#include "fwi/fwi_halo.h"
+
+static int halo_transport ( void )
+{
+    const int transport = parse_env("FWI_HALO_TRANSPORT");
+
+    if ( transport < HALO_TWO_SIDED || transport > HALO_ONE_SIDED )
+    {
+        print_info("FWI_HALO_TRANSPORT=%d is not valid, using two-sided messages", transport);
+        return HALO_TWO_SIDED;
+    }
+    return transport;
+};
+
+const char* halo_transport_name ( const int transport )
+{
+    switch ( transport )
+    {
+        case HALO_SHARED:    return "shared memory";
+        case HALO_ONE_SIDED: return "one-sided";
+        default:             return "two-sided";
+    }
+};
+
+#if defined(USE_MPI)
+/*
+ * Rank, inside the node communicator, of the neighbour behind every face
+ * (MPI_UNDEFINED when it lives on another node or there is none).
+ */
+static void halo_node_ranks ( halo_t *halo, int node_ranks[NFACES] )
+{
+    const domain_t *d = halo->domain;
+
+    MPI_Comm_split_type( d->comm, MPI_COMM_TYPE_SHARED, d->rank, MPI_INFO_NULL, &halo->node );
+
+    MPI_Group domain_group, node_group;
+    MPI_Comm_group( d->comm,     &domain_group );
+    MPI_Comm_group( halo->node,  &node_group   );
+
+    int neighbours[NFACES];
+    for (int face = 0; face < NFACES; face++)
+        neighbours[face] = d->neighbours[face];
+
+    MPI_Group_translate_ranks( domain_group, NFACES, neighbours, node_group, node_ranks );
+
+    for (int face = 0; face < NFACES; face++)
+        if ( d->neighbours[face] == NO_NEIGHBOUR ) node_ranks[face] = MPI_UNDEFINED;
+
+    MPI_Group_free( &domain_group );
+    MPI_Group_free( &node_group   );
+};
+
+/*
+ * Every neighbour learns where, in the memory of this process, the data it
+ * sends through the given faces goes (as an offset in the local segment).
+ */
+static void halo_exchange_offsets ( const halo_t   *halo,
+                                    const int      *faces,
+                                    const int       nfaces,
+                                    const MPI_Aint  offset[NFACES],
+                                    MPI_Aint        remote[NFACES] )
+{
+    const domain_t *d = halo->domain;
+    MPI_Request     requests[2*NFACES];
+
+    for (int i = 0; i < nfaces; i++)
+    {
+        const int face = faces[i];
+
+        MPI_Irecv( &remote[face], 1, MPI_AINT, d->neighbours[face], 200 + (face ^ 1),
+                   d->comm, &requests[2*i] );
+        MPI_Isend( &offset[face], 1, MPI_AINT, d->neighbours[face], 200 + face,
+                   d->comm, &requests[2*i+1] );
+    }
+    MPI_Waitall( 2 * nfaces, requests, MPI_STATUSES_IGNORE );
+};
+
+/*
+ * Allocates the local segment of the shared window, with two buffers per
+ * on-node face, and finds where in the neighbours' segments the faces
+ * coming to this process are packed.
+ */
+static void halo_shared_setup ( halo_t *halo, const int node_ranks[NFACES] )
+{
+    MPI_Aint offset[NFACES], remote[NFACES], bytes = 0;
+
+    for (int i = 0; i < halo->nshared; i++)
+    {
+        const int face = halo->shared[i];
+
+        offset[face] = bytes;
+        bytes       += 2 * halo->sendcount[face] * sizeof(real);
+    }
+
+    char *base;
+    MPI_Win_allocate_shared( bytes, 1, MPI_INFO_NULL, halo->node, &base, &halo->win );
+
+    halo_exchange_offsets( halo, halo->shared, halo->nshared, offset, remote );
+
+    for (int i = 0; i < halo->nshared; i++)
+    {
+        const int face = halo->shared[i];
+
+        MPI_Aint size;
+        int      disp_unit;
+        char    *segment;
+        MPI_Win_shared_query( halo->win, node_ranks[face], &size, &disp_unit, &segment );
+
+        halo->shared_send[face] = (real*) (base    + offset[face]);
+        halo->shared_recv[face] = (real*) (segment + remote[face]);
+    }
+
+    /* opens the first epoch */
+    MPI_Win_fence( 0, halo->win );
+};
+
+/*
+ * Exposes the receive buffers of every face in a single window and builds
+ * the group of neighbours the epochs are opened with.
+ */
+static void halo_one_sided_setup ( halo_t *halo )
+{
+    const domain_t *d = halo->domain;
+
+    MPI_Aint offset[NFACES], elements = 0;
+
+    for (int i = 0; i < halo->nfaces; i++)
+    {
+        const int face = halo->faces[i];
+
+        offset[face] = elements;
+        elements    += halo->recvcount[face];
+    }
+
+    real *base;
+    MPI_Win_allocate( elements * sizeof(real), sizeof(real), MPI_INFO_NULL, d->comm, &base, &halo->win );
+
+    for (int i = 0; i < halo->nfaces; i++)
+    {
+        const int face = halo->faces[i];
+        halo->recvbuf[face] = base + offset[face];
+    }
+
+    /* puts through a face land in the buffer of the opposite one */
+    halo_exchange_offsets( halo, halo->faces, halo->nfaces, offset, halo->remote );
+
+    int ranks[NFACES];
+    for (int i = 0; i < halo->nfaces; i++)
+        ranks[i] = d->neighbours[ halo->faces[i] ];
+
+    MPI_Group domain_group;
+    MPI_Comm_group ( d->comm, &domain_group );
+    MPI_Group_incl ( domain_group, halo->nfaces, ranks, &halo->group );
+    MPI_Group_free ( &domain_group );
+};
+#endif
+
+void halo_depths ( const stencil_read_t  reads[],
+                   const integer         nreads,
+                   real                 *fields[],
+                   const integer         nfields,
+                   integer               depth[][NFACES] )
+{
+    for (integer f = 0; f < nfields; f++)
+        for (int face = 0; face < NFACES; face++)
+            depth[f][face] = 0;
+
+    /* stencil_Z/X/Y read from p-HALO+off to p+HALO-1+off along their axis */
+    for (integer r = 0; r < nreads; r++)
+        for (integer f = 0; f < nfields; f++)
+        {
+            if ( reads[r].field != fields[f] ) continue;
+
+            const int     face = 2 * reads[r].axis;
+            const integer off  = (reads[r].offset == forw_offset) ? 1 : 0;
+
+            if ( depth[f][face  ] < HALO     - off ) depth[f][face  ] = HALO     - off;
+            if ( depth[f][face+1] < HALO - 1 + off ) depth[f][face+1] = HALO - 1 + off;
+        }
+};
+
+void halo_setup ( halo_t         *halo,
+                  const domain_t *domain,
+                  real           *fields[],
+                  const integer (*depth)[NFACES],
+                  const integer   nfields )
+{
+    halo->domain    = domain;
+    halo->nfields   = nfields;
+    halo->transport = halo_transport();
+    halo->nfaces    = 0;
+    halo->nshared   = 0;
+    halo->parity    = 0;
+    halo->fields    = (real**) __malloc( ALIGN_REAL, nfields * sizeof(real*) );
+
+    for (integer f = 0; f < nfields; f++)
+        halo->fields[f] = fields[f];
+
+#if defined(USE_MPI)
+    int node_ranks[NFACES];
+
+    if ( halo->transport == HALO_SHARED )
+        halo_node_ranks( halo, node_ranks );
+#endif
+
+    for (int face = 0; face < NFACES; face++)
+    {
+        halo->send     [face] = (box_t*) __malloc( ALIGN_INTEGER, nfields * sizeof(box_t) );
+        halo->recv     [face] = (box_t*) __malloc( ALIGN_INTEGER, nfields * sizeof(box_t) );
+        halo->sendcount[face] = 0;
+        halo->recvcount[face] = 0;
+        halo->sendbuf  [face] = NULL;
+        halo->recvbuf  [face] = NULL;
+
+        /* the neighbour reads through the opposite face what we send */
+        for (integer f = 0; f < nfields; f++)
+        {
+            const integer send_planes = ( depth != NULL ) ? depth[f][face ^ 1] : HALO;
+            const integer recv_planes = ( depth != NULL ) ? depth[f][face    ] : HALO;
+
+            domain_face_boxes( domain, face, send_planes, recv_planes,
+                               &halo->send[face][f], &halo->recv[face][f] );
+        }
+
+        if ( domain->neighbours[face] == NO_NEIGHBOUR ) continue;
+
+        for (integer f = 0; f < nfields; f++)
+        {
+            halo->sendcount[face] += box_cells( halo->send[face][f] );
+            halo->recvcount[face] += box_cells( halo->recv[face][f] );
+        }
+
+#if defined(USE_MPI)
+        if ( halo->transport == HALO_SHARED && node_ranks[face] != MPI_UNDEFINED )
+        {
+            halo->shared[halo->nshared++] = face;
+
+            print_debug("Halo face %d: " I " fields, " I " elements through shared memory with rank %d",
+                        face, nfields, halo->sendcount[face], domain->neighbours[face]);
+            continue;
+        }
+#endif
+
+        halo->sendbuf[face] = (real*) __malloc( ALIGN_REAL, halo->sendcount[face] * sizeof(real) );
+
+#if defined(USE_MPI)
+        if ( halo->transport == HALO_ONE_SIDED )
+        {
+            /* the receive buffer lives in the window */
+            halo->faces[halo->nfaces++] = face;
+
+            print_debug("Halo face %d: " I " fields, " I " elements put into rank %d",
+                        face, nfields, halo->sendcount[face], domain->neighbours[face]);
+            continue;
+        }
+#endif
+
+        halo->recvbuf[face] = (real*) __malloc( ALIGN_REAL, halo->recvcount[face] * sizeof(real) );
+
+#if defined(USE_MPI)
+        /* a message sent through a face is tagged with it, and arrives
+         * through the opposite face of the neighbour */
+        const int i = halo->nfaces;
+
+        MPI_Recv_init( halo->recvbuf[face], halo->recvcount[face], MPI_FLOAT,
+                       domain->neighbours[face], 100 + (face ^ 1), domain->comm, &halo->recvreq[i] );
+        MPI_Send_init( halo->sendbuf[face], halo->sendcount[face], MPI_FLOAT,
+                       domain->neighbours[face], 100 + face, domain->comm, &halo->sendreq[i] );
+#endif
+        halo->faces[halo->nfaces++] = face;
+
+        print_debug("Halo face %d: " I " fields, " I " elements per message to rank %d",
+                    face, nfields, halo->sendcount[face], domain->neighbours[face]);
+    }
+
+#if defined(USE_MPI)
+    if ( halo->transport == HALO_SHARED )
+        halo_shared_setup( halo, node_ranks );
+    else if ( halo->transport == HALO_ONE_SIDED )
+        halo_one_sided_setup( halo );
+#endif
+};
+
+void halo_release ( halo_t *halo )
+{
+#if defined(USE_MPI)
+    if ( halo->transport == HALO_ONE_SIDED )
+    {
+        /* the receive buffers go with the window */
+        for (int face = 0; face < NFACES; face++)
+            halo->recvbuf[face] = NULL;
+
+        MPI_Win_free  ( &halo->win   );
+        MPI_Group_free( &halo->group );
+    }
+    else
+    {
+        for (int i = 0; i < halo->nfaces; i++)
+        {
+            MPI_Request_free( &halo->sendreq[i] );
+            MPI_Request_free( &halo->recvreq[i] );
+        }
+    }
+
+    if ( halo->transport == HALO_SHARED )
+    {
+        MPI_Win_free ( &halo->win  );
+        MPI_Comm_free( &halo->node );
+    }
+#endif
+
+    for (int face = 0; face < NFACES; face++)
+    {
+        if ( halo->sendbuf[face] != NULL ) __free( halo->sendbuf[face] );
+        if ( halo->recvbuf[face] != NULL ) __free( halo->recvbuf[face] );
+
+        __free( halo->send[face] );
+        __free( halo->recv[face] );
+    }
+
+    __free( halo->fields );
+};
+
+void halo_start ( halo_t *halo )
+{
+#if defined(USE_MPI)
+    PUSH_RANGE
+
+    const domain_t *d = halo->domain;
+
+    if ( halo->transport == HALO_ONE_SIDED )
+    {
+        /* the previous faces were unpacked: the neighbours may put again */
+        MPI_Win_post ( halo->group, 0, halo->win );
+        MPI_Win_start( halo->group, 0, halo->win );
+
+        for (int i = 0; i < halo->nfaces; i++)
+        {
+            const int face   = halo->faces[i];
+            real     *buffer = halo->sendbuf[face];
+
+            for (integer f = 0; f < halo->nfields; f++)
+                buffer += pack_box( buffer, halo->fields[f], halo->send[face][f], d->dimmz, d->dimmx );
+
+            MPI_Put( halo->sendbuf[face], halo->sendcount[face], MPI_FLOAT, d->neighbours[face],
+                     halo->remote[face], halo->sendcount[face], MPI_FLOAT, halo->win );
+        }
+
+        POP_RANGE
+        return;
+    }
+
+    if ( halo->nfaces > 0 )
+        MPI_Startall( halo->nfaces, halo->recvreq );
+
+    /* the next face is packed while the previous ones are in flight */
+    for (int i = 0; i < halo->nfaces; i++)
+    {
+        const int face   = halo->faces[i];
+        real     *buffer = halo->sendbuf[face];
+
+        for (integer f = 0; f < halo->nfields; f++)
+            buffer += pack_box( buffer, halo->fields[f], halo->send[face][f], d->dimmz, d->dimmx );
+
+        MPI_Start( &halo->sendreq[i] );
+    }
+
+    /* nobody reads this buffer until the fence of the next exchange */
+    for (int i = 0; i < halo->nshared; i++)
+    {
+        const int face   = halo->shared[i];
+        real     *buffer = halo->shared_send[face] + halo->parity * halo->sendcount[face];
+
+        for (integer f = 0; f < halo->nfields; f++)
+            buffer += pack_box( buffer, halo->fields[f], halo->send[face][f], d->dimmz, d->dimmx );
+    }
+
+    POP_RANGE
+#else
+    (void) halo;
+#endif
+};
+
+void halo_wait ( halo_t *halo )
+{
+#if defined(USE_MPI)
+    PUSH_RANGE
+
+    const domain_t *d = halo->domain;
+
+    /*
+     * Once every process of the node has packed its faces they can be read.
+     * The other buffer is packed in the next exchange while the neighbours
+     * may still be reading this one; it is rewritten after one more fence,
+     * which nobody passes before finishing its reads.
+     */
+    if ( halo->transport == HALO_SHARED )
+    {
+        MPI_Win_fence( 0, halo->win );
+
+        for (int i = 0; i < halo->nshared; i++)
+        {
+            const int   face   = halo->shared[i];
+            const real *buffer = halo->shared_recv[face] + halo->parity * halo->recvcount[face];
+
+            for (integer f = 0; f < halo->nfields; f++)
+                buffer += unpack_box( halo->fields[f], buffer, halo->recv[face][f], d->dimmz, d->dimmx );
+        }
+
+        halo->parity ^= 1;
+    }
+
+    if ( halo->transport == HALO_ONE_SIDED )
+    {
+        /* our puts are done, and so are the ones targeting us */
+        MPI_Win_complete( halo->win );
+        MPI_Win_wait    ( halo->win );
+
+        for (int i = 0; i < halo->nfaces; i++)
+        {
+            const int   face   = halo->faces[i];
+            const real *buffer = halo->recvbuf[face];
+
+            for (integer f = 0; f < halo->nfields; f++)
+                buffer += unpack_box( halo->fields[f], buffer, halo->recv[face][f], d->dimmz, d->dimmx );
+        }
+
+        POP_RANGE
+        return;
+    }
+
+    /* completed persistent requests become inactive and are skipped */
+    for (int n = 0; n < halo->nfaces; n++)
+    {
+        int i;
+        MPI_Waitany( halo->nfaces, halo->recvreq, &i, MPI_STATUS_IGNORE );
+
+        const int   face   = halo->faces[i];
+        const real *buffer = halo->recvbuf[face];
+
+        for (integer f = 0; f < halo->nfields; f++)
+            buffer += unpack_box( halo->fields[f], buffer, halo->recv[face][f], d->dimmz, d->dimmx );
+    }
+
+    MPI_Waitall( halo->nfaces, halo->sendreq, MPI_STATUSES_IGNORE );
+
+    POP_RANGE
+#else
+    (void) halo;
+#endif
+};
+
+void halo_exchange ( halo_t *halo )
+{
+    halo_start( halo );
+    halo_wait ( halo );
+};
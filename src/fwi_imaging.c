@@ -0,0 +1,99 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#include "fwi/fwi_imaging.h"
+
+/* cells of every field correlated at once */
+#define IMAGING_BLOCK 2048
+
+void imaging_setup ( imaging_t     *im,
+                     const int      nfields,
+                     const integer  ncells,
+                     const real     dt,
+                     real          *gradient,
+                     real          *precond,
+                     real          *forward[] )
+{
+    im->nfields  = nfields;
+    im->ncells   = ncells;
+    im->dt       = dt;
+    im->gradient = gradient;
+    im->precond  = precond;
+    im->buffer   = NULL;
+    im->forward  = (real**) __malloc( ALIGN_REAL, nfields * sizeof(real*) );
+
+    if ( forward == NULL )
+        im->buffer = (real*) __malloc( ALIGN_REAL, (size_t) nfields * ncells * sizeof(real) );
+
+    for (int f = 0; f < nfields; f++)
+        im->forward[f] = ( forward != NULL ) ? forward[f] : im->buffer + (size_t) f * ncells;
+};
+
+void imaging_release ( imaging_t *im )
+{
+    if ( im->buffer != NULL ) __free( im->buffer );
+    __free( im->forward );
+};
+
+void imaging_accumulate ( imaging_t *im,
+                          real      *backward[] )
+{
+    PUSH_RANGE
+
+    const integer ncells = im->ncells;
+    const real    dt     = im->dt;
+
+#if defined(_OPENMP)
+    #pragma omp parallel for
+#endif
+    for (integer i0 = 0; i0 < ncells; i0 += IMAGING_BLOCK)
+    {
+        const integer i1 = ( i0 + IMAGING_BLOCK < ncells ) ? i0 + IMAGING_BLOCK : ncells;
+
+        for (int f = 0; f < im->nfields; f++)
+        {
+            const real* restrict fw = im->forward[f];
+            const real* restrict bw = backward[f];
+            real* restrict gradient = im->gradient + (size_t) f * ncells;
+            real* restrict precond  = im->precond  + (size_t) f * ncells;
+
+#if defined(__INTEL_COMPILER)
+            #pragma simd
+#endif
+            for (integer i = i0; i < i1; i++)
+            {
+                gradient[i] += fw[i] * bw[i] * dt;
+                precond [i] += fw[i] * fw[i] * dt;
+            }
+        }
+    }
+
+    POP_RANGE
+};
@@ -0,0 +1,336 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+/* O_DIRECT */
+#define _GNU_SOURCE
+
+#include "fwi/fwi_io.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+
+static const char *names[IO_BACKENDS] = { "stdio", "pread/pwrite", "O_DIRECT", "null" };
+
+/* every thread of the process adds its transfers here */
+static io_stats_t      totals[IO_BACKENDS];
+static pthread_mutex_t totals_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void account ( const int    backend,
+                      const int    write,
+                      const size_t bytes,
+                      const long   requests,
+                      const double seconds )
+{
+    pthread_mutex_lock( &totals_lock );
+
+    io_stats_t *s = &totals[backend];
+
+    if ( write ) { s->written += bytes; s->writes += requests; s->twrite += seconds; }
+    else         { s->read    += bytes; s->reads  += requests; s->tread  += seconds; }
+
+    pthread_mutex_unlock( &totals_lock );
+};
+
+io_backend_t io_backend ( void )
+{
+#if defined(DO_NOT_PERFORM_IO)
+    return IO_NULL;
+#else
+    static int warned = 0;
+
+    const int backend = parse_env("FWI_IO_BACKEND");
+
+    if ( backend < 0 || backend >= IO_BACKENDS )
+    {
+        if ( !warned ) print_info("FWI_IO_BACKEND=%d ignored, files go through stdio", backend);
+        warned = 1;
+        return IO_STDIO;
+    }
+    return (io_backend_t) backend;
+#endif
+};
+
+const char* io_backend_name ( const int backend )
+{
+    return names[backend];
+};
+
+/* the whole transfer, whatever the system calls take at once */
+static void transfer_fd ( io_file_t *f,
+                          const int  fd,
+                          char      *ptr,
+                          size_t     bytes,
+                          int64_t    offset )
+{
+    while ( bytes > 0 )
+    {
+        const ssize_t n = ( f->write ) ? pwrite( fd, ptr, bytes, (off_t) offset )
+                                       : pread ( fd, ptr, bytes, (off_t) offset );
+
+        if ( n < 0 && errno == EINTR ) continue;
+
+        if ( n <= 0 )
+        {
+            print_error("Error %s %lu bytes at %ld of %s: %s", (f->write) ? "writing" : "reading",
+                        (unsigned long) bytes, (long) offset, f->fname, (n < 0) ? strerror(errno) : "end of file");
+            abort();
+        }
+
+        ptr    += n;
+        bytes  -= n;
+        offset += n;
+    }
+};
+
+/* the aligned blocks through the staging buffer, the ends around them as they are */
+static void transfer_direct ( io_file_t    *f,
+                              char         *ptr,
+                              const size_t  bytes,
+                              const int64_t offset )
+{
+    const int64_t end = offset + bytes;
+    const int64_t a0  = (offset + IO_DIRECT_ALIGN - 1) / IO_DIRECT_ALIGN * IO_DIRECT_ALIGN;
+    const int64_t a1  = end / IO_DIRECT_ALIGN * IO_DIRECT_ALIGN;
+
+    if ( f->direct < 0 || a1 <= a0 )
+    {
+        transfer_fd( f, f->fd, ptr, bytes, offset );
+        return;
+    }
+
+    transfer_fd( f, f->fd, ptr, a0 - offset, offset );
+
+    for (int64_t at = a0; at < a1; at += IO_DIRECT_BUFFER)
+    {
+        const size_t n = ( a1 - at < IO_DIRECT_BUFFER ) ? (size_t) (a1 - at) : IO_DIRECT_BUFFER;
+
+        if ( f->write ) memcpy( f->buffer, ptr + (at - offset), n );
+        transfer_fd( f, f->direct, f->buffer, n, at );
+        if ( !f->write ) memcpy( ptr + (at - offset), f->buffer, n );
+    }
+
+    transfer_fd( f, f->fd, ptr + (a1 - offset), end - a1, a1 );
+};
+
+static int open_fd ( const char *fname, const int write, const size_t size, const int flags )
+{
+    const int fd = ( write ) ? open( fname, O_WRONLY | O_CREAT | flags, 0644 )
+                             : open( fname, O_RDONLY | flags );
+
+    if ( fd >= 0 && write && ftruncate( fd, size ) != 0 )
+    {
+        close( fd );
+        return -1;
+    }
+    return fd;
+};
+
+void io_open ( io_file_t    *f,
+               const char   *fname,
+               const int     write,
+               const size_t  size )
+{
+    io_open_backend( f, io_backend(), fname, write, size );
+};
+
+void io_open_backend ( io_file_t   *f,
+                       const int    backend,
+                       const char  *fname,
+                       const int    write,
+                       const size_t size )
+{
+    f->backend = backend;
+    f->write   = write;
+    f->stream  = NULL;
+    f->fd      = -1;
+    f->direct  = -1;
+    f->buffer  = NULL;
+    snprintf( f->fname, sizeof(f->fname), "%s", fname );
+
+    if ( backend == IO_NULL ) return;
+
+    /* never truncated, just resized, so it does not matter which process gets first */
+    f->fd = open_fd( fname, write, size, 0 );
+
+    if ( f->fd < 0 )
+    {
+        print_error("Cant open %s for %s through %s: %s", fname, (write) ? "writing" : "reading",
+                    names[backend], strerror(errno));
+        exit(-1);
+    }
+
+    switch ( backend )
+    {
+    case( IO_STDIO ):
+    {
+        f->stream = fdopen( f->fd, (write) ? "w" : "r" );
+
+        if ( f->stream == NULL )
+        {
+            print_error("Cant open a stream on %s", fname);
+            exit(-1);
+        }
+        break;
+    }
+    case( IO_DIRECT ):
+    {
+        static int warned = 0;
+
+        /* some file systems (tmpfs...) do not take it */
+        f->direct = open_fd( fname, write, size, O_DIRECT );
+
+        if ( f->direct < 0 )
+        {
+            if ( !warned ) print_info("O_DIRECT is not supported for %s (%s), it goes through pread/pwrite", fname, strerror(errno));
+            warned = 1;
+        }
+        else
+            f->buffer = (char*) __malloc( IO_DIRECT_ALIGN, IO_DIRECT_BUFFER );
+        break;
+    }
+    default:
+        break;
+    }
+};
+
+void io_close ( io_file_t *f )
+{
+    const double start = dtime();
+    int rc = 0;
+
+    if ( f->stream != NULL ) rc = fclose( f->stream );
+    else if ( f->fd >= 0 )   rc = close( f->fd );
+
+    if ( f->direct >= 0 ) rc |= close( f->direct );
+    if ( f->buffer != NULL ) __free( f->buffer );
+
+    if ( rc != 0 )
+    {
+        print_error("Cant close %s: %s", f->fname, strerror(errno));
+        abort();
+    }
+
+    /* what stdio still had to write */
+    if ( f->write ) account( f->backend, 1, 0, 0, dtime() - start );
+};
+
+void io_write ( io_file_t     *f,
+                const void    *ptr,
+                const size_t   bytes,
+                const int64_t  offset )
+{
+    const double start = dtime();
+
+    switch ( f->backend )
+    {
+    case( IO_STDIO ):
+    {
+        if ( fseeko( f->stream, (off_t) offset, SEEK_SET ) != 0 || fwrite( ptr, 1, bytes, f->stream ) != bytes )
+        {
+            print_error("Error writing %lu bytes at %ld of %s", (unsigned long) bytes, (long) offset, f->fname);
+            abort();
+        }
+        break;
+    }
+    case( IO_POSIX ):
+        transfer_fd( f, f->fd, (char*) ptr, bytes, offset );
+        break;
+    case( IO_DIRECT ):
+        transfer_direct( f, (char*) ptr, bytes, offset );
+        break;
+    default:
+        break;
+    }
+
+    account( f->backend, 1, bytes, 1, dtime() - start );
+};
+
+void io_read ( io_file_t    *f,
+               void         *ptr,
+               const size_t  bytes,
+               const int64_t offset )
+{
+    const double start = dtime();
+
+    switch ( f->backend )
+    {
+    case( IO_STDIO ):
+    {
+        if ( fseeko( f->stream, (off_t) offset, SEEK_SET ) != 0 || fread( ptr, 1, bytes, f->stream ) != bytes )
+        {
+            print_error("Error reading %lu bytes at %ld of %s", (unsigned long) bytes, (long) offset, f->fname);
+            abort();
+        }
+        break;
+    }
+    case( IO_POSIX ):
+        transfer_fd( f, f->fd, (char*) ptr, bytes, offset );
+        break;
+    case( IO_DIRECT ):
+        transfer_direct( f, (char*) ptr, bytes, offset );
+        break;
+    default:
+        memset( ptr, 0, bytes );
+    }
+
+    account( f->backend, 0, bytes, 1, dtime() - start );
+};
+
+void io_sequential ( io_file_t *f )
+{
+    if ( f->fd >= 0 ) posix_fadvise( f->fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+};
+
+void io_stats ( const int backend, io_stats_t *stats )
+{
+    pthread_mutex_lock( &totals_lock );
+    *stats = totals[backend];
+    pthread_mutex_unlock( &totals_lock );
+};
+
+static double mbps ( const double bytes, const double seconds )
+{
+    return ( seconds > 0.0 ) ? bytes / (1000.0 * 1000.0) / seconds : 0.0;
+};
+
+void io_stats_report ( void )
+{
+    for (int b = 0; b < IO_BACKENDS; b++)
+    {
+        io_stats_t s;
+        io_stats( b, &s );
+
+        if ( s.writes == 0 && s.reads == 0 ) continue;
+
+        print_stats("I/O through %s: %lf GB written in %ld requests and %lf seconds (%lf MB/s), %lf GB read in %ld requests and %lf seconds (%lf MB/s)",
+                    names[b], TOGB( (size_t) s.written ), s.writes, s.twrite, mbps( s.written, s.twrite ),
+                              TOGB( (size_t) s.read    ), s.reads,  s.tread,  mbps( s.read,    s.tread  ));
+    }
+};
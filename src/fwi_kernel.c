@@ -28,6 +28,11 @@
  */
 
 #include "fwi/fwi_kernel.h"
+#include "fwi/fwi_numa.h"
+#include "fwi/fwi_halo.h"
+#include "fwi/fwi_revolve.h"
+#include "fwi/fwi_codec.h"
+#include "fwi/fwi_decimate.h"
 
 /*
  * Initializes an array of length "length" to a random number.
@@ -109,6 +114,39 @@ void check_memory_shot( const integer numberOfCells,
 #endif /* end of pragma DEBUG */
 };
 
+void velocity_field_list ( v_t *v, real* fields[VELOCITY_FIELDS] )
+{
+    fields[ 0] = v->tl.u; fields[ 1] = v->tl.v; fields[ 2] = v->tl.w;
+    fields[ 3] = v->tr.u; fields[ 4] = v->tr.v; fields[ 5] = v->tr.w;
+    fields[ 6] = v->bl.u; fields[ 7] = v->bl.v; fields[ 8] = v->bl.w;
+    fields[ 9] = v->br.u; fields[10] = v->br.v; fields[11] = v->br.w;
+};
+
+void stress_field_list ( s_t *s, real* fields[STRESS_FIELDS] )
+{
+    fields[ 0] = s->tl.zz; fields[ 1] = s->tl.xz; fields[ 2] = s->tl.yz;
+    fields[ 3] = s->tl.xx; fields[ 4] = s->tl.xy; fields[ 5] = s->tl.yy;
+    fields[ 6] = s->tr.zz; fields[ 7] = s->tr.xz; fields[ 8] = s->tr.yz;
+    fields[ 9] = s->tr.xx; fields[10] = s->tr.xy; fields[11] = s->tr.yy;
+    fields[12] = s->bl.zz; fields[13] = s->bl.xz; fields[14] = s->bl.yz;
+    fields[15] = s->bl.xx; fields[16] = s->bl.xy; fields[17] = s->bl.yy;
+    fields[18] = s->br.zz; fields[19] = s->br.xz; fields[20] = s->br.yz;
+    fields[21] = s->br.xx; fields[22] = s->br.xy; fields[23] = s->br.yy;
+};
+
+void coeff_field_list ( coeff_t *c, real* fields[COEFF_FIELDS] )
+{
+    fields[ 0] = c->c11; fields[ 1] = c->c12; fields[ 2] = c->c13;
+    fields[ 3] = c->c14; fields[ 4] = c->c15; fields[ 5] = c->c16;
+    fields[ 6] = c->c22; fields[ 7] = c->c23; fields[ 8] = c->c24;
+    fields[ 9] = c->c25; fields[10] = c->c26;
+    fields[11] = c->c33; fields[12] = c->c34; fields[13] = c->c35;
+    fields[14] = c->c36;
+    fields[15] = c->c44; fields[16] = c->c45; fields[17] = c->c46;
+    fields[18] = c->c55; fields[19] = c->c56;
+    fields[20] = c->c66;
+};
+
 
 void alloc_memory_shot( const integer numberOfCells,
                         coeff_t *c,
@@ -290,20 +328,17 @@ void free_memory_shot( coeff_t *c,
 };
 
 /*
- * Loads initial values from coeffs, stress and velocity.
+ * Initial stress and velocity, also the state the backward propagation
+ * starts from.
  */
-void load_initial_model ( const real    waveletFreq,
-                          const integer dimmz,
-                          const integer dimmx,
-                          const integer dimmy,
-                          coeff_t *c,
-                          s_t     *s,
-                          v_t     *v,
-                          real    *rho)
+void load_initial_wavefield ( const real      waveletFreq,
+                              const domain_t *domain,
+                              s_t            *s,
+                              v_t            *v)
 {
     PUSH_RANGE
 
-    const int numberOfCells = dimmz * dimmx * dimmy;
+    const int numberOfCells = domain_local_cells( domain );
 
     /* initialize stress */
     set_array_to_constant( s->tl.zz, 0, numberOfCells);
@@ -331,6 +366,90 @@ void load_initial_model ( const real    waveletFreq,
     set_array_to_constant( s->br.xy, 0, numberOfCells);
     set_array_to_constant( s->br.yy, 0, numberOfCells);
 
+#if defined(DO_NOT_PERFORM_IO)
+
+    /* initalize velocity components */
+    set_array_to_random_real( v->tl.u, numberOfCells );
+    set_array_to_random_real( v->tl.v, numberOfCells );
+    set_array_to_random_real( v->tl.w, numberOfCells );
+    set_array_to_random_real( v->tr.u, numberOfCells );
+    set_array_to_random_real( v->tr.v, numberOfCells );
+    set_array_to_random_real( v->tr.w, numberOfCells );
+    set_array_to_random_real( v->bl.u, numberOfCells );
+    set_array_to_random_real( v->bl.v, numberOfCells );
+    set_array_to_random_real( v->bl.w, numberOfCells );
+    set_array_to_random_real( v->br.u, numberOfCells );
+    set_array_to_random_real( v->br.v, numberOfCells );
+    set_array_to_random_real( v->br.w, numberOfCells );
+
+    (void) waveletFreq;
+
+#else /* load velocity model from external file */
+
+    /* local variables */
+    double tstart_outer, tstart_inner;
+    double tend_outer, tend_inner;
+    double iospeed_inner, iospeed_outer;
+    char modelname[300];
+
+     /* open initial model, binary file */
+    sprintf( modelname, "../data/inputmodels/velocitymodel_%.2f.bin", waveletFreq );
+
+    print_info("Loading input model %s from disk (this could take a while)", modelname);
+
+    /* start clock, take into account file opening */
+    tstart_outer = dtime();
+    io_file_t model;
+    io_open( &model, modelname, 0, 0 );
+
+    /* start clock, do not take into account file opening */
+    tstart_inner = dtime();
+
+    /* initalize velocity components, the local box of each global volume */
+    real* fields[VELOCITY_FIELDS];
+    velocity_field_list( v, fields );
+
+    for (int i = 0; i < VELOCITY_FIELDS; i++)
+        domain_read_box( &model, i, fields[i], domain, domain_local_box( domain ) );
+
+    /* stop inner timer */
+    tend_inner = dtime() - tstart_inner;
+
+    /* stop timer and compute statistics */
+    io_close( &model );
+    tend_outer = dtime() - tstart_outer;
+
+    //fprintf(stderr, "Number of cells %d\n", numberOfCells);
+    //fprintf(stderr, "sizeof real %lu\n", sizeof(real));
+    //fprintf(stderr, "bytes %lf\n", numberOfCells * sizeof(real) * 12.f);
+
+    iospeed_inner = ((numberOfCells * sizeof(real) * 12.f) / (1000.f * 1000.f)) / tend_inner;
+    iospeed_outer = ((numberOfCells * sizeof(real) * 12.f) / (1000.f * 1000.f)) / tend_outer;
+
+    print_stats("Initial velocity model loaded (%lf GB)", TOGB(numberOfCells * sizeof(real) * 12));
+    print_stats("\tInner time %lf seconds (%lf MiB/s)", tend_inner, iospeed_inner);
+    print_stats("\tOuter time %lf seconds (%lf MiB/s)", tend_outer, iospeed_outer);
+    print_stats("\tDifference %lf seconds", tend_outer - tend_inner);
+
+#endif /* end of pragma DDO_NOT_PERFORM_IO clause */
+
+    POP_RANGE
+};
+
+/*
+ * Loads initial values from coeffs, stress and velocity.
+ */
+void load_initial_model ( const real      waveletFreq,
+                          const domain_t *domain,
+                          coeff_t        *c,
+                          s_t            *s,
+                          v_t            *v,
+                          real           *rho)
+{
+    PUSH_RANGE
+
+    const int numberOfCells = domain_local_cells( domain );
+
 #if defined(DO_NOT_PERFORM_IO)
 
     /* initialize coefficients */
@@ -356,20 +475,6 @@ void load_initial_model ( const real    waveletFreq,
     set_array_to_random_real( c->c56, numberOfCells);
     set_array_to_random_real( c->c66, numberOfCells);
 
-    /* initalize velocity components */
-    set_array_to_random_real( v->tl.u, numberOfCells );
-    set_array_to_random_real( v->tl.v, numberOfCells );
-    set_array_to_random_real( v->tl.w, numberOfCells );
-    set_array_to_random_real( v->tr.u, numberOfCells );
-    set_array_to_random_real( v->tr.v, numberOfCells );
-    set_array_to_random_real( v->tr.w, numberOfCells );
-    set_array_to_random_real( v->bl.u, numberOfCells );
-    set_array_to_random_real( v->bl.v, numberOfCells );
-    set_array_to_random_real( v->bl.w, numberOfCells );
-    set_array_to_random_real( v->br.u, numberOfCells );
-    set_array_to_random_real( v->br.v, numberOfCells );
-    set_array_to_random_real( v->br.w, numberOfCells );
-
     /* initialize rho */
     set_array_to_random_real( rho, numberOfCells );
 
@@ -401,71 +506,85 @@ void load_initial_model ( const real    waveletFreq,
     /* initialize rho */
     set_array_to_constant( rho, 1.0, numberOfCells );
 
-    /* local variables */
-    double tstart_outer, tstart_inner;
-    double tend_outer, tend_inner;
-    double iospeed_inner, iospeed_outer;
-    char modelname[300];
-
-     /* open initial model, binary file */
-    sprintf( modelname, "../data/inputmodels/velocitymodel_%.2f.bin", waveletFreq );
-
-    print_info("Loading input model %s from disk (this could take a while)", modelname);
+#endif /* end of pragma DDO_NOT_PERFORM_IO clause */
 
-    /* start clock, take into account file opening */
-    tstart_outer = dtime();
-    FILE* model = safe_fopen( modelname, "rb", __FILE__, __LINE__ );
+    load_initial_wavefield( waveletFreq, domain, s, v );
 
-    /* start clock, do not take into account file opening */
-    tstart_inner = dtime();
+    POP_RANGE
+};
 
-    int id;
-#if defined(USE_MPI)
-    MPI_Comm_rank( MPI_COMM_WORLD, &id );
-#else
-    id = 0;
-#endif
+/*
+ * Uniform value in [0,1) from the global position of a cell, the same
+ * whichever process holds it (splitmix64 finalizer).
+ */
+static real cell_random ( const integer z, const integer x, const integer y )
+{
+    uint64_t h = ((uint64_t) y << 42) ^ ((uint64_t) x << 21) ^ (uint64_t) z;
 
-    const integer bytesForVolume = numberOfCells * sizeof(real);
+    h += 0x9e3779b97f4a7c15ULL;
+    h  = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    h  = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+    h  =  h ^ (h >> 31);
 
-    /* seek to the correct position corresponding to id (0 or rank) */
-    if (fseek ( model, bytesForVolume * id, SEEK_SET) != 0)
-        print_error("fseek() failed to set the correct position");
+    return (real) (h >> 40) / (real) (1 << 24);
+};
 
-    /* initalize velocity components */
-    safe_fread( v->tl.u, sizeof(real), numberOfCells, model, __FILE__, __LINE__ );
-    safe_fread( v->tl.v, sizeof(real), numberOfCells, model, __FILE__, __LINE__ );
-    safe_fread( v->tl.w, sizeof(real), numberOfCells, model, __FILE__, __LINE__ );
-    safe_fread( v->tr.u, sizeof(real), numberOfCells, model, __FILE__, __LINE__ );
-    safe_fread( v->tr.v, sizeof(real), numberOfCells, model, __FILE__, __LINE__ );
-    safe_fread( v->tr.w, sizeof(real), numberOfCells, model, __FILE__, __LINE__ );
-    safe_fread( v->bl.u, sizeof(real), numberOfCells, model, __FILE__, __LINE__ );
-    safe_fread( v->bl.v, sizeof(real), numberOfCells, model, __FILE__, __LINE__ );
-    safe_fread( v->bl.w, sizeof(real), numberOfCells, model, __FILE__, __LINE__ );
-    safe_fread( v->br.u, sizeof(real), numberOfCells, model, __FILE__, __LINE__ );
-    safe_fread( v->br.v, sizeof(real), numberOfCells, model, __FILE__, __LINE__ );
-    safe_fread( v->br.w, sizeof(real), numberOfCells, model, __FILE__, __LINE__ );
+/* cells between a global coordinate and the nearest computed edge of its axis */
+static integer frame_distance ( const integer c, const integer gdim )
+{
+    const integer lo = c - HALO;
+    const integer hi = gdim - HALO - 1 - c;
+    const integer d  = (lo < hi) ? lo : hi;
 
-    /* stop inner timer */
-    tend_inner = dtime() - tstart_inner;
+    return (d > 0) ? d : 0;
+};
 
-    /* stop timer and compute statistics */
-    safe_fclose ( "velocitymodel.bin", model, __FILE__, __LINE__ );
-    tend_outer = dtime() - tstart_outer;
+void random_boundary_layer ( const domain_t *domain,
+                             coeff_t        *c,
+                             const integer   width )
+{
+    PUSH_RANGE
 
-    //fprintf(stderr, "Number of cells %d\n", numberOfCells);
-    //fprintf(stderr, "sizeof real %lu\n", sizeof(real));
-    //fprintf(stderr, "bytes %lf\n", numberOfCells * sizeof(real) * 12.f);
+    real *fields[COEFF_FIELDS];
+    coeff_field_list( c, fields );
 
-    iospeed_inner = ((numberOfCells * sizeof(real) * 12.f) / (1000.f * 1000.f)) / tend_inner;
-    iospeed_outer = ((numberOfCells * sizeof(real) * 12.f) / (1000.f * 1000.f)) / tend_outer;
+    const integer dimmz = domain->dimmz;
+    const integer dimmx = domain->dimmx;
+    integer ncells = 0;
 
-    print_stats("Initial velocity model loaded (%lf GB)", TOGB(numberOfCells * sizeof(real) * 12));
-    print_stats("\tInner time %lf seconds (%lf MiB/s)", tend_inner, iospeed_inner);
-    print_stats("\tOuter time %lf seconds (%lf MiB/s)", tend_outer, iospeed_outer);
-    print_stats("\tDifference %lf seconds", tend_outer - tend_inner);
+    for (integer y = 0; y < domain->dimmy; y++)
+    {
+        const integer gy = domain->y0 + y;
+        const integer dy = frame_distance( gy, domain->gdimmy );
+
+        for (integer x = 0; x < dimmx; x++)
+        {
+            const integer gx = domain->x0 + x;
+            const integer dx = frame_distance( gx, domain->gdimmx );
+
+            for (integer z = 0; z < dimmz; z++)
+            {
+                const integer gz = domain->z0 + z;
+                const integer dz = frame_distance( gz, domain->gdimmz );
+
+                integer d = (dy < dx) ? dy : dx;
+                if ( dz < d ) d = dz;
+                if ( d >= width ) continue;
+
+                /* velocities only go down, so the time step stays stable */
+                const real depth = (real) (width - d) / (real) width;
+                const real scale = 1.f - RANDOM_BOUNDARY_AMPLITUDE * depth * cell_random( gz, gx, gy );
+                const integer i  = IDX(z, x, y, dimmz, dimmx);
+
+                for (int f = 0; f < COEFF_FIELDS; f++)
+                    fields[f][i] *= scale * scale;
+
+                ncells++;
+            }
+        }
+    }
 
-#endif /* end of pragma DDO_NOT_PERFORM_IO clause */
+    print_info("Random boundary: " I " cells within " I " cells of the frame randomized", ncells, width);
 
     POP_RANGE
 };
@@ -474,12 +593,39 @@ void load_initial_model ( const real    waveletFreq,
 /*
  * Saves the complete velocity field to disk.
  */
+#if defined(USE_MPI) && !defined(DO_NOT_PERFORM_IO)
+/*
+ * Snapshots go through MPI-IO collectives when FWI_SNAPSHOT_IO=1, through
+ * per-process stdio streams otherwise.
+ */
+static int snapshot_mpiio ( void )
+{
+    return ( parse_env("FWI_SNAPSHOT_IO") == 1 );
+};
+#endif
+
+#if defined(USE_MPI) && !defined(DO_NOT_PERFORM_IO) && defined(LOG_IO_STATS)
+/* bandwidth of a collective transfer, as seen by the whole communicator */
+static void log_mpiio_stats ( const char     *operation,
+                              const integer   localCells,
+                              const double    seconds,
+                              const domain_t *domain)
+{
+    double tmax = seconds;
+    double bytes = (double) localCells * sizeof(real) * VELOCITY_FIELDS;
+    MPI_Allreduce( MPI_IN_PLACE, &tmax,  1, MPI_DOUBLE, MPI_MAX, domain->comm );
+    MPI_Allreduce( MPI_IN_PLACE, &bytes, 1, MPI_DOUBLE, MPI_SUM, domain->comm );
+
+    print_stats("%s snapshot through MPI-IO (%lf GB local, %lf GB all processes)",
+                operation, TOGB(localCells * sizeof(real) * VELOCITY_FIELDS), bytes / (1024.0 * 1024.0 * 1024.0));
+    print_stats("\tCollective time %lf seconds (%lf MB/s aggregate)", tmax, (bytes / (1000.0 * 1000.0)) / tmax);
+};
+#endif
+
 void write_snapshot(char *folder,
                     int suffix,
-                    v_t *v,
-                    const integer dimmz,
-                    const integer dimmx,
-                    const integer dimmy)
+                    real *fields[VELOCITY_FIELDS],
+                    const domain_t *domain)
 {
     PUSH_RANGE
 
@@ -487,18 +633,10 @@ void write_snapshot(char *folder,
     print_info("We are not writing the snapshot here cause IO is not enabled!");
 #else
 
-    int domain, ndomains;
-#if defined(USE_MPI)
-    MPI_Comm_rank( MPI_COMM_WORLD, &domain );
-    MPI_Comm_size( MPI_COMM_WORLD, &ndomains );
-#else
-    domain = 0; ndomains = 1;
-#endif
-
-    const integer cellsInVolume  = (dimmz) * (dimmx) * ( (dimmy-2*HALO)/ndomains );
-    const integer cellsInHALOs   = (dimmz) * (dimmx) * (2*HALO);
-    const integer numberOfCells  = cellsInVolume + cellsInHALOs;
-    const integer bytesForVolume = cellsInVolume * sizeof(real);
+    /* every process writes the cells it owns of the global volumes */
+    const box_t   owned         = domain_owned_box( domain );
+    const size_t  bytesForFile  = (size_t) domain->gdimmz * domain->gdimmx * domain->gdimmy
+                                * sizeof(real) * VELOCITY_FIELDS;
 
     /* local variables */
     char fname[300];
@@ -506,43 +644,61 @@ void write_snapshot(char *folder,
     /* open snapshot file and write results */
     sprintf(fname,"%s/snapshot.%05d.bin", folder, suffix);
 
+    /* compressed by sections, on request */
+    codec_t codec;
+    if ( codec_from_env( &codec ) )
+    {
+        codec_write_volumes( &codec, fname, fields, VELOCITY_FIELDS, domain );
+        POP_RANGE
+        return;
+    }
+
+    /* a coarser grid, on request */
+    integer factor;
+    if ( decimate_from_env( &factor ) )
+    {
+        decimate_write_volumes( factor, fname, fields, VELOCITY_FIELDS, domain );
+        POP_RANGE
+        return;
+    }
+
+#if defined(USE_MPI)
+    if ( snapshot_mpiio() )
+    {
+#if defined(LOG_IO_STATS)
+        const double tstart = dtime();
+#endif
+        domain_write_volumes( fname, fields, VELOCITY_FIELDS, domain, owned );
+#if defined(LOG_IO_STATS)
+        log_mpiio_stats( "Write", box_cells( owned ), dtime() - tstart, domain );
+#endif
+        POP_RANGE
+        return;
+    }
+#endif
+
 #if defined(LOG_IO_STATS)
     double tstart_outer = dtime();
 #endif
-    FILE *snapshot = safe_fopen(fname,"wb", __FILE__, __LINE__ );
+    io_file_t snapshot;
+    io_open( &snapshot, fname, 1, bytesForFile );
 #if defined(LOG_IO_STATS)
     double tstart_inner = dtime();
 #endif
 
-    /* seek to the correct position corresponding to domain(id) */
-    if (fseek ( snapshot, bytesForVolume * domain, SEEK_SET) != 0)
-        print_error("fseek() failed to set the correct position");
-
-    safe_fwrite( v->tr.u, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
-    safe_fwrite( v->tr.v, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
-    safe_fwrite( v->tr.w, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
-
-    safe_fwrite( v->tl.u, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
-    safe_fwrite( v->tl.v, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
-    safe_fwrite( v->tl.w, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
-
-    safe_fwrite( v->br.u, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
-    safe_fwrite( v->br.v, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
-    safe_fwrite( v->br.w, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
-
-    safe_fwrite( v->bl.u, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
-    safe_fwrite( v->bl.v, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
-    safe_fwrite( v->bl.w, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
+    for (int i = 0; i < VELOCITY_FIELDS; i++)
+        domain_write_box( &snapshot, i, fields[i], domain, owned );
 
 #if defined(LOG_IO_STATS)
     /* stop inner timer */
     double tend_inner = dtime();
 #endif
     /* close file and stop outer timer */
-    safe_fclose(fname, snapshot, __FILE__, __LINE__ );
+    io_close( &snapshot );
 #if defined(LOG_IO_STATS)
     double tend_outer = dtime();
 
+    const integer numberOfCells = box_cells( owned );
     double iospeed_inner = (( (double) numberOfCells * sizeof(real) * 12.f) / (1000.f * 1000.f)) / (tend_inner - tstart_inner);
     double iospeed_outer = (( (double) numberOfCells * sizeof(real) * 12.f) / (1000.f * 1000.f)) / (tend_outer - tstart_outer);
 
@@ -561,10 +717,8 @@ void write_snapshot(char *folder,
  */
 void read_snapshot(char *folder,
                    int suffix,
-                   v_t *v,
-                   const integer dimmz,
-                   const integer dimmx,
-                   const integer dimmy)
+                   real *fields[VELOCITY_FIELDS],
+                   const domain_t *domain)
 {
     PUSH_RANGE
 
@@ -577,56 +731,62 @@ void read_snapshot(char *folder,
     /* open file and read snapshot */
     sprintf(fname,"%s/snapshot.%05d.bin", folder, suffix);
 
+    /* the local box, ghost cells included, comes from the global volumes */
+    const box_t local = domain_local_box( domain );
+
+    codec_t codec;
+    if ( codec_from_env( &codec ) )
+    {
+        codec_read_volumes( fname, fields, VELOCITY_FIELDS, domain );
+        POP_RANGE
+        return;
+    }
+
+    integer factor;
+    if ( decimate_from_env( &factor ) )
+    {
+        decimate_read_volumes( factor, fname, fields, VELOCITY_FIELDS, domain );
+        POP_RANGE
+        return;
+    }
+
+#if defined(USE_MPI)
+    if ( snapshot_mpiio() )
+    {
 #if defined(LOG_IO_STATS)
-    double tstart_outer = dtime();
+        const double tstart = dtime();
 #endif
-    FILE *snapshot = safe_fopen(fname,"rb", __FILE__, __LINE__ );
+        domain_read_volumes( fname, fields, VELOCITY_FIELDS, domain, local );
 #if defined(LOG_IO_STATS)
-    double tstart_inner = dtime();
+        log_mpiio_stats( "Read", box_cells( local ), dtime() - tstart, domain );
 #endif
-
-    int domain, ndomains;
-#if defined(USE_MPI)
-    MPI_Comm_rank( MPI_COMM_WORLD, &domain );
-    MPI_Comm_size( MPI_COMM_WORLD, &ndomains );
-#else
-    domain = 0; ndomains = 1;
+        POP_RANGE
+        return;
+    }
 #endif
 
-    const integer cellsInVolume  = (dimmz) * (dimmx) * ( (dimmy-2*HALO)/ndomains );
-    const integer cellsInHALOs   = (dimmz) * (dimmx) * (2*HALO);
-    const integer numberOfCells  = cellsInVolume + cellsInHALOs;
-    const integer bytesForVolume = cellsInVolume * sizeof(real);
-
-    /* seek to the correct position corresponding to rank */
-    if (fseek ( snapshot, bytesForVolume * domain, SEEK_SET) != 0)
-        print_error("fseek() failed to set the correct position");
-
-    safe_fread( v->tr.u, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
-    safe_fread( v->tr.v, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
-    safe_fread( v->tr.w, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
-
-    safe_fread( v->tl.u, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
-    safe_fread( v->tl.v, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
-    safe_fread( v->tl.w, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
-
-    safe_fread( v->br.u, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
-    safe_fread( v->br.v, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
-    safe_fread( v->br.w, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
+#if defined(LOG_IO_STATS)
+    double tstart_outer = dtime();
+#endif
+    io_file_t snapshot;
+    io_open( &snapshot, fname, 0, 0 );
+#if defined(LOG_IO_STATS)
+    double tstart_inner = dtime();
+#endif
 
-    safe_fread( v->bl.u, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
-    safe_fread( v->bl.v, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
-    safe_fread( v->bl.w, sizeof(real), numberOfCells, snapshot, __FILE__, __LINE__ );
+    for (int i = 0; i < VELOCITY_FIELDS; i++)
+        domain_read_box( &snapshot, i, fields[i], domain, local );
 
 #if defined(LOG_IO_STATS)
     /* stop inner timer */
     double tend_inner = dtime() - tstart_inner;
 #endif
     /* close file and stop outer timer */
-    safe_fclose(fname, snapshot, __FILE__, __LINE__ );
+    io_close( &snapshot );
 #if defined(LOG_IO_STATS)
     double tend_outer = dtime() - tstart_outer;
 
+    const integer numberOfCells = box_cells( local );
     double iospeed_inner = ((numberOfCells * sizeof(real) * 12.f) / (1000.f * 1000.f)) / tend_inner;
     double iospeed_outer = ((numberOfCells * sizeof(real) * 12.f) / (1000.f * 1000.f)) / tend_outer;
 
@@ -641,29 +801,170 @@ void read_snapshot(char *folder,
     POP_RANGE
 };
 
-void propagate_shot(time_d        direction,
-                    v_t           v,
-                    s_t           s,
-                    coeff_t       coeffs,
-                    real          *rho,
-                    int           timesteps,
-                    int           ntbwd,
-                    real          dt,
-                    real          dzi,
-                    real          dxi,
-                    real          dyi,
-                    integer       nz0,
-                    integer       nzf,
-                    integer       nx0,
-                    integer       nxf,
-                    integer       ny0,
-                    integer       nyf,
-                    integer       stacki,
-                    char          *folder,
-                    real          *UNUSED(dataflush),
-                    integer       dimmz,
-                    integer       dimmx,
-                    integer       dimmy)
+/*
+ * Time spent in the halo exchanges and how much of it was not hidden behind
+ * the computation of the central planes (phase TWO).
+ */
+typedef struct
+{
+    double tcomm;
+    double tinterior;
+    double texposed;
+    double texposed_max;   /* worst step */
+} overlap_stats_t;
+
+/*
+ * A dedicated communication thread is used when requested through
+ * FWI_COMM_THREAD, MPI provides MPI_THREAD_FUNNELED or higher and there
+ * is at least one thread left to compute.
+ */
+static int use_comm_thread ( void )
+{
+#if defined(USE_MPI) && defined(_OPENMP)
+    if ( parse_env("FWI_COMM_THREAD") == 0 ) return 0;
+
+    int thread_level;
+    MPI_Query_thread( &thread_level );
+
+    if ( thread_level < MPI_THREAD_FUNNELED || omp_get_max_threads() < 2 )
+    {
+        print_info("FWI_COMM_THREAD ignored: it needs MPI_THREAD_FUNNELED and two or more OpenMP threads");
+        return 0;
+    }
+
+    /* the computing threads open a nested team inside the outer region */
+    if ( omp_get_max_active_levels() < 2 ) omp_set_max_active_levels(2);
+    return 1;
+#else
+    return 0;
+#endif
+};
+
+/*
+ * Phase TWO of the velocity (or stress) update, on the interior of the local
+ * domain, and, in MPI builds, the halo exchange of the boundary slabs
+ * computed in the previous phases. Phase TWO neither reads nor writes the
+ * exchanged cells, so both run at the same time. By default the exchange is
+ * started before the interior and completed after it; only the packing and
+ * the final wait are exposed. With a communication thread, the master
+ * thread of a two-thread region performs the whole exchange
+ * (MPI_THREAD_FUNNELED) while the other one opens a nested team with the
+ * remaining threads to compute the interior, which also progresses
+ * messages that need the MPI library to be called.
+ */
+static void interior_and_exchange ( const int        stress,
+                                    v_t              v,
+                                    s_t              s,
+                                    coeff_t          coeffs,
+                                    real            *rho,
+                                    const real       dt,
+                                    const real       dzi,
+                                    const real       dxi,
+                                    const real       dyi,
+                                    const box_t      interior,
+                                    const domain_t  *domain,
+                                    halo_t          *halo,
+                                    const int        comm_thread,
+                                    overlap_stats_t *stats)
+{
+    const box_t   b     = interior;
+    const integer dimmz = domain->dimmz;
+    const integer dimmx = domain->dimmx;
+
+    double tcomm = 0.0, tinterior = 0.0, texposed = 0.0;
+
+#if defined(USE_MPI) && defined(_OPENMP)
+    if ( comm_thread )
+    {
+        const int    nthreads = omp_get_max_threads();
+        const double tstart   = dtime();
+
+        #pragma omp parallel num_threads(2)
+        {
+            if ( omp_get_thread_num() == 0 )
+            {
+                const double t0 = dtime();
+                halo_exchange( halo );
+                tcomm = dtime() - t0;
+            }
+            else
+            {
+                omp_set_num_threads( nthreads - 1 );
+
+                const double t0 = dtime();
+                if ( stress )
+                    stress_propagator  ( s, v, coeffs, rho, dt, dzi, dxi, dyi,
+                                         b.z0, b.zf, b.x0, b.xf, b.y0, b.yf,
+                                         dimmz, dimmx, TWO );
+                else
+                    velocity_propagator( v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                                         b.z0, b.zf, b.x0, b.xf, b.y0, b.yf,
+                                         dimmz, dimmx, TWO );
+                tinterior = dtime() - t0;
+            }
+        }
+
+        /* whatever the exchange added on top of the interior */
+        texposed = (dtime() - tstart) - tinterior;
+        if ( texposed < 0.0 ) texposed = 0.0;
+    }
+    else
+#endif
+    {
+        double t0 = dtime();
+        halo_start( halo );
+        tcomm = dtime() - t0;
+
+        t0 = dtime();
+        if ( stress )
+            stress_propagator  ( s, v, coeffs, rho, dt, dzi, dxi, dyi,
+                                 b.z0, b.zf, b.x0, b.xf, b.y0, b.yf,
+                                 dimmz, dimmx, TWO );
+        else
+            velocity_propagator( v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                                 b.z0, b.zf, b.x0, b.xf, b.y0, b.yf,
+                                 dimmz, dimmx, TWO );
+        tinterior = dtime() - t0;
+
+        t0 = dtime();
+        halo_wait( halo );
+        tcomm   += dtime() - t0;
+        texposed = tcomm;
+    }
+
+    stats->tcomm     += tcomm;
+    stats->tinterior += tinterior;
+    stats->texposed  += texposed;
+
+    print_debug("%s halo exchange %lf s, interior %lf s, exposed %lf s",
+                (stress) ? "Stress" : "Velocity", tcomm, tinterior, texposed);
+};
+
+void propagate_shot(time_d          direction,
+                    v_t             v,
+                    s_t             s,
+                    coeff_t         coeffs,
+                    real           *rho,
+                    int             timesteps,
+                    int             UNUSED(ntbwd),
+                    real            dt,
+                    real            dzi,
+                    real            dxi,
+                    real            dyi,
+                    integer         nz0,
+                    integer         nzf,
+                    integer         nx0,
+                    integer         nxf,
+                    integer         ny0,
+                    integer         nyf,
+                    integer         stacki,
+                    snapshots_t    *snapshots,
+                    real           *UNUSED(dataflush),
+                    const domain_t *domain,
+                    throughput_t   *throughput,
+                    boundary_t     *boundary,
+                    dft_t          *dft,
+                    imaging_t      *imaging)
 {
     PUSH_RANGE
 
@@ -672,119 +973,210 @@ void propagate_shot(time_d        direction,
     double tvel_start, tvel_total = 0.0;
     double megacells = 0.0;
 
+    /* local extents of the arrays */
+    const integer dimmz = domain->dimmz;
+    const integer dimmx = domain->dimmx;
+
+    /* boundary slabs, whose cells are sent to the neighbours, and interior */
+    const box_t compute = { nz0 + HALO, nzf - HALO, nx0 + HALO, nxf - HALO, ny0 + HALO, nyf - HALO };
+    box_t slabs[NFACES], interior;
+    const int nslabs = domain_split_box( domain, compute, slabs, &interior );
+
+    /* halo exchange engines, one message pair per neighbour and update */
+    real *vfields[VELOCITY_FIELDS], *sfields[STRESS_FIELDS];
+    velocity_field_list( &v, vfields );
+    stress_field_list  ( &s, sfields );
+
+    /* velocities are read by the stress update and vice versa */
+    stencil_read_t vreads[PROPAGATOR_STENCIL_READS], sreads[PROPAGATOR_STENCIL_READS];
+    stress_propagator_reads  ( v, vreads );
+    velocity_propagator_reads( s, sreads );
+
+    integer vdepth[VELOCITY_FIELDS][NFACES], sdepth[STRESS_FIELDS][NFACES];
+    halo_depths( vreads, PROPAGATOR_STENCIL_READS, vfields, VELOCITY_FIELDS, vdepth );
+    halo_depths( sreads, PROPAGATOR_STENCIL_READS, sfields, STRESS_FIELDS,   sdepth );
+
+    halo_t vhalo, shalo;
+    halo_setup( &vhalo, domain, vfields, (const integer (*)[NFACES]) vdepth, VELOCITY_FIELDS );
+    halo_setup( &shalo, domain, sfields, (const integer (*)[NFACES]) sdepth, STRESS_FIELDS   );
+
+    /* halo exchanges progressed by a dedicated thread (hybrid MPI+OpenMP) */
+    const int comm_thread = use_comm_thread();
+    overlap_stats_t overlap = { 0.0, 0.0, 0.0, 0.0 };
+
+    /* optional intra-process decomposition, one sub-domain per NUMA node,
+     * not with boundary strips (they are moved in the process-wide arrays)
+     * nor when running back in time */
+    const int use_numa = ( boundary == NULL && direction != RECONSTRUCT );
+    numa_t *numa = numa_setup( v, s, coeffs, rho, ny0, nyf, dimmz, dimmx,
+                               (use_numa) ? numa_get_num_domains() : 0 );
+
+    real *wfields[VELOCITY_FIELDS + STRESS_FIELDS];
+    velocity_field_list( &v, wfields );
+    stress_field_list  ( &s, wfields + VELOCITY_FIELDS );
+
+    /* beginning of the last interval of stacki timesteps */
+    const int tlast = ((timesteps - 1) / stacki) * stacki;
+
     for(int t=0; t < timesteps; t++)
     {
         PUSH_RANGE
 
         if( t % 10 == 0 ) print_info("Computing %d-th timestep", t);
 
-        /* perform IO */
-        if ( t%stacki == 0 && direction == BACKWARD) read_snapshot(folder, ntbwd-t, &v, dimmz, dimmx, dimmy);
-
-        tglobal_start = dtime();
+        /* velocities at the beginning of every interval: the backward
+         * propagation meets the forward one of time tlast-t */
+        if ( t%stacki == 0 && (snapshots != NULL || imaging != NULL || dft != NULL) )
+        {
+            if ( numa != NULL ) numa_gather_velocity( numa, v );
 
-        /* ------------------------------------------------------------------------------ */
-        /*                      VELOCITY COMPUTATION                                      */
-        /* ------------------------------------------------------------------------------ */
-
-        /* Phase 1. Computation of the left-most planes of the domain */
-        velocity_propagator(v, s, coeffs, rho, dt, dzi, dxi, dyi,
-                            nz0 +   HALO,
-                            nzf -   HALO,
-                            nx0 +   HALO,
-                            nxf -   HALO,
-                            ny0 +   HALO,
-                            ny0 + 2*HALO,
-                            dimmz, dimmx,
-                            ONE_L);
-
-        /* Phase 1. Computation of the right-most planes of the domain */
-        velocity_propagator(v, s, coeffs, rho, dt, dzi, dxi, dyi,
-                            nz0 +   HALO,
-                            nzf -   HALO,
-                            nx0 +   HALO,
-                            nxf -   HALO,
-                            nyf - 2*HALO,
-                            nyf -   HALO,
-                            dimmz, dimmx,
-                            ONE_R);
-
-        /* Phase 2. Computation of the central planes. */
-        tvel_start = dtime();
-
-        velocity_propagator(v, s, coeffs, rho, dt, dzi, dxi, dyi,
-                            nz0 +   HALO,
-                            nzf -   HALO,
-                            nx0 +   HALO,
-                            nxf -   HALO,
-                            ny0 + 2*HALO,
-                            nyf - 2*HALO,
-                            dimmz, dimmx,
-                            TWO);
-#if defined(USE_MPI)
-        const integer plane_size = dimmz * dimmx;
-        /* Boundary exchange for velocity values */
-        exchange_velocity_boundaries( v, plane_size, nyf, ny0);
-#endif
-        tvel_total += (dtime() - tvel_start);
-
-        /* ------------------------------------------------------------------------------ */
-        /*                        STRESS COMPUTATION                                      */
-        /* ------------------------------------------------------------------------------ */
-
-        /* Phase 1. Computation of the left-most planes of the domain */
-        stress_propagator(s, v, coeffs, rho, dt, dzi, dxi, dyi,
-                          nz0 +   HALO,
-                          nzf -   HALO,
-                          nx0 +   HALO,
-                          nxf -   HALO,
-                          ny0 +   HALO,
-                          ny0 + 2*HALO,
-                          dimmz, dimmx,
-                          ONE_L);
-
-        /* Phase 1. Computation of the right-most planes of the domain */
-        stress_propagator(s, v, coeffs, rho, dt, dzi, dxi, dyi,
-                          nz0 +   HALO,
-                          nzf -   HALO,
-                          nx0 +   HALO,
-                          nxf -   HALO,
-                          nyf - 2*HALO,
-                          nyf -   HALO,
-                          dimmz, dimmx,
-                          ONE_R);
-
-        /* Phase 2 computation. Central planes of the domain */
-        tstress_start = dtime();
-
-        stress_propagator(s, v, coeffs, rho, dt, dzi, dxi, dyi,
-                          nz0 +   HALO,
-                          nzf -   HALO,
-                          nx0 +   HALO,
-                          nxf -   HALO,
-                          ny0 + 2*HALO,
-                          nyf - 2*HALO,
-                          dimmz, dimmx,
-                          TWO);
+            if ( direction == FORWARD && snapshots != NULL )
+                snapshots_put( snapshots, t, vfields );
 
-#if defined(USE_MPI)
-        /* Boundary exchange for stress values */
-        exchange_stress_boundaries( s, plane_size, nyf, ny0);
-#endif
+            if ( direction == BACKWARD && imaging != NULL )
+            {
+                if ( snapshots != NULL ) snapshots_get( snapshots, tlast-t, imaging->forward );
+                imaging_accumulate( imaging, vfields );
+            }
 
-        tstress_total += (dtime() - tstress_start);
+            if ( dft != NULL )
+                dft_accumulate( dft, vfields, ((direction == BACKWARD) ? tlast-t : t) * dt );
+        }
 
-        tglobal_total += (dtime() - tglobal_start);
+        if ( direction == FORWARD && boundary != NULL )
+            boundary_save( boundary, wfields );
 
-        /* perform IO */
-        if ( t%stacki == 0 && direction == FORWARD) write_snapshot(folder, ntbwd-t, &v, dimmz, dimmx, dimmy);
+        tglobal_start = dtime();
+        const double texposed_start = overlap.texposed;
+
+        if ( numa != NULL )
+        {
+            tvel_start = dtime();
+            numa_velocity_propagator( numa, dt, dzi, dxi, dyi, nz0+HALO, nzf-HALO, nx0+HALO, nxf-HALO );
+            numa_exchange_velocity_halos( numa );
+            tvel_total += (dtime() - tvel_start);
+
+            tstress_start = dtime();
+            numa_stress_propagator( numa, dt, dzi, dxi, dyi, nz0+HALO, nzf-HALO, nx0+HALO, nxf-HALO );
+            numa_exchange_stress_halos( numa );
+            tstress_total += (dtime() - tstress_start);
+        }
+        else if ( direction == RECONSTRUCT )
+        {
+            /* the updates of a forward step undone in reverse order (-dt), the boundary
+             * strips of the previous step put back after each one when there are some */
+            for (int i = 0; i < nslabs; i++)
+                stress_propagator(s, v, coeffs, rho, -dt, dzi, dxi, dyi,
+                                  slabs[i].z0, slabs[i].zf,
+                                  slabs[i].x0, slabs[i].xf,
+                                  slabs[i].y0, slabs[i].yf,
+                                  dimmz, dimmx,
+                                  (i % 2 == 0) ? ONE_L : ONE_R);
+
+            tstress_start = dtime();
+
+            interior_and_exchange( 1, v, s, coeffs, rho, -dt, dzi, dxi, dyi,
+                                   interior, domain, &shalo, comm_thread, &overlap );
+            if ( boundary != NULL )
+                boundary_restore( boundary, sfields, VELOCITY_FIELDS, STRESS_FIELDS );
+
+            tstress_total += (dtime() - tstress_start);
+
+            for (int i = 0; i < nslabs; i++)
+                velocity_propagator(v, s, coeffs, rho, -dt, dzi, dxi, dyi,
+                                    slabs[i].z0, slabs[i].zf,
+                                    slabs[i].x0, slabs[i].xf,
+                                    slabs[i].y0, slabs[i].yf,
+                                    dimmz, dimmx,
+                                    (i % 2 == 0) ? ONE_L : ONE_R);
+
+            tvel_start = dtime();
+
+            interior_and_exchange( 0, v, s, coeffs, rho, -dt, dzi, dxi, dyi,
+                                   interior, domain, &vhalo, comm_thread, &overlap );
+            if ( boundary != NULL )
+            {
+                boundary_restore( boundary, vfields, 0, VELOCITY_FIELDS );
+                boundary_drop( boundary );
+            }
+
+            tvel_total += (dtime() - tvel_start);
+        }
+        else
+        {
+            /* ------------------------------------------------------------------------------ */
+            /*                      VELOCITY COMPUTATION                                      */
+            /* ------------------------------------------------------------------------------ */
+
+            /* Phase 1. Computation of the left-most and right-most planes of the domain
+             * along y, and along x and z when those axes are decomposed too */
+            for (int i = 0; i < nslabs; i++)
+                velocity_propagator(v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                                    slabs[i].z0, slabs[i].zf,
+                                    slabs[i].x0, slabs[i].xf,
+                                    slabs[i].y0, slabs[i].yf,
+                                    dimmz, dimmx,
+                                    (i % 2 == 0) ? ONE_L : ONE_R);
+
+            /* Phase 2. Computation of the central planes, overlapped with the exchange */
+            tvel_start = dtime();
+
+            interior_and_exchange( 0, v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                                   interior, domain, &vhalo, comm_thread, &overlap );
+
+            tvel_total += (dtime() - tvel_start);
+
+            /* ------------------------------------------------------------------------------ */
+            /*                        STRESS COMPUTATION                                      */
+            /* ------------------------------------------------------------------------------ */
+
+            /* Phase 1. Computation of the left-most and right-most planes of the domain */
+            for (int i = 0; i < nslabs; i++)
+                stress_propagator(s, v, coeffs, rho, dt, dzi, dxi, dyi,
+                                  slabs[i].z0, slabs[i].zf,
+                                  slabs[i].x0, slabs[i].xf,
+                                  slabs[i].y0, slabs[i].yf,
+                                  dimmz, dimmx,
+                                  (i % 2 == 0) ? ONE_L : ONE_R);
+
+            /* Phase 2 computation. Central planes, overlapped with the exchange */
+            tstress_start = dtime();
+
+            interior_and_exchange( 1, v, s, coeffs, rho, dt, dzi, dxi, dyi,
+                                   interior, domain, &shalo, comm_thread, &overlap );
+
+            tstress_total += (dtime() - tstress_start);
+        }
+
+        const double tstep = dtime() - tglobal_start;
+        tglobal_total += tstep;
+
+        /* communication time the step could not hide */
+        const double texposed_step = overlap.texposed - texposed_start;
+        if ( texposed_step > overlap.texposed_max ) overlap.texposed_max = texposed_step;
+        print_debug("Timestep %d: %lf seconds of exposed halo exchange", t, texposed_step);
+
+        /* what the process is able to compute, for the load balancing */
+        if ( throughput != NULL && t < throughput->steps )
+        {
+            throughput->seconds += tstep - texposed_step;
+            throughput->measured++;
+        }
 
-#if defined(USE_MPI)
-        MPI_Barrier( MPI_COMM_WORLD );
-#endif
         POP_RANGE
     }
 
+    /* the process-wide arrays hold the final wavefield for the next pass */
+    if ( numa != NULL )
+    {
+        numa_gather_velocity( numa, v );
+        numa_gather_stress  ( numa, s );
+        numa_release( numa );
+    }
+
+    halo_release( &vhalo );
+    halo_release( &shalo );
+
     /* compute some statistics */
     megacells = ((nzf - nz0) * (nxf - nx0) * (nyf - ny0)) / 1e6;
     tglobal_total /= (double) timesteps;
@@ -795,188 +1187,370 @@ void propagate_shot(time_d        direction,
     print_stats("Maingrid STRESS   computation took %lf seconds - %lf Mcells/s", tstress_total,  megacells / tstress_total);
     print_stats("Maingrid VELOCITY computation took %lf seconds - %lf Mcells/s", tvel_total, megacells / tvel_total);
 
+#if defined(USE_MPI)
+    /* per-step averages of the halo exchanges of both updates */
+    overlap.tcomm     /= (double) timesteps;
+    overlap.tinterior /= (double) timesteps;
+    overlap.texposed  /= (double) timesteps;
+
+    if ( comm_thread )
+        print_stats("Halo exchange (communication thread) took %lf seconds per step, %lf seconds exposed (%.1lf%% overlapped)",
+                    overlap.tcomm, overlap.texposed,
+                    (overlap.tcomm > 0.0) ? 100.0 * (1.0 - overlap.texposed / overlap.tcomm) : 0.0);
+    else
+        print_stats("Halo exchange (non-blocking) exposed %lf seconds per step packing and waiting",
+                    overlap.texposed);
+
+    print_stats("Worst step exposed %lf seconds of halo exchange (%s transport)",
+                overlap.texposed_max, halo_transport_name( vhalo.transport ));
+    print_stats("Interior computation took %lf seconds per step", overlap.tinterior);
+#endif
+
     POP_RANGE
 };
 
-#if defined(USE_MPI)
-/*
-NAME:exchange_boundaries
-PURPOSE: data exchanges between the boundary layers of the analyzed volume
-
-v                   (in) struct containing velocity arrays (4 points / cell x 3 components / point = 12 arrays)
-plane_size          (in) Number of elements per plane to exchange
-nyf                 (in) final plane to be exchanged
-ny0                 (in) intial plane to be exchanged
-
-RETURN none
-*/
-void exchange_velocity_boundaries ( v_t v,
-                                    const integer plane_size,
-                                    const integer nyf,
-                                    const integer ny0 )
+/* velocity and stress arrays laid out in a single block of volumes */
+static void wavefield_views ( real          *volumes,
+                              const integer  ncells,
+                              v_t           *v,
+                              s_t           *s )
+{
+    real *fields[VELOCITY_FIELDS + STRESS_FIELDS];
+    for (int f = 0; f < VELOCITY_FIELDS + STRESS_FIELDS; f++)
+        fields[f] = volumes + f * ncells;
+
+    v->tl.u  = fields[ 0]; v->tl.v  = fields[ 1]; v->tl.w  = fields[ 2];
+    v->tr.u  = fields[ 3]; v->tr.v  = fields[ 4]; v->tr.w  = fields[ 5];
+    v->bl.u  = fields[ 6]; v->bl.v  = fields[ 7]; v->bl.w  = fields[ 8];
+    v->br.u  = fields[ 9]; v->br.v  = fields[10]; v->br.w  = fields[11];
+
+    real **sf = fields + VELOCITY_FIELDS;
+    s->tl.zz = sf[ 0]; s->tl.xz = sf[ 1]; s->tl.yz = sf[ 2];
+    s->tl.xx = sf[ 3]; s->tl.xy = sf[ 4]; s->tl.yy = sf[ 5];
+    s->tr.zz = sf[ 6]; s->tr.xz = sf[ 7]; s->tr.yz = sf[ 8];
+    s->tr.xx = sf[ 9]; s->tr.xy = sf[10]; s->tr.yy = sf[11];
+    s->bl.zz = sf[12]; s->bl.xz = sf[13]; s->bl.yz = sf[14];
+    s->bl.xx = sf[15]; s->bl.xy = sf[16]; s->bl.yy = sf[17];
+    s->br.zz = sf[18]; s->br.xz = sf[19]; s->br.yz = sf[20];
+    s->br.xx = sf[21]; s->br.xy = sf[22]; s->br.yy = sf[23];
+};
+
+void revolve_shot ( v_t             v,
+                    s_t             s,
+                    coeff_t         coeffs,
+                    real           *rho,
+                    int             timesteps,
+                    int             ntbwd,
+                    real            dt,
+                    real            dzi,
+                    real            dxi,
+                    real            dyi,
+                    integer         nz0,
+                    integer         nzf,
+                    integer         nx0,
+                    integer         nxf,
+                    integer         ny0,
+                    integer         nyf,
+                    integer         stacki,
+                    int             nslots,
+                    real           *gradient,
+                    real           *precond,
+                    const domain_t *domain)
 {
     PUSH_RANGE
 
-    int     rank;          // mpi local rank
-    int     nranks;        // num mpi ranks
+    const integer ncells = domain_local_cells( domain );
+    const size_t  cells  = (size_t) ncells * (VELOCITY_FIELDS + STRESS_FIELDS);
 
-    /* Initialize local variables */
-    MPI_Comm_rank ( MPI_COMM_WORLD, &rank );
-    MPI_Comm_size ( MPI_COMM_WORLD, &nranks );
+    /* one interval of stacki timesteps per snapshot of the store */
+    const int nsteps = (timesteps + stacki - 1) / stacki;
 
-    const integer num_planes = HALO;
-    const integer nelems     = num_planes * plane_size;
+    /* more slots than intervals would never be used */
+    if ( nslots > nsteps ) nslots = nsteps;
 
-    const integer left_recv  = ny0;
-    const integer left_send  = ny0+HALO;
+    revolve_t schedule;
+    revolve_setup( &schedule, nsteps, nslots );
 
-    const integer right_recv = nyf-HALO;
-    const integer right_send = nyf-2*HALO;
+    print_info("Checkpointing: %d intervals reversed with %d checkpoints, %d intervals computed forward (%d without checkpointing), each one %d times at most",
+               nsteps, nslots, schedule.advances, nsteps - 1, schedule.repetitions);
 
-    if ( rank != 0 )
-    {
-        // [RANK-1] <---> [RANK] communication
-        EXCHANGE( &v.tl.u[left_send], &v.tl.u[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &v.tl.v[left_send], &v.tl.v[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &v.tl.w[left_send], &v.tl.w[left_recv], rank-1, rank, nelems );
-
-        EXCHANGE( &v.tr.u[left_send], &v.tr.u[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &v.tr.v[left_send], &v.tr.v[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &v.tr.w[left_send], &v.tr.w[left_recv], rank-1, rank, nelems );
-
-        EXCHANGE( &v.bl.u[left_send], &v.bl.u[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &v.bl.v[left_send], &v.bl.v[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &v.bl.w[left_send], &v.bl.w[left_recv], rank-1, rank, nelems );
-
-        EXCHANGE( &v.br.u[left_send], &v.br.u[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &v.br.v[left_send], &v.br.v[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &v.br.w[left_send], &v.br.w[left_recv], rank-1, rank, nelems );
-    }
+    /* the forward wavefield lives apart from the backward one, in 'forward' */
+    real *forward = (real*) __malloc( ALIGN_REAL, cells * sizeof(real) );
+    real *slots   = (real*) __malloc( ALIGN_REAL, cells * sizeof(real) * nslots );
+
+    v_t fv;
+    s_t fs;
+    wavefield_views( forward, ncells, &fv, &fs );
 
-    if ( rank != nranks -1 )  //task to exchange stress boundaries
+    real *src[VELOCITY_FIELDS + STRESS_FIELDS], *dst[VELOCITY_FIELDS + STRESS_FIELDS];
+    velocity_field_list( &v,  src );
+    stress_field_list  ( &s,  src + VELOCITY_FIELDS );
+    velocity_field_list( &fv, dst );
+    stress_field_list  ( &fs, dst + VELOCITY_FIELDS );
+
+    for (int f = 0; f < VELOCITY_FIELDS + STRESS_FIELDS; f++)
+        memcpy( dst[f], src[f], ncells * sizeof(real) );
+
+    /* the backward propagation correlates its velocities with the forward ones */
+    imaging_t imaging;
+    imaging_setup( &imaging, VELOCITY_FIELDS, ncells, stacki * dt, gradient, precond, dst );
+
+    double tforward = 0.0, tbackward = 0.0, tcopies = 0.0;
+    int reversed = 0;
+
+    for (int i = 0; i < schedule.nactions; i++)
     {
-        //                [RANK] <---> [RANK+1] communication
-        EXCHANGE( &v.tl.u[right_send], &v.tl.u[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &v.tl.v[right_send], &v.tl.v[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &v.tl.w[right_send], &v.tl.w[right_recv], rank+1, rank, nelems );
-
-        EXCHANGE( &v.tr.u[right_send], &v.tr.u[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &v.tr.v[right_send], &v.tr.v[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &v.tr.w[right_send], &v.tr.w[right_recv], rank+1, rank, nelems );
-
-        EXCHANGE( &v.bl.u[right_send], &v.bl.u[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &v.bl.v[right_send], &v.bl.v[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &v.bl.w[right_send], &v.bl.w[right_recv], rank+1, rank, nelems );
-
-        EXCHANGE( &v.br.u[right_send], &v.br.u[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &v.br.v[right_send], &v.br.v[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &v.br.w[right_send], &v.br.w[right_recv], rank+1, rank, nelems );
+        const revolve_action_t *action = &schedule.actions[i];
+        const double start_t = dtime();
+
+        switch ( action->kind )
+        {
+        case( REVOLVE_ADVANCE ):
+        {
+            const int last = ( action->to * stacki < timesteps ) ? action->to * stacki : timesteps;
+
+            propagate_shot( FORWARD, fv, fs, coeffs, rho,
+                            last - action->from * stacki, ntbwd,
+                            dt, dzi, dxi, dyi,
+                            nz0, nzf, nx0, nxf, ny0, nyf,
+                            stacki, NULL, NULL, domain, NULL, NULL, NULL, NULL );
+
+            tforward += dtime() - start_t;
+            break;
+        }
+        case( REVOLVE_TAKESHOT ):
+            memcpy( slots + action->slot * cells, forward, cells * sizeof(real) );
+            tcopies += dtime() - start_t;
+            break;
+        case( REVOLVE_RESTORE ):
+            memcpy( forward, slots + action->slot * cells, cells * sizeof(real) );
+            tcopies += dtime() - start_t;
+            break;
+        default:
+        {
+            /* the forward velocities take the place of the snapshot reads */
+            const int first = reversed * stacki;
+            const int last  = ( first + stacki < timesteps ) ? first + stacki : timesteps;
+
+            propagate_shot( BACKWARD, v, s, coeffs, rho,
+                            last - first, ntbwd,
+                            dt, dzi, dxi, dyi,
+                            nz0, nzf, nx0, nxf, ny0, nyf,
+                            stacki, NULL, NULL, domain, NULL, NULL, NULL, &imaging );
+
+            tbackward += dtime() - start_t;
+            reversed++;
+        }
+        }
     }
 
+    print_stats("Checkpointing: forward intervals took %lf seconds, backward ones %lf seconds, checkpoint copies %lf seconds",
+                tforward, tbackward, tcopies);
+
+    __free( forward );
+    __free( slots   );
+    revolve_release( &schedule );
+    imaging_release( &imaging );
+
     POP_RANGE
 };
 
-/*
-NAME:exchange_stress_boundaries
-PURPOSE: data exchanges between the boundary layers of the analyzed volume
-
-s                   (in) struct containing stress arrays (4 points / cell x 6 components / point = 24 arrays)
-plane_size          (in) Number of elements per plane to exchange
-rank                (in) rank id (CPU id)
-nranks              (in) number of CPUs
-nyf                 (in) final plane to be exchanged
-ny0                 (in) intial plane to be exchanged
-
-RETURN none
-*/
-void exchange_stress_boundaries ( s_t s,
-                                  const integer plane_size,
-                                  const integer nyf,
-                                  const integer ny0 )
+void reconstruct_shot ( v_t             v,
+                        s_t             s,
+                        coeff_t         coeffs,
+                        real           *rho,
+                        int             timesteps,
+                        int             ntbwd,
+                        real            dt,
+                        real            dzi,
+                        real            dxi,
+                        real            dyi,
+                        integer         nz0,
+                        integer         nzf,
+                        integer         nx0,
+                        integer         nxf,
+                        integer         ny0,
+                        integer         nyf,
+                        integer         stacki,
+                        const int       strips,
+                        real           *gradient,
+                        real           *precond,
+                        const domain_t *domain)
 {
     PUSH_RANGE
 
-    int     rank;          // mpi local rank
-    int     nranks;        // num mpi ranks
+    const integer ncells = domain_local_cells( domain );
+    const size_t  cells  = (size_t) ncells * (VELOCITY_FIELDS + STRESS_FIELDS);
 
-    /* Initialize local variables */
-    MPI_Comm_rank ( MPI_COMM_WORLD, &rank );
-    MPI_Comm_size ( MPI_COMM_WORLD, &nranks );
+    /* the backward propagation reads the intervals of stacki timesteps in reverse order */
+    const int nsteps = (timesteps + stacki - 1) / stacki;
+    const int last   = timesteps - (nsteps - 1) * stacki;
 
-    const integer num_planes = HALO;
-    const integer nelems     = num_planes * plane_size;
+    const char *mode = (strips) ? "Boundary saving" : "Random boundary";
 
-    const integer left_recv  = ny0;
-    const integer left_send  = ny0+HALO;
+    boundary_t boundary, *saved = NULL;
 
-    const integer right_recv = nyf-HALO;
-    const integer right_send = nyf-2*HALO;
-
-    if ( rank != 0 )
+    if ( strips )
     {
-        // [RANK-1] <---> [RANK] communication
-        EXCHANGE( &s.tl.zz[left_send], &s.tl.zz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.tl.xz[left_send], &s.tl.xz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.tl.yz[left_send], &s.tl.yz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.tl.xx[left_send], &s.tl.xx[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.tl.xy[left_send], &s.tl.xy[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.tl.yy[left_send], &s.tl.yy[left_recv], rank-1, rank, nelems );
-
-        EXCHANGE( &s.tr.zz[left_send], &s.tr.zz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.tr.xz[left_send], &s.tr.xz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.tr.yz[left_send], &s.tr.yz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.tr.xx[left_send], &s.tr.xx[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.tr.xy[left_send], &s.tr.xy[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.tr.yy[left_send], &s.tr.yy[left_recv], rank-1, rank, nelems );
-
-        EXCHANGE( &s.bl.zz[left_send], &s.bl.zz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.bl.xz[left_send], &s.bl.xz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.bl.yz[left_send], &s.bl.yz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.bl.xx[left_send], &s.bl.xx[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.bl.xy[left_send], &s.bl.xy[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.bl.yy[left_send], &s.bl.yy[left_recv], rank-1, rank, nelems );
-
-        EXCHANGE( &s.br.zz[left_send], &s.br.zz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.br.xz[left_send], &s.br.xz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.br.yz[left_send], &s.br.yz[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.br.xx[left_send], &s.br.xx[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.br.xy[left_send], &s.br.xy[left_recv], rank-1, rank, nelems );
-        EXCHANGE( &s.br.yy[left_send], &s.br.yy[left_recv], rank-1, rank, nelems );
+        boundary_setup( &boundary, domain, VELOCITY_FIELDS + STRESS_FIELDS, timesteps );
+        saved = &boundary;
+
+        print_info("Boundary saving: %lf GB of strips instead of %d snapshots (%lf GB)",
+                   TOGB( (size_t) timesteps * boundary.nfields * boundary.ncells * sizeof(real) ),
+                   nsteps, TOGB( (size_t) nsteps * ncells * VELOCITY_FIELDS * sizeof(real) ));
     }
+    else
+        print_info("Random boundary: the final forward state is run back in time instead of reading %d snapshots (%lf GB)",
+                   nsteps, TOGB( (size_t) nsteps * ncells * VELOCITY_FIELDS * sizeof(real) ));
 
-    if ( rank != nranks-1 )
+    /* the forward wavefield lives apart from the backward one, in 'forward' */
+    real *forward = (real*) __malloc( ALIGN_REAL, cells * sizeof(real) );
+
+    v_t fv;
+    s_t fs;
+    wavefield_views( forward, ncells, &fv, &fs );
+
+    real *src[VELOCITY_FIELDS + STRESS_FIELDS], *dst[VELOCITY_FIELDS + STRESS_FIELDS];
+    velocity_field_list( &v,  src );
+    stress_field_list  ( &s,  src + VELOCITY_FIELDS );
+    velocity_field_list( &fv, dst );
+    stress_field_list  ( &fs, dst + VELOCITY_FIELDS );
+
+    for (int f = 0; f < VELOCITY_FIELDS + STRESS_FIELDS; f++)
+        memcpy( dst[f], src[f], ncells * sizeof(real) );
+
+    /* the backward propagation correlates its velocities with the forward ones */
+    imaging_t imaging;
+    imaging_setup( &imaging, VELOCITY_FIELDS, ncells, stacki * dt, gradient, precond, dst );
+
+    double start_t = dtime();
+
+    propagate_shot( FORWARD, fv, fs, coeffs, rho,
+                    timesteps, ntbwd,
+                    dt, dzi, dxi, dyi,
+                    nz0, nzf, nx0, nxf, ny0, nyf,
+                    stacki, NULL, NULL, domain, NULL, saved, NULL, NULL );
+
+    const double tforward = dtime() - start_t;
+    double treconstruct = 0.0, tbackward = 0.0;
+
+    /* from the final state back to the beginning of the last interval */
+    start_t = dtime();
+
+    propagate_shot( RECONSTRUCT, fv, fs, coeffs, rho,
+                    last, ntbwd,
+                    dt, dzi, dxi, dyi,
+                    nz0, nzf, nx0, nxf, ny0, nyf,
+                    stacki, NULL, NULL, domain, NULL, saved, NULL, NULL );
+
+    treconstruct += dtime() - start_t;
+
+    for (int interval = 0; interval < nsteps; interval++)
     {
-        //                [RANK] <---> [RANK+1] communication
-        EXCHANGE( &s.tl.zz[right_send], &s.tl.zz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.tl.xz[right_send], &s.tl.xz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.tl.yz[right_send], &s.tl.yz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.tl.xx[right_send], &s.tl.xx[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.tl.xy[right_send], &s.tl.xy[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.tl.yy[right_send], &s.tl.yy[right_recv], rank+1, rank, nelems );
-
-        EXCHANGE( &s.tr.zz[right_send], &s.tr.zz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.tr.xz[right_send], &s.tr.xz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.tr.yz[right_send], &s.tr.yz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.tr.xx[right_send], &s.tr.xx[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.tr.xy[right_send], &s.tr.xy[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.tr.yy[right_send], &s.tr.yy[right_recv], rank+1, rank, nelems );
-
-        EXCHANGE( &s.bl.zz[right_send], &s.bl.zz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.bl.xz[right_send], &s.bl.xz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.bl.yz[right_send], &s.bl.yz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.bl.xx[right_send], &s.bl.xx[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.bl.xy[right_send], &s.bl.xy[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.bl.yy[right_send], &s.bl.yy[right_recv], rank+1, rank, nelems );
-
-        EXCHANGE( &s.br.zz[right_send], &s.br.zz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.br.xz[right_send], &s.br.xz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.br.yz[right_send], &s.br.yz[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.br.xx[right_send], &s.br.xx[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.br.xy[right_send], &s.br.xy[right_recv], rank+1, rank, nelems );
-        EXCHANGE( &s.br.yy[right_send], &s.br.yy[right_recv], rank+1, rank, nelems );
+        const int steps = ( interval < nsteps - 1 ) ? stacki : last;
+
+        /* the forward velocities take the place of the snapshot reads */
+        start_t = dtime();
+
+        propagate_shot( BACKWARD, v, s, coeffs, rho,
+                        steps, ntbwd,
+                        dt, dzi, dxi, dyi,
+                        nz0, nzf, nx0, nxf, ny0, nyf,
+                        stacki, NULL, NULL, domain, NULL, NULL, NULL, &imaging );
+
+        tbackward += dtime() - start_t;
+
+        if ( interval == nsteps - 1 ) break;
+
+        start_t = dtime();
+
+        propagate_shot( RECONSTRUCT, fv, fs, coeffs, rho,
+                        stacki, ntbwd,
+                        dt, dzi, dxi, dyi,
+                        nz0, nzf, nx0, nxf, ny0, nyf,
+                        stacki, NULL, NULL, domain, NULL, saved, NULL, NULL );
+
+        treconstruct += dtime() - start_t;
     }
 
+    print_stats("%s: forward propagation took %lf seconds, reconstruction %lf seconds, backward propagation %lf seconds",
+                mode, tforward, treconstruct, tbackward);
+
+    __free( forward );
+    if ( strips ) boundary_release( &boundary );
+    imaging_release( &imaging );
+
     POP_RANGE
 };
-#endif /* end of pragma USE_MPI */
 
+void dft_shot ( v_t             v,
+                s_t             s,
+                coeff_t         coeffs,
+                real           *rho,
+                int             timesteps,
+                int             ntbwd,
+                real            dt,
+                real            dzi,
+                real            dxi,
+                real            dyi,
+                integer         nz0,
+                integer         nzf,
+                integer         nx0,
+                integer         nxf,
+                integer         ny0,
+                integer         nyf,
+                integer         stacki,
+                const int       nfreqs,
+                const real      waveletFreq,
+                real           *gradient,
+                real           *precond,
+                const domain_t *domain)
+{
+    PUSH_RANGE
+
+    const integer ncells = domain_local_cells( domain );
+    const int     nsteps = (timesteps + stacki - 1) / stacki;
+
+    print_info("Frequency domain imaging: %d frequencies (%lf GB) instead of %d snapshots (%lf GB)",
+               nfreqs, TOGB( (size_t) 4 * nfreqs * ncells * VELOCITY_FIELDS * sizeof(real) ),
+               nsteps, TOGB( (size_t) nsteps * ncells * VELOCITY_FIELDS * sizeof(real) ));
+
+    dft_t forward, backward;
+    dft_setup( &forward,  nfreqs, waveletFreq, stacki * dt, VELOCITY_FIELDS, ncells );
+    dft_setup( &backward, nfreqs, waveletFreq, stacki * dt, VELOCITY_FIELDS, ncells );
+
+    double start_t = dtime();
+
+    propagate_shot( FORWARD, v, s, coeffs, rho,
+                    timesteps, ntbwd,
+                    dt, dzi, dxi, dyi,
+                    nz0, nzf, nx0, nxf, ny0, nyf,
+                    stacki, NULL, NULL, domain, NULL, NULL, &forward, NULL );
+
+    const double tforward = dtime() - start_t;
+
+    /* the backward propagation starts over from the initial wavefield */
+    load_initial_wavefield( waveletFreq, domain, &s, &v );
+
+    start_t = dtime();
+
+    propagate_shot( BACKWARD, v, s, coeffs, rho,
+                    timesteps, ntbwd,
+                    dt, dzi, dxi, dyi,
+                    nz0, nzf, nx0, nxf, ny0, nyf,
+                    stacki, NULL, NULL, domain, NULL, NULL, &backward, NULL );
+
+    const double tbackward = dtime() - start_t;
+
+    start_t = dtime();
+
+    dft_image( &forward, &backward, gradient, precond );
+
+    print_stats("Frequency domain imaging: forward propagation took %lf seconds, backward propagation %lf seconds, imaging condition %lf seconds",
+                tforward, tbackward, dtime() - start_t);
+
+    dft_release( &forward );
+    dft_release( &backward );
+
+    POP_RANGE
+};
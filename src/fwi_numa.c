@@ -0,0 +1,442 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+#include "fwi/fwi_numa.h"
+
+#include <dirent.h>
+
+/*
+ * Every sub-domain is processed by one thread of an outer team spread over
+ * the places (OMP_PLACES=numa_domains or sockets), which then forks its own
+ * nested team (OMP_PROC_BIND=spread,close) for the kernels.
+ */
+static inline void numa_enter_team( const numa_domain_t *dom )
+{
+#if defined(_OPENMP)
+    omp_set_num_threads( dom->nthreads );
+#endif
+};
+
+/*
+ * Copies nplanes consecutive y-planes. When called from inside a domain
+ * team, destination pages are first-touched by the threads of that team.
+ */
+static void copy_planes (       real* restrict dst,
+                          const real* restrict src,
+                          const integer        nplanes,
+                          const integer        plane_size )
+{
+#if defined(_OPENMP)
+    #pragma omp parallel for
+#endif
+    for (integer p = 0; p < nplanes; p++)
+        memcpy( dst + p * plane_size, src + p * plane_size, plane_size * sizeof(real) );
+};
+
+static integer count_numa_nodes( void )
+{
+    integer nodes = 0;
+    DIR *dir = opendir("/sys/devices/system/node");
+
+    if ( dir == NULL )
+        return 1;
+
+    struct dirent *entry;
+    while ( (entry = readdir(dir)) != NULL )
+    {
+        if ( strncmp(entry->d_name, "node", 4) == 0 &&
+             entry->d_name[4] >= '0' && entry->d_name[4] <= '9' )
+            nodes++;
+    }
+    closedir(dir);
+
+    return (nodes > 0) ? nodes : 1;
+};
+
+/*
+ * FWI_NUMA_DOMAINS = 0 (or unset) disables the decomposition,
+ *                  > 0 requests that many sub-domains,
+ *                  < 0 requests one sub-domain per NUMA node of the host.
+ */
+integer numa_get_num_domains( void )
+{
+    const int requested = parse_env("FWI_NUMA_DOMAINS");
+
+    integer ndomains = 1;
+
+    if ( requested > 0 ) ndomains = requested;
+    if ( requested < 0 ) ndomains = count_numa_nodes();
+
+#if defined(USE_MPI)
+    if ( ndomains > 1 )
+    {
+        print_info("NUMA sub-domains are not combined with MPI halo exchanges, "
+                   "run one MPI rank per NUMA node instead");
+        ndomains = 1;
+    }
+#endif
+
+    return ndomains;
+};
+
+numa_t* numa_setup ( v_t           v,
+                     s_t           s,
+                     coeff_t       coeffs,
+                     real         *rho,
+                     const integer ny0,
+                     const integer nyf,
+                     const integer dimmz,
+                     const integer dimmx,
+                     const integer ndomains )
+{
+    if ( ndomains < 2 )
+        return NULL;
+
+    /* every sub-domain must own at least HALO planes to feed its neighbours */
+    const integer interior = (nyf - ny0) - 2*HALO;
+    integer n = ndomains;
+    while ( n > 1 && (interior / n) < HALO ) n--;
+
+    if ( n < 2 ) {
+        print_info("Domain too small (" I " planes) for a NUMA decomposition", interior);
+        return NULL;
+    }
+
+    PUSH_RANGE
+
+    const integer planesPerDomain = interior / n;
+    const integer planesRemaining = interior % n;
+    const integer plane_size      = dimmz * dimmx;
+
+#if defined(_OPENMP)
+    const integer nthreads = omp_get_max_threads();
+    omp_set_max_active_levels(2);
+#else
+    const integer nthreads = 1;
+#endif
+
+    numa_t *numa  = (numa_t*) __malloc( ALIGN_INT, sizeof(numa_t) );
+    numa->ndomains = n;
+    numa->dimmz    = dimmz;
+    numa->dimmx    = dimmx;
+    numa->thalo    = 0.0;
+    numa->domains  = (numa_domain_t*) __malloc( ALIGN_INT, n * sizeof(numa_domain_t) );
+
+    for (integer d = 0; d < n; d++)
+    {
+        numa_domain_t *dom = &numa->domains[d];
+
+        dom->y0       = ny0 + d * planesPerDomain;
+        dom->nplanes  = planesPerDomain + 2*HALO + ((d == n-1) ? planesRemaining : 0);
+        dom->nthreads = max_int( nthreads / n, 1 );
+
+        /* pages are not touched here, but by the team copying the fields below */
+        alloc_memory_shot( dom->nplanes * plane_size, &dom->c, &dom->s, &dom->v, &dom->rho );
+
+        print_stats("NUMA sub-domain " I " planes [" I "," I ") with " I " threads",
+                    d, dom->y0, dom->y0 + dom->nplanes, dom->nthreads);
+    }
+
+#if defined(_OPENMP)
+    #pragma omp parallel for num_threads(numa->ndomains) proc_bind(spread) schedule(static,1)
+#endif
+    for (integer d = 0; d < numa->ndomains; d++)
+    {
+        numa_domain_t *dom = &numa->domains[d];
+        numa_enter_team( dom );
+
+        const integer offset = dom->y0 * plane_size;
+
+        real *gc[COEFF_FIELDS],    *lc[COEFF_FIELDS];
+        real *gv[VELOCITY_FIELDS], *lv[VELOCITY_FIELDS];
+        real *gs[STRESS_FIELDS],   *ls[STRESS_FIELDS];
+
+        coeff_field_list   ( &coeffs, gc ); coeff_field_list   ( &dom->c, lc );
+        velocity_field_list( &v,      gv ); velocity_field_list( &dom->v, lv );
+        stress_field_list  ( &s,      gs ); stress_field_list  ( &dom->s, ls );
+
+        for (int f = 0; f < COEFF_FIELDS; f++)
+            copy_planes( lc[f], gc[f] + offset, dom->nplanes, plane_size );
+
+        for (int f = 0; f < VELOCITY_FIELDS; f++)
+            copy_planes( lv[f], gv[f] + offset, dom->nplanes, plane_size );
+
+        for (int f = 0; f < STRESS_FIELDS; f++)
+            copy_planes( ls[f], gs[f] + offset, dom->nplanes, plane_size );
+
+        copy_planes( dom->rho, rho + offset, dom->nplanes, plane_size );
+    }
+
+    POP_RANGE
+
+    return numa;
+};
+
+void numa_release ( numa_t *numa )
+{
+    if ( numa == NULL )
+        return;
+
+    print_stats("NUMA halo copies took %lf seconds", numa->thalo);
+
+    for (integer d = 0; d < numa->ndomains; d++)
+    {
+        numa_domain_t *dom = &numa->domains[d];
+        free_memory_shot( &dom->c, &dom->s, &dom->v, &dom->rho );
+    }
+
+    __free( numa->domains );
+    __free( numa );
+};
+
+void numa_scatter_velocity ( numa_t *numa, v_t v )
+{
+    const integer plane_size = numa->dimmz * numa->dimmx;
+
+#if defined(_OPENMP)
+    #pragma omp parallel for num_threads(numa->ndomains) proc_bind(spread) schedule(static,1)
+#endif
+    for (integer d = 0; d < numa->ndomains; d++)
+    {
+        numa_domain_t *dom = &numa->domains[d];
+        numa_enter_team( dom );
+
+        real *gv[VELOCITY_FIELDS], *lv[VELOCITY_FIELDS];
+        velocity_field_list( &v,      gv );
+        velocity_field_list( &dom->v, lv );
+
+        for (int f = 0; f < VELOCITY_FIELDS; f++)
+            copy_planes( lv[f], gv[f] + dom->y0 * plane_size, dom->nplanes, plane_size );
+    }
+};
+
+/*
+ * Only the planes owned by each sub-domain are copied back, ghost planes
+ * of the process domain are left untouched.
+ */
+void numa_gather_velocity ( numa_t *numa, v_t v )
+{
+    const integer plane_size = numa->dimmz * numa->dimmx;
+
+#if defined(_OPENMP)
+    #pragma omp parallel for num_threads(numa->ndomains) proc_bind(spread) schedule(static,1)
+#endif
+    for (integer d = 0; d < numa->ndomains; d++)
+    {
+        numa_domain_t *dom = &numa->domains[d];
+        numa_enter_team( dom );
+
+        real *gv[VELOCITY_FIELDS], *lv[VELOCITY_FIELDS];
+        velocity_field_list( &v,      gv );
+        velocity_field_list( &dom->v, lv );
+
+        for (int f = 0; f < VELOCITY_FIELDS; f++)
+            copy_planes( gv[f] + (dom->y0 + HALO) * plane_size,
+                         lv[f] + HALO * plane_size,
+                         dom->nplanes - 2*HALO, plane_size );
+    }
+};
+
+void numa_gather_stress ( numa_t *numa, s_t s )
+{
+    const integer plane_size = numa->dimmz * numa->dimmx;
+
+#if defined(_OPENMP)
+    #pragma omp parallel for num_threads(numa->ndomains) proc_bind(spread) schedule(static,1)
+#endif
+    for (integer d = 0; d < numa->ndomains; d++)
+    {
+        numa_domain_t *dom = &numa->domains[d];
+        numa_enter_team( dom );
+
+        real *gs[STRESS_FIELDS], *ls[STRESS_FIELDS];
+        stress_field_list( &s,      gs );
+        stress_field_list( &dom->s, ls );
+
+        for (int f = 0; f < STRESS_FIELDS; f++)
+            copy_planes( gs[f] + (dom->y0 + HALO) * plane_size,
+                         ls[f] + HALO * plane_size,
+                         dom->nplanes - 2*HALO, plane_size );
+    }
+};
+
+void numa_velocity_propagator ( numa_t       *numa,
+                                const real    dt,
+                                const real    dzi,
+                                const real    dxi,
+                                const real    dyi,
+                                const integer nz0,
+                                const integer nzf,
+                                const integer nx0,
+                                const integer nxf )
+{
+    PUSH_RANGE
+
+#if defined(_OPENMP)
+    #pragma omp parallel for num_threads(numa->ndomains) proc_bind(spread) schedule(static,1)
+#endif
+    for (integer d = 0; d < numa->ndomains; d++)
+    {
+        numa_domain_t *dom = &numa->domains[d];
+        numa_enter_team( dom );
+
+        velocity_propagator( dom->v, dom->s, dom->c, dom->rho, dt, dzi, dxi, dyi,
+                             nz0, nzf, nx0, nxf,
+                             HALO, dom->nplanes - HALO,
+                             numa->dimmz, numa->dimmx,
+                             TWO );
+    }
+
+    POP_RANGE
+};
+
+void numa_stress_propagator ( numa_t       *numa,
+                              const real    dt,
+                              const real    dzi,
+                              const real    dxi,
+                              const real    dyi,
+                              const integer nz0,
+                              const integer nzf,
+                              const integer nx0,
+                              const integer nxf )
+{
+    PUSH_RANGE
+
+#if defined(_OPENMP)
+    #pragma omp parallel for num_threads(numa->ndomains) proc_bind(spread) schedule(static,1)
+#endif
+    for (integer d = 0; d < numa->ndomains; d++)
+    {
+        numa_domain_t *dom = &numa->domains[d];
+        numa_enter_team( dom );
+
+        stress_propagator( dom->s, dom->v, dom->c, dom->rho, dt, dzi, dxi, dyi,
+                           nz0, nzf, nx0, nxf,
+                           HALO, dom->nplanes - HALO,
+                           numa->dimmz, numa->dimmx,
+                           TWO );
+    }
+
+    POP_RANGE
+};
+
+/*
+ * Each sub-domain pulls its ghost planes from its neighbours: one bulk
+ * remote read per field and side, local pages are the only ones written.
+ */
+static void pull_halo_planes ( numa_t        *numa,
+                               const integer  d,
+                               real         **mine,
+                               real         **left,
+                               real         **right,
+                               const int      nfields )
+{
+    const integer plane_size = numa->dimmz * numa->dimmx;
+    const numa_domain_t *dom = &numa->domains[d];
+
+    if ( left != NULL )
+    {
+        const numa_domain_t *ldom = &numa->domains[d-1];
+
+        for (int f = 0; f < nfields; f++)
+            copy_planes( mine[f],
+                         left[f] + (ldom->nplanes - 2*HALO) * plane_size,
+                         HALO, plane_size );
+    }
+
+    if ( right != NULL )
+    {
+        for (int f = 0; f < nfields; f++)
+            copy_planes( mine[f]  + (dom->nplanes - HALO) * plane_size,
+                         right[f] + HALO * plane_size,
+                         HALO, plane_size );
+    }
+};
+
+void numa_exchange_velocity_halos ( numa_t *numa )
+{
+    PUSH_RANGE
+
+    const double tstart = dtime();
+
+#if defined(_OPENMP)
+    #pragma omp parallel for num_threads(numa->ndomains) proc_bind(spread) schedule(static,1)
+#endif
+    for (integer d = 0; d < numa->ndomains; d++)
+    {
+        numa_domain_t *dom = &numa->domains[d];
+        numa_enter_team( dom );
+
+        real *mine[VELOCITY_FIELDS], *left[VELOCITY_FIELDS], *right[VELOCITY_FIELDS];
+
+        velocity_field_list( &dom->v, mine );
+        if ( d > 0                ) velocity_field_list( &numa->domains[d-1].v, left  );
+        if ( d < numa->ndomains-1 ) velocity_field_list( &numa->domains[d+1].v, right );
+
+        pull_halo_planes( numa, d, mine,
+                          (d > 0)                ? left  : NULL,
+                          (d < numa->ndomains-1) ? right : NULL,
+                          VELOCITY_FIELDS );
+    }
+
+    numa->thalo += dtime() - tstart;
+
+    POP_RANGE
+};
+
+void numa_exchange_stress_halos ( numa_t *numa )
+{
+    PUSH_RANGE
+
+    const double tstart = dtime();
+
+#if defined(_OPENMP)
+    #pragma omp parallel for num_threads(numa->ndomains) proc_bind(spread) schedule(static,1)
+#endif
+    for (integer d = 0; d < numa->ndomains; d++)
+    {
+        numa_domain_t *dom = &numa->domains[d];
+        numa_enter_team( dom );
+
+        real *mine[STRESS_FIELDS], *left[STRESS_FIELDS], *right[STRESS_FIELDS];
+
+        stress_field_list( &dom->s, mine );
+        if ( d > 0                ) stress_field_list( &numa->domains[d-1].s, left  );
+        if ( d < numa->ndomains-1 ) stress_field_list( &numa->domains[d+1].s, right );
+
+        pull_halo_planes( numa, d, mine,
+                          (d > 0)                ? left  : NULL,
+                          (d < numa->ndomains-1) ? right : NULL,
+                          STRESS_FIELDS );
+    }
+
+    numa->thalo += dtime() - tstart;
+
+    POP_RANGE
+};
@@ -28,6 +28,7 @@
  */
 
 #include "fwi/fwi_propagator.h"
+#include "fwi/fwi_domain.h"
 
 inline
 integer IDX (const integer z,
@@ -365,6 +366,37 @@ void velocity_propagator(v_t           v,
     }
 };
 
+static stencil_read_t* vcell_reads ( stencil_read_t*   reads,
+                                     const real*       szptr,
+                                     const real*       sxptr,
+                                     const real*       syptr,
+                                     const offset_t    _SZ,
+                                     const offset_t    _SX,
+                                     const offset_t    _SY)
+{
+    reads[0] = (stencil_read_t) { szptr, AXIS_Z, _SZ };
+    reads[1] = (stencil_read_t) { sxptr, AXIS_X, _SX };
+    reads[2] = (stencil_read_t) { syptr, AXIS_Y, _SY };
+    return reads + 3;
+};
+
+/* same fields and offsets as the calls of velocity_propagator */
+void velocity_propagator_reads ( s_t s, stencil_read_t reads[PROPAGATOR_STENCIL_READS] )
+{
+    reads = vcell_reads (reads, s.bl.zz, s.tr.xz, s.tl.yz, back_offset, back_offset, forw_offset);
+    reads = vcell_reads (reads, s.br.zz, s.tl.xz, s.tr.yz, back_offset, forw_offset, back_offset);
+    reads = vcell_reads (reads, s.tl.zz, s.br.xz, s.bl.yz, forw_offset, back_offset, back_offset);
+    reads = vcell_reads (reads, s.tr.zz, s.bl.xz, s.br.yz, forw_offset, forw_offset, forw_offset);
+    reads = vcell_reads (reads, s.bl.xz, s.tr.xx, s.tl.xy, back_offset, back_offset, forw_offset);
+    reads = vcell_reads (reads, s.br.xz, s.tl.xx, s.tr.xy, back_offset, forw_offset, back_offset);
+    reads = vcell_reads (reads, s.tl.xz, s.br.xx, s.bl.xy, forw_offset, back_offset, back_offset);
+    reads = vcell_reads (reads, s.tr.xz, s.bl.xx, s.br.xy, forw_offset, forw_offset, forw_offset);
+    reads = vcell_reads (reads, s.bl.yz, s.tr.xy, s.tl.yy, back_offset, back_offset, forw_offset);
+    reads = vcell_reads (reads, s.br.yz, s.tl.xy, s.tr.yy, back_offset, forw_offset, back_offset);
+    reads = vcell_reads (reads, s.tl.yz, s.br.xy, s.bl.yy, forw_offset, back_offset, back_offset);
+    reads = vcell_reads (reads, s.tr.yz, s.bl.xy, s.br.yy, forw_offset, forw_offset, forw_offset);
+};
+
 
 
 
@@ -440,6 +472,35 @@ void stress_propagator(s_t           s,
     }
 };
 
+static stencil_read_t* scell_reads ( stencil_read_t*   reads,
+                                     const point_v_t   vnode_z,
+                                     const point_v_t   vnode_x,
+                                     const point_v_t   vnode_y,
+                                     const offset_t    _SZ,
+                                     const offset_t    _SX,
+                                     const offset_t    _SY)
+{
+    reads[0] = (stencil_read_t) { vnode_x.u, AXIS_X, _SX };
+    reads[1] = (stencil_read_t) { vnode_x.v, AXIS_X, _SX };
+    reads[2] = (stencil_read_t) { vnode_x.w, AXIS_X, _SX };
+    reads[3] = (stencil_read_t) { vnode_y.u, AXIS_Y, _SY };
+    reads[4] = (stencil_read_t) { vnode_y.v, AXIS_Y, _SY };
+    reads[5] = (stencil_read_t) { vnode_y.w, AXIS_Y, _SY };
+    reads[6] = (stencil_read_t) { vnode_z.u, AXIS_Z, _SZ };
+    reads[7] = (stencil_read_t) { vnode_z.v, AXIS_Z, _SZ };
+    reads[8] = (stencil_read_t) { vnode_z.w, AXIS_Z, _SZ };
+    return reads + 9;
+};
+
+/* same fields and offsets as the calls of stress_propagator */
+void stress_propagator_reads ( v_t v, stencil_read_t reads[PROPAGATOR_STENCIL_READS] )
+{
+    reads = scell_reads (reads, v.tr, v.bl, v.br, forw_offset, back_offset, back_offset);
+    reads = scell_reads (reads, v.tl, v.br, v.bl, forw_offset, back_offset, forw_offset);
+    reads = scell_reads (reads, v.br, v.tl, v.tr, back_offset, forw_offset, forw_offset);
+    reads = scell_reads (reads, v.bl, v.tr, v.tl, back_offset, back_offset, back_offset);
+};
+
 real cell_coeff_BR ( const real* restrict ptr,
                      const integer z,
                      const integer x,
@@ -0,0 +1,172 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#include "fwi/fwi_revolve.h"
+
+#include <limits.h>
+
+/* intervals reversible with 's' free slots computing each one 'r' times at most: C(s+r+1, s+1) */
+static int reversible ( const int s,
+                        const int r )
+{
+    double intervals = 1.0;
+
+    for (int i = 1; i <= s + 1; i++)
+        intervals = intervals * (r + i) / i;
+
+    return ( intervals > INT_MAX ) ? INT_MAX : (int) (intervals + 0.5);
+};
+
+static void append ( revolve_t           *r,
+                     const revolve_kind_t kind,
+                     const int            from,
+                     const int            to,
+                     const int            slot )
+{
+    if ( r->nactions == r->maxactions )
+    {
+        revolve_action_t *actions = (revolve_action_t*) __malloc( ALIGN_INT, 2 * r->maxactions * sizeof(revolve_action_t) );
+        memcpy( actions, r->actions, r->nactions * sizeof(revolve_action_t) );
+        __free( r->actions );
+
+        r->actions     = actions;
+        r->maxactions *= 2;
+    }
+
+    revolve_action_t *action = &r->actions[ r->nactions++ ];
+    action->kind = kind;
+    action->from = from;
+    action->to   = to;
+    action->slot = slot;
+};
+
+/*
+ * Reverses the forward states a .. a+n-1. The forward state holds 'a', which
+ * is also kept in 'slot'; the next 's' slots are free.
+ */
+static void reverse ( revolve_t *r,
+                      const int  a,
+                      const int  n,
+                      const int  s,
+                      const int  slot )
+{
+    if ( n == 1 )
+    {
+        append( r, REVOLVE_REVERSE, a, a, -1 );
+        return;
+    }
+
+    /* no room left: every state is recomputed from 'a' */
+    if ( s == 0 )
+    {
+        for (int i = a + n - 1; i >= a; i--)
+        {
+            if ( i < a + n - 1 ) append( r, REVOLVE_RESTORE, a, a, slot );
+            if ( i > a         ) append( r, REVOLVE_ADVANCE, a, i, -1 );
+            append( r, REVOLVE_REVERSE, i, i, -1 );
+        }
+        return;
+    }
+
+    /*
+     * The intervals before the split are computed once more than the ones
+     * after it, which have a slot less: with the fewest repetitions 'rep'
+     * that reverse n states, the first part takes at most reversible(s, rep-1)
+     * of them and the second part at most reversible(s-1, rep). The first
+     * part is as short as that and reversible(s, rep-2) allow, which gives
+     * the fewest recomputed intervals.
+     */
+    int rep = 0;
+    while ( reversible( s, rep ) < n ) rep++;
+
+    int m = n - reversible( s - 1, rep );
+    if ( rep >= 2 && m < reversible( s, rep - 2 ) ) m = reversible( s, rep - 2 );
+    if ( m < 1     ) m = 1;
+    if ( m > n - 1 ) m = n - 1;
+
+    append( r, REVOLVE_ADVANCE, a, a + m, -1 );
+
+    /* the last state is not restored again */
+    if ( n - m > 1 ) append( r, REVOLVE_TAKESHOT, a + m, a + m, slot + 1 );
+
+    reverse( r, a + m, n - m, s - 1, slot + 1 );
+
+    append( r, REVOLVE_RESTORE, a, a, slot );
+    reverse( r, a, m, s, slot );
+};
+
+void revolve_setup ( revolve_t *r,
+                     const int  nsteps,
+                     const int  nslots )
+{
+    r->nsteps     = nsteps;
+    r->nslots     = nslots;
+    r->nactions   = 0;
+    r->maxactions = 64;
+    r->actions    = (revolve_action_t*) __malloc( ALIGN_INT, r->maxactions * sizeof(revolve_action_t) );
+
+    if ( nslots < 1 )
+    {
+        print_error("Checkpointing needs at least the slot of the initial state");
+        abort();
+    }
+
+    if ( nsteps > 1 ) append( r, REVOLVE_TAKESHOT, 0, 0, 0 );
+    reverse( r, 0, nsteps, nslots - 1, 0 );
+
+    /* how many times every interval is computed */
+    int *computed = (int*) __malloc( ALIGN_INT, (nsteps + 1) * sizeof(int) );
+    memset( computed, 0, (nsteps + 1) * sizeof(int) );
+
+    r->advances    = 0;
+    r->repetitions = 0;
+
+    for (int i = 0; i < r->nactions; i++)
+    {
+        if ( r->actions[i].kind != REVOLVE_ADVANCE ) continue;
+
+        for (int step = r->actions[i].from; step < r->actions[i].to; step++)
+        {
+            computed[step]++;
+            if ( computed[step] > r->repetitions ) r->repetitions = computed[step];
+        }
+
+        r->advances += r->actions[i].to - r->actions[i].from;
+    }
+
+    __free( computed );
+
+    print_debug("Checkpointing schedule: %d actions, %d intervals computed", r->nactions, r->advances);
+};
+
+void revolve_release ( revolve_t *r )
+{
+    __free( r->actions );
+};
@@ -0,0 +1,180 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+#include "fwi/fwi_sched.h"
+#include "fwi/fwi_domain.h"
+
+void sched_load_geometry ( const char *fname,
+                           int        *nshots,
+                           shot_t    **shots )
+{
+    if ( fname == NULL )
+    {
+        *nshots = 1;
+        *shots  = (shot_t*) __malloc( ALIGN_REAL, sizeof(shot_t) );
+        (*shots)[0].z = (*shots)[0].x = (*shots)[0].y = 0.0;
+        return;
+    }
+
+    FILE *geometry = safe_fopen( fname, "r", __FILE__, __LINE__ );
+
+    /* count the shots, then read them */
+    real z, x, y;
+    int  count = 0;
+
+    while ( fscanf( geometry, "%f %f %f", &z, &x, &y ) == 3 )
+        count++;
+
+    if ( count == 0 )
+    {
+        print_error("No shots found in the geometry file %s", fname);
+        abort();
+    }
+
+    *nshots = count;
+    *shots  = (shot_t*) __malloc( ALIGN_REAL, count * sizeof(shot_t) );
+
+    fseek( geometry, 0, SEEK_SET );
+
+    for (int i = 0; i < count; i++)
+    {
+        if ( fscanf( geometry, "%f %f %f", &(*shots)[i].z, &(*shots)[i].x, &(*shots)[i].y ) != 3 )
+        {
+            print_error("Error while reading the geometry file %s", fname);
+            abort();
+        }
+    }
+
+    fclose( geometry );
+};
+
+void sched_setup ( sched_t *sched, const char *geometry )
+{
+    sched_load_geometry( geometry, &sched->nshots, &sched->shots );
+
+    sched->taken = 0;
+
+#if defined(USE_MPI)
+    int rank, nranks;
+    MPI_Comm_rank( MPI_COMM_WORLD, &rank   );
+    MPI_Comm_size( MPI_COMM_WORLD, &nranks );
+
+    int group_size = parse_env("FWI_GROUP_SIZE");
+    if ( group_size <= 0 ) group_size = nranks;
+
+    if ( nranks % group_size != 0 )
+    {
+        print_error("FWI_GROUP_SIZE=%d does not divide the %d MPI processes", group_size, nranks);
+        abort();
+    }
+
+    sched->group   = rank / group_size;
+    sched->ngroups = nranks / group_size;
+    sched->leader  = ( rank % group_size == 0 );
+
+    MPI_Comm_split( MPI_COMM_WORLD, sched->group, rank, &sched->comm );
+    MPI_Comm_split( MPI_COMM_WORLD, rank % group_size, rank, &sched->cross );
+    domain_set_parent( sched->comm );
+
+    /* the counter lives in rank 0, the rest expose nothing */
+    const MPI_Aint bytes = ( rank == 0 ) ? sizeof(int) : 0;
+    MPI_Win_allocate( bytes, sizeof(int), MPI_INFO_NULL, MPI_COMM_WORLD, &sched->counter, &sched->win );
+
+    if ( rank == 0 ) *sched->counter = 0;
+    MPI_Barrier( MPI_COMM_WORLD );
+#else
+    sched->group   = 0;
+    sched->ngroups = 1;
+    sched->leader  = 1;
+#endif
+
+    print_info("%d shots for %d groups of processes, this process belongs to group %d",
+               sched->nshots, sched->ngroups, sched->group);
+};
+
+void sched_release ( sched_t *sched )
+{
+#if defined(USE_MPI)
+    MPI_Win_free ( &sched->win  );
+    MPI_Comm_free( &sched->comm  );
+    MPI_Comm_free( &sched->cross );
+#endif
+    __free( sched->shots );
+};
+
+int sched_next_shot ( sched_t *sched )
+{
+    int shot;
+
+#if defined(USE_MPI)
+    if ( sched->leader )
+    {
+        const int one = 1;
+
+        MPI_Win_lock( MPI_LOCK_SHARED, 0, 0, sched->win );
+        MPI_Fetch_and_op( &one, &shot, MPI_INT, 0, 0, MPI_SUM, sched->win );
+        MPI_Win_unlock( 0, sched->win );
+    }
+    MPI_Bcast( &shot, 1, MPI_INT, 0, sched->comm );
+#else
+    shot = sched->taken;
+#endif
+
+    if ( shot >= sched->nshots ) return -1;
+
+    sched->taken++;
+
+    print_info("Group %d takes shot %d, source at (z %f, x %f, y %f)", sched->group, shot,
+               sched->shots[shot].z, sched->shots[shot].x, sched->shots[shot].y);
+    return shot;
+};
+
+void sched_end_round ( sched_t *sched )
+{
+    print_stats("Group %d processed %d of %d shots", sched->group, sched->taken, sched->nshots);
+
+#if defined(USE_MPI)
+    int rank;
+    MPI_Comm_rank( MPI_COMM_WORLD, &rank );
+
+    /* nobody fetches from the counter while it is reset */
+    MPI_Barrier( MPI_COMM_WORLD );
+
+    if ( rank == 0 )
+    {
+        MPI_Win_lock( MPI_LOCK_EXCLUSIVE, 0, 0, sched->win );
+        *sched->counter = 0;
+        MPI_Win_unlock( 0, sched->win );
+    }
+
+    MPI_Barrier( MPI_COMM_WORLD );
+#endif
+
+    sched->taken = 0;
+};
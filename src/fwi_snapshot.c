@@ -0,0 +1,782 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#include "fwi/fwi_snapshot.h"
+#include "fwi/fwi_kernel.h"
+
+#include <fcntl.h>
+#include <limits.h>
+
+/* snapshots of the local domain that fit in 'megabytes', in every process */
+static int tier_capacity ( const int       megabytes,
+                           const integer   ncells,
+                           const domain_t *domain )
+{
+    int slots = (int) (((size_t) megabytes * 1024 * 1024) / ((size_t) ncells * sizeof(real) * VELOCITY_FIELDS));
+
+#if defined(USE_MPI)
+    MPI_Allreduce( MPI_IN_PLACE, &slots, 1, MPI_INT, MPI_MIN, domain->comm );
+#else
+    (void) domain;
+#endif
+    return slots;
+};
+
+static void volume_list ( real          *volumes,
+                          const integer  ncells,
+                          real          *fields[VELOCITY_FIELDS] )
+{
+    for (int f = 0; f < VELOCITY_FIELDS; f++)
+        fields[f] = volumes + f * ncells;
+};
+
+static void scratch_name ( const snapshots_t *store,
+                           const int          suffix,
+                           char              *fname )
+{
+    /* the processes of a node share the scratch directory */
+    sprintf( fname, "%s/fwi.%d.snapshot.%05d.bin", store->scratch, (int) getpid(), suffix );
+};
+
+static void write_scratch ( const snapshots_t *store,
+                            const int          suffix,
+                            real              *fields[VELOCITY_FIELDS] )
+{
+    char fname[400];
+    scratch_name( store, suffix, fname );
+
+    const size_t bytes = store->ncells * sizeof(real);
+
+    io_file_t file;
+    io_open( &file, fname, 1, VELOCITY_FIELDS * bytes );
+
+    for (int f = 0; f < VELOCITY_FIELDS; f++)
+        io_write( &file, fields[f], bytes, (int64_t) f * bytes );
+
+    io_close( &file );
+};
+
+static void read_scratch ( const snapshots_t *store,
+                           const int          suffix,
+                           real              *fields[VELOCITY_FIELDS] )
+{
+    char fname[400];
+    scratch_name( store, suffix, fname );
+
+    const size_t bytes = store->ncells * sizeof(real);
+
+    io_file_t file;
+    io_open( &file, fname, 0, 0 );
+    io_sequential( &file );
+
+    for (int f = 0; f < VELOCITY_FIELDS; f++)
+        io_read( &file, fields[f], bytes, (int64_t) f * bytes );
+
+    io_close( &file );
+    unlink( fname );
+};
+
+/* asks the kernel to start reading a scratch file into the page cache */
+static void hint_scratch ( const snapshots_t *store,
+                           const int          suffix )
+{
+    char fname[400];
+    scratch_name( store, suffix, fname );
+
+    const int fd = open( fname, O_RDONLY );
+    if ( fd < 0 ) return;
+
+    posix_fadvise( fd, 0, 0, POSIX_FADV_WILLNEED );
+    close( fd );
+};
+
+/* stores the snapshot in the tier of the entry */
+static void write_tier ( snapshots_t      *store,
+                         snapshot_entry_t *entry,
+                         real             *fields[VELOCITY_FIELDS] )
+{
+    switch ( entry->tier )
+    {
+    case( SNAPSHOT_MEMORY ):
+    {
+        /* a queue buffer is kept as it is, the writer gets a new one */
+        if ( store->donor != NULL && fields[0] == store->donor )
+        {
+            entry->volumes = store->donor;
+            store->donor   = NULL;
+            break;
+        }
+
+        entry->volumes = (real*) __malloc( ALIGN_REAL, store->ncells * sizeof(real) * VELOCITY_FIELDS );
+
+        for (int f = 0; f < VELOCITY_FIELDS; f++)
+            memcpy( entry->volumes + f * store->ncells, fields[f], store->ncells * sizeof(real) );
+        break;
+    }
+    case( SNAPSHOT_SCRATCH ):
+        write_scratch( store, entry->suffix, fields );
+        break;
+    default:
+        write_snapshot( store->folder, entry->suffix, fields, store->domain );
+    }
+
+    store->count [ entry->tier ]++;
+    store->stored[ entry->tier ]++;
+};
+
+static void place ( snapshots_t      *store,
+                    snapshot_entry_t *entry,
+                    real             *fields[VELOCITY_FIELDS],
+                    int               tier );
+
+/* moves a snapshot to 'tier' or below */
+static void demote ( snapshots_t      *store,
+                     snapshot_entry_t *victim,
+                     const int         tier )
+{
+    real *staging = victim->volumes;
+
+    if ( victim->tier == SNAPSHOT_SCRATCH )
+        staging = (real*) __malloc( ALIGN_REAL, store->ncells * sizeof(real) * VELOCITY_FIELDS );
+
+    real *fields[VELOCITY_FIELDS];
+    volume_list( staging, store->ncells, fields );
+
+    if ( victim->tier == SNAPSHOT_SCRATCH )
+        read_scratch( store, victim->suffix, fields );
+
+    print_debug("Snapshot %05d moves from tier %d to tier %d or below", victim->suffix, victim->tier, tier);
+
+    store->count[ victim->tier ]--;
+    victim->volumes = NULL;
+    store->demoted++;
+
+    place( store, victim, fields, tier );
+
+    __free( staging );
+};
+
+/*
+ * Puts the snapshot in the first tier with room, or in the first one holding
+ * a snapshot that is needed later, which goes down a tier.
+ */
+static void place ( snapshots_t      *store,
+                    snapshot_entry_t *entry,
+                    real             *fields[VELOCITY_FIELDS],
+                    int               tier )
+{
+    for ( ; tier < SNAPSHOT_FOLDER; tier++ )
+    {
+        if ( store->capacity[tier] < 0 || store->count[tier] < store->capacity[tier] ) break;
+        if ( store->capacity[tier] == 0 ) continue;
+
+        /* the lowest suffix of the tier is the last one the backward pass reads */
+        snapshot_entry_t *victim = NULL;
+        for (int e = 0; e < store->nentries; e++)
+            if ( store->entries[e].tier == tier && &store->entries[e] != entry &&
+                 ( victim == NULL || store->entries[e].suffix < victim->suffix ) )
+                victim = &store->entries[e];
+
+        if ( victim != NULL && victim->suffix < entry->suffix )
+        {
+            demote( store, victim, tier + 1 );
+            break;
+        }
+    }
+
+    entry->tier = tier;
+    write_tier( store, entry, fields );
+};
+
+/* adds the snapshot to the entries and places it in the tiers */
+static void store_snapshot ( snapshots_t *store,
+                             const int    suffix,
+                             real        *fields[] )
+{
+    if ( store->nentries == store->maxentries )
+    {
+        snapshot_entry_t *entries = (snapshot_entry_t*) __malloc( ALIGN_INT, 2 * store->maxentries * sizeof(snapshot_entry_t) );
+        memcpy( entries, store->entries, store->nentries * sizeof(snapshot_entry_t) );
+        __free( store->entries );
+
+        store->entries     = entries;
+        store->maxentries *= 2;
+    }
+
+    snapshot_entry_t *entry = &store->entries[ store->nentries++ ];
+    entry->suffix  = suffix;
+    entry->volumes = NULL;
+
+    place( store, entry, fields, SNAPSHOT_MEMORY );
+};
+
+/* places the queued snapshots, oldest first */
+static void* writer_thread ( void *arg )
+{
+    snapshots_t *store = (snapshots_t*) arg;
+
+    pthread_mutex_lock( &store->lock );
+
+    for (;;)
+    {
+        while ( store->queued == 0 && !store->stop )
+            pthread_cond_wait( &store->changed, &store->lock );
+
+        if ( store->queued == 0 ) break;
+
+        const int slot = store->head;
+        pthread_mutex_unlock( &store->lock );
+
+        const double start_t = dtime();
+
+        real *fields[VELOCITY_FIELDS];
+        volume_list( store->buffers[slot], store->ncells, fields );
+
+        store->donor = store->buffers[slot];
+        store_snapshot( store, store->suffixes[slot], fields );
+
+        if ( store->donor == NULL )
+            store->buffers[slot] = (real*) __malloc( ALIGN_REAL, store->ncells * sizeof(real) * VELOCITY_FIELDS );
+        store->donor = NULL;
+
+        store->twriter += dtime() - start_t;
+
+        pthread_mutex_lock( &store->lock );
+        store->head = (store->head + 1) % store->depth;
+        store->queued--;
+        pthread_cond_broadcast( &store->changed );
+    }
+
+    pthread_mutex_unlock( &store->lock );
+    return NULL;
+};
+
+/* waits for the writer to place every queued snapshot */
+static void drain ( snapshots_t *store )
+{
+    if ( store->depth == 0 ) return;
+
+    pthread_mutex_lock( &store->lock );
+    while ( store->queued > 0 )
+        pthread_cond_wait( &store->changed, &store->lock );
+    pthread_mutex_unlock( &store->lock );
+};
+
+/* reads the scheduled snapshots into the staging buffers, in order */
+static void* reader_thread ( void *arg )
+{
+    snapshots_t *store = (snapshots_t*) arg;
+
+    pthread_mutex_lock( &store->lock );
+
+    for (;;)
+    {
+        while ( store->loaded == store->scheduled && !store->stop )
+            pthread_cond_wait( &store->changed, &store->lock );
+
+        if ( store->loaded == store->scheduled ) break;
+
+        const int slot = (store->first + store->loaded) % store->ahead;
+        pthread_mutex_unlock( &store->lock );
+
+        const double start_t = dtime();
+
+        real *fields[VELOCITY_FIELDS];
+        volume_list( store->staging[slot], store->ncells, fields );
+
+        if ( store->staged_tier[slot] == SNAPSHOT_SCRATCH )
+            read_scratch( store, store->staged[slot], fields );
+        else
+            read_snapshot( store->folder, store->staged[slot], fields, store->domain );
+
+        store->treader += dtime() - start_t;
+
+        pthread_mutex_lock( &store->lock );
+        store->loaded++;
+        pthread_cond_broadcast( &store->changed );
+    }
+
+    pthread_mutex_unlock( &store->lock );
+    return NULL;
+};
+
+/*
+ * Fills the free staging buffers with the snapshots the backward propagation
+ * reads after 'suffix' (included): the highest suffixes not scheduled yet.
+ * Snapshots in memory need no staging. The one that follows the staged ones
+ * is hinted to the page cache when it is a scratch file.
+ */
+static void schedule_reads ( snapshots_t *store,
+                             const int    suffix )
+{
+    pthread_mutex_lock( &store->lock );
+
+    for (;;)
+    {
+        snapshot_entry_t *next = NULL;
+        for (int e = 0; e < store->nentries; e++)
+        {
+            const snapshot_entry_t *entry = &store->entries[e];
+
+            if ( entry->tier != SNAPSHOT_MEMORY && entry->suffix <= suffix && entry->suffix < store->lowest &&
+                 ( next == NULL || entry->suffix > next->suffix ) )
+                next = &store->entries[e];
+        }
+
+        if ( next == NULL ) break;
+
+        if ( store->scheduled == store->ahead )
+        {
+            if ( next->tier == SNAPSHOT_SCRATCH ) hint_scratch( store, next->suffix );
+            break;
+        }
+
+        const int slot = (store->first + store->scheduled) % store->ahead;
+        store->staged     [slot] = next->suffix;
+        store->staged_tier[slot] = next->tier;
+        store->lowest            = next->suffix;
+        store->scheduled++;
+    }
+
+    pthread_cond_broadcast( &store->changed );
+    pthread_mutex_unlock( &store->lock );
+};
+
+/* copies the snapshot from its staging buffer, 0 when it is not staged */
+static int take_staged ( snapshots_t *store,
+                         const int    suffix,
+                         real        *fields[] )
+{
+    pthread_mutex_lock( &store->lock );
+
+    for (;;)
+    {
+        if ( store->scheduled == 0 || store->staged[ store->first ] < suffix )
+        {
+            pthread_mutex_unlock( &store->lock );
+            return 0;
+        }
+
+        if ( store->loaded == 0 )
+        {
+            const double wait_t = dtime();
+            store->waits++;
+
+            while ( store->loaded == 0 )
+                pthread_cond_wait( &store->changed, &store->lock );
+
+            store->twait += dtime() - wait_t;
+        }
+        else if ( store->staged[ store->first ] == suffix )
+        {
+            store->hits++;
+        }
+
+        if ( store->staged[ store->first ] == suffix ) break;
+
+        /* skipped by the caller, never read again */
+        store->first = (store->first + 1) % store->ahead;
+        store->scheduled--;
+        store->loaded--;
+    }
+
+    const int slot = store->first;
+    pthread_mutex_unlock( &store->lock );
+
+    /* the reader does not touch a loaded buffer */
+    for (int f = 0; f < VELOCITY_FIELDS; f++)
+        memcpy( fields[f], store->staging[slot] + f * store->ncells, store->ncells * sizeof(real) );
+
+    pthread_mutex_lock( &store->lock );
+    store->first = (store->first + 1) % store->ahead;
+    store->scheduled--;
+    store->loaded--;
+    pthread_cond_broadcast( &store->changed );
+    pthread_mutex_unlock( &store->lock );
+
+    return 1;
+};
+
+void snapshots_setup ( snapshots_t    *store,
+                       char           *folder,
+                       const domain_t *domain )
+{
+    store->folder     = folder;
+    store->domain     = domain;
+    store->ncells     = domain_local_cells( domain );
+    store->nentries   = 0;
+    store->maxentries = 16;
+    store->entries    = (snapshot_entry_t*) __malloc( ALIGN_INT, store->maxentries * sizeof(snapshot_entry_t) );
+    store->demoted    = 0;
+    store->tput       = 0.0;
+    store->tget       = 0.0;
+
+    for (int t = 0; t < SNAPSHOT_TIERS; t++)
+    {
+        store->count [t] = 0;
+        store->stored[t] = 0;
+    }
+
+    store->capacity[SNAPSHOT_MEMORY] = tier_capacity( parse_env("FWI_SNAPSHOT_MEMORY"), store->ncells, domain );
+    store->capacity[SNAPSHOT_FOLDER] = -1;
+
+    /* a path, parse_env only reads numbers */
+    const char *scratch = getenv("FWI_SCRATCH_DIR");
+#if defined(DO_NOT_PERFORM_IO)
+    scratch = NULL;
+#endif
+
+    if ( scratch != NULL && scratch[0] != '\0' )
+    {
+        snprintf( store->scratch, sizeof(store->scratch), "%s", scratch );
+
+        const int megabytes = parse_env("FWI_SNAPSHOT_SCRATCH");
+        store->capacity[SNAPSHOT_SCRATCH] = ( megabytes > 0 ) ? tier_capacity( megabytes, store->ncells, domain ) : -1;
+    }
+    else
+    {
+        store->scratch[0] = '\0';
+        store->capacity[SNAPSHOT_SCRATCH] = 0;
+    }
+
+    print_info("Snapshot store: %d snapshots in memory, %d in scratch %s (-1: no limit)",
+               store->capacity[SNAPSHOT_MEMORY], store->capacity[SNAPSHOT_SCRATCH], store->scratch);
+
+    store->depth     = parse_env("FWI_SNAPSHOT_WRITER");
+    store->head      = 0;
+    store->queued    = 0;
+    store->stop      = 0;
+    store->donor     = NULL;
+    store->twriter   = 0.0;
+    store->tstall    = 0.0;
+    store->stalls    = 0;
+    store->maxqueued = 0;
+
+    if ( store->depth < 0 ) store->depth = 0;
+
+    store->ahead     = parse_env("FWI_SNAPSHOT_PREFETCH");
+    store->first     = 0;
+    store->scheduled = 0;
+    store->loaded    = 0;
+    store->lowest    = INT_MAX;
+    store->treader   = 0.0;
+    store->twait     = 0.0;
+    store->hits      = 0;
+    store->waits     = 0;
+
+    if ( store->ahead < 0 ) store->ahead = 0;
+
+#if defined(USE_MPI)
+    /* collective writes from a second thread would race with the halo exchanges */
+    if ( (store->depth > 0 || store->ahead > 0) && parse_env("FWI_SNAPSHOT_IO") == 1 )
+    {
+        print_info("FWI_SNAPSHOT_WRITER and FWI_SNAPSHOT_PREFETCH ignored: MPI-IO snapshots are accessed by every process at once");
+        store->depth = 0;
+        store->ahead = 0;
+    }
+#endif
+
+    if ( store->depth > 0 || store->ahead > 0 )
+    {
+        pthread_mutex_init( &store->lock, NULL );
+        pthread_cond_init ( &store->changed, NULL );
+    }
+
+    if ( store->ahead > 0 )
+    {
+        store->staging     = (real**) __malloc( ALIGN_INT, store->ahead * sizeof(real*) );
+        store->staged      = (int*  ) __malloc( ALIGN_INT, store->ahead * sizeof(int)   );
+        store->staged_tier = (int*  ) __malloc( ALIGN_INT, store->ahead * sizeof(int)   );
+
+        for (int b = 0; b < store->ahead; b++)
+            store->staging[b] = (real*) __malloc( ALIGN_REAL, store->ncells * sizeof(real) * VELOCITY_FIELDS );
+
+        if ( pthread_create( &store->reader, NULL, reader_thread, store ) != 0 )
+        {
+            print_error("Can not start the snapshot reader thread");
+            abort();
+        }
+    }
+
+    if ( store->depth > 0 )
+    {
+        store->buffers  = (real**) __malloc( ALIGN_INT, store->depth * sizeof(real*) );
+        store->suffixes = (int*  ) __malloc( ALIGN_INT, store->depth * sizeof(int)   );
+
+        for (int b = 0; b < store->depth; b++)
+            store->buffers[b] = (real*) __malloc( ALIGN_REAL, store->ncells * sizeof(real) * VELOCITY_FIELDS );
+
+        if ( pthread_create( &store->writer, NULL, writer_thread, store ) != 0 )
+        {
+            print_error("Can not start the snapshot writer thread");
+            abort();
+        }
+    }
+};
+
+void snapshots_release ( snapshots_t *store )
+{
+    if ( store->depth > 0 || store->ahead > 0 )
+    {
+        pthread_mutex_lock( &store->lock );
+        store->stop = 1;
+        pthread_cond_broadcast( &store->changed );
+        pthread_mutex_unlock( &store->lock );
+
+        if ( store->depth > 0 ) pthread_join( store->writer, NULL );
+        if ( store->ahead > 0 ) pthread_join( store->reader, NULL );
+
+        pthread_mutex_destroy( &store->lock );
+        pthread_cond_destroy ( &store->changed );
+    }
+
+    if ( store->ahead > 0 )
+    {
+        const int needed = store->hits + store->waits;
+
+        print_stats("Snapshot prefetch: %d staging buffers, %d of %d snapshots staged in time (%.1lf%% hits), %d waits (%lf seconds)",
+                    store->ahead, store->hits, needed, (needed > 0) ? 100.0 * store->hits / needed : 0.0,
+                    store->waits, store->twait);
+        print_stats("\tReading took %lf seconds in the background", store->treader);
+
+        for (int b = 0; b < store->ahead; b++)
+            __free( store->staging[b] );
+        __free( store->staging     );
+        __free( store->staged      );
+        __free( store->staged_tier );
+    }
+
+    if ( store->depth > 0 )
+    {
+        print_stats("Snapshot writer: %d queue buffers, %d at most in use, %d stalls of the propagation (%lf seconds)",
+                    store->depth, store->maxqueued, store->stalls, store->tstall);
+        print_stats("\tWriting took %lf seconds in the background", store->twriter);
+
+        for (int b = 0; b < store->depth; b++)
+            __free( store->buffers[b] );
+        __free( store->buffers  );
+        __free( store->suffixes );
+    }
+
+    for (int e = 0; e < store->nentries; e++)
+    {
+        snapshot_entry_t *entry = &store->entries[e];
+
+        if ( entry->tier == SNAPSHOT_MEMORY ) __free( entry->volumes );
+        if ( entry->tier == SNAPSHOT_SCRATCH )
+        {
+            char fname[400];
+            scratch_name( store, entry->suffix, fname );
+            unlink( fname );
+        }
+    }
+
+    const int stored = store->stored[SNAPSHOT_MEMORY] + store->stored[SNAPSHOT_SCRATCH] + store->stored[SNAPSHOT_FOLDER];
+    if ( stored > 0 )
+    {
+        print_stats("Snapshots stored: %d in memory, %d in scratch, %d in the output folder, %d moved down a tier",
+                    store->stored[SNAPSHOT_MEMORY], store->stored[SNAPSHOT_SCRATCH],
+                    store->stored[SNAPSHOT_FOLDER], store->demoted);
+        print_stats("\tStoring took %lf seconds, reading back %lf seconds", store->tput, store->tget);
+    }
+
+    __free( store->entries );
+};
+
+void snapshots_put ( snapshots_t *store,
+                     const int    suffix,
+                     real        *fields[] )
+{
+    PUSH_RANGE
+
+    const double start_t = dtime();
+
+    if ( store->depth == 0 )
+    {
+        store_snapshot( store, suffix, fields );
+    }
+    else
+    {
+        pthread_mutex_lock( &store->lock );
+
+        if ( store->queued == store->depth )
+        {
+            const double stall_t = dtime();
+            store->stalls++;
+
+            while ( store->queued == store->depth )
+                pthread_cond_wait( &store->changed, &store->lock );
+
+            store->tstall += dtime() - stall_t;
+        }
+
+        const int slot = (store->head + store->queued) % store->depth;
+        pthread_mutex_unlock( &store->lock );
+
+        /* the writer does not touch a free buffer */
+        for (int f = 0; f < VELOCITY_FIELDS; f++)
+            memcpy( store->buffers[slot] + f * store->ncells, fields[f], store->ncells * sizeof(real) );
+
+        pthread_mutex_lock( &store->lock );
+        store->suffixes[slot] = suffix;
+        store->queued++;
+        if ( store->queued > store->maxqueued ) store->maxqueued = store->queued;
+        pthread_cond_broadcast( &store->changed );
+        pthread_mutex_unlock( &store->lock );
+    }
+
+    store->tput += dtime() - start_t;
+
+    POP_RANGE
+};
+
+void snapshots_get ( snapshots_t *store,
+                     const int    suffix,
+                     real        *fields[] )
+{
+    PUSH_RANGE
+
+    const double start_t = dtime();
+
+    drain( store );
+
+    int e = 0;
+    while ( e < store->nentries && store->entries[e].suffix != suffix ) e++;
+
+    int staged = 0;
+    if ( store->ahead > 0 )
+    {
+        schedule_reads( store, suffix );
+        staged = take_staged( store, suffix, fields );
+    }
+
+    if ( staged )
+    {
+        store->count[ store->entries[e].tier ]--;
+        store->entries[e] = store->entries[ --store->nentries ];
+    }
+    /* not stored by this shot: the folder may still have it */
+    else if ( e == store->nentries )
+    {
+        read_snapshot( store->folder, suffix, fields, store->domain );
+    }
+    else
+    {
+        snapshot_entry_t *entry = &store->entries[e];
+
+        switch ( entry->tier )
+        {
+        case( SNAPSHOT_MEMORY ):
+        {
+            for (int f = 0; f < VELOCITY_FIELDS; f++)
+                memcpy( fields[f], entry->volumes + f * store->ncells, store->ncells * sizeof(real) );
+
+            __free( entry->volumes );
+            break;
+        }
+        case( SNAPSHOT_SCRATCH ):
+            read_scratch( store, suffix, fields );
+            break;
+        default:
+            read_snapshot( store->folder, suffix, fields, store->domain );
+        }
+
+        store->count[ entry->tier ]--;
+        store->entries[e] = store->entries[ --store->nentries ];
+    }
+
+    /* the buffer just released starts loading the next one */
+    if ( store->ahead > 0 ) schedule_reads( store, suffix );
+
+    store->tget += dtime() - start_t;
+
+    POP_RANGE
+};
+
+void snapshots_migrate ( snapshots_t    *store,
+                         const domain_t *to )
+{
+    const integer ncells = domain_local_cells( to );
+
+    drain( store );
+
+    /* every process holds the same snapshots in the same tiers */
+    for (int e = 0; e < store->nentries; e++)
+    {
+        snapshot_entry_t *entry = &store->entries[e];
+        if ( entry->tier == SNAPSHOT_FOLDER ) continue;
+
+        real *from = entry->volumes;
+        if ( entry->tier == SNAPSHOT_SCRATCH )
+            from = (real*) __malloc( ALIGN_REAL, store->ncells * sizeof(real) * VELOCITY_FIELDS );
+
+        real *moved = (real*) __malloc( ALIGN_REAL, ncells * sizeof(real) * VELOCITY_FIELDS );
+
+        real *src[VELOCITY_FIELDS], *dst[VELOCITY_FIELDS];
+        volume_list( from,  store->ncells, src );
+        volume_list( moved, ncells,        dst );
+
+        if ( entry->tier == SNAPSHOT_SCRATCH )
+            read_scratch( store, entry->suffix, src );
+
+        domain_migrate( store->domain, to, src, dst, VELOCITY_FIELDS );
+        __free( from );
+
+        if ( entry->tier == SNAPSHOT_SCRATCH )
+        {
+            /* written with the new local size */
+            const integer old = store->ncells;
+            store->ncells = ncells;
+            write_scratch( store, entry->suffix, dst );
+            store->ncells = old;
+
+            __free( moved );
+            moved = NULL;
+        }
+
+        entry->volumes = moved;
+    }
+
+    store->ncells = ncells;
+
+    /* queue buffers of the new size */
+    for (int b = 0; b < store->depth; b++)
+    {
+        __free( store->buffers[b] );
+        store->buffers[b] = (real*) __malloc( ALIGN_REAL, ncells * sizeof(real) * VELOCITY_FIELDS );
+    }
+
+    /* nothing is staged before the backward propagation starts */
+    for (int b = 0; b < store->ahead; b++)
+    {
+        __free( store->staging[b] );
+        store->staging[b] = (real*) __malloc( ALIGN_REAL, ncells * sizeof(real) * VELOCITY_FIELDS );
+    }
+};
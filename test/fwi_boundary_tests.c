@@ -0,0 +1,120 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#include "test/fwi_tests.h"
+
+#include <unity.h>
+#include <unity_fixture.h>
+
+#include "fwi/fwi_kernel.h"
+
+#define NFIELDS 3
+
+TEST_GROUP(boundary);
+
+TEST_SETUP(boundary)
+{
+    nelems = dimmz * dimmx * dimmy;
+}
+
+TEST_TEAR_DOWN(boundary)
+{
+}
+
+/* next to the outer frame along some axis, where the strips are */
+static int in_strip ( const integer c, const integer dim )
+{
+    return (c >= HALO && c < 2*HALO) || (c >= dim - 2*HALO && c < dim - HALO);
+}
+
+static void fill ( real *fields[NFIELDS], const real step )
+{
+    for (int f = 0; f < NFIELDS; f++)
+        for (integer i = 0; i < nelems; i++)
+            fields[f][i] = step * 1000.f + f * 100.f + (real) (i % 97);
+}
+
+TEST(boundary, save_restore_strips)
+{
+#if defined(USE_MPI)
+    TEST_IGNORE_MESSAGE("domain_setup needs MPI to be initialized");
+#endif
+    domain_t d;
+    domain_setup(&d, dimmz, dimmx, dimmy);
+
+    real *fields[NFIELDS];
+    for (int f = 0; f < NFIELDS; f++)
+        fields[f] = (real*) __malloc( ALIGN_REAL, nelems * sizeof(real) );
+
+    boundary_t b;
+    boundary_setup(&b, &d, NFIELDS, 2);
+
+    /* a single process is at the physical boundary on every face */
+    TEST_ASSERT_EQUAL_INT( NFACES, b.nboxes );
+
+    fill(fields, 1.f); boundary_save(&b, fields);
+    fill(fields, 2.f); boundary_save(&b, fields);
+    TEST_ASSERT_EQUAL_INT( 2, b.steps );
+
+    /* last step first, split as the reconstruction does */
+    for (int step = 2; step >= 1; step--)
+    {
+        for (int f = 0; f < NFIELDS; f++)
+            set_array_to_constant( fields[f], -1.f, nelems );
+
+        boundary_restore(&b, fields, 0, 1);
+        boundary_restore(&b, fields + 1, 1, NFIELDS - 1);
+        boundary_drop(&b);
+
+        for (int f = 0; f < NFIELDS; f++)
+            for (integer y = 0; y < dimmy; y++)
+                for (integer x = 0; x < dimmx; x++)
+                    for (integer z = 0; z < dimmz; z++)
+                    {
+                        const integer i = IDX(z,x,y,dimmz,dimmx);
+                        const real expected = (in_strip(z,dimmz) || in_strip(x,dimmx) || in_strip(y,dimmy))
+                                            ? step * 1000.f + f * 100.f + (real) (i % 97) : -1.f;
+
+                        TEST_ASSERT_EQUAL_FLOAT( expected, fields[f][i] );
+                    }
+    }
+
+    TEST_ASSERT_EQUAL_INT( 0, b.steps );
+
+    boundary_release(&b);
+    for (int f = 0; f < NFIELDS; f++) __free( fields[f] );
+    domain_release(&d);
+}
+
+////// TESTS RUNNER //////
+TEST_GROUP_RUNNER(boundary)
+{
+    RUN_TEST_CASE(boundary, save_restore_strips);
+}
@@ -0,0 +1,224 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#include "test/fwi_tests.h"
+
+#include <unity.h>
+#include <unity_fixture.h>
+
+#include "fwi/fwi_kernel.h"
+#include "fwi/fwi_codec.h"
+
+
+TEST_GROUP(codec);
+
+TEST_SETUP(codec)
+{
+    nelems = dimmz * dimmx * dimmy;
+}
+
+TEST_TEAR_DOWN(codec)
+{
+}
+
+/* a smooth wave packet, as the snapshots */
+static void fill_wave ( real *field, const real phase )
+{
+    for (integer y = 0; y < dimmy; y++)
+        for (integer x = 0; x < dimmx; x++)
+            for (integer z = 0; z < dimmz; z++)
+                field[IDX(z,x,y,dimmz,dimmx)] = 1e3f * sinf(0.3f * z + phase) * cosf(0.2f * x) * expf(-0.01f * y * y);
+}
+
+static real max_error ( const real *a, const real *b, const box_t box )
+{
+    real error = 0.f;
+
+    for (integer y = box.y0; y < box.yf; y++)
+        for (integer x = box.x0; x < box.xf; x++)
+            for (integer z = box.z0; z < box.zf; z++)
+            {
+                const integer i = IDX(z,x,y,dimmz,dimmx);
+                if ( fabsf(a[i] - b[i]) > error ) error = fabsf(a[i] - b[i]);
+            }
+
+    return error;
+}
+
+TEST(codec, fixed_rate_chunks)
+{
+    real     *field  = (real*)     __malloc(ALIGN_REAL, nelems * sizeof(real));
+    real     *result = (real*)     __malloc(ALIGN_REAL, nelems * sizeof(real));
+    uint64_t *stream = (uint64_t*) __malloc(ALIGN_REAL, nelems * sizeof(real));
+
+    fill_wave(field, 0.f);
+    set_array_to_constant(result, 0.f, nelems);
+
+    /* partial blocks along every axis */
+    const box_t chunk = { 1, dimmz - 2, 2, dimmx - 1, 3, 6 };
+
+    for (int rate = 4; rate <= 16; rate *= 2)
+    {
+        const codec_t codec = { CODEC_RATE, rate, 0 };
+        const size_t  bytes = codec_encode_chunk(&codec, field, chunk, dimmz, dimmx, stream);
+
+        /* sizes are fixed by the rate */
+        TEST_ASSERT_EQUAL_INT( codec_chunk_bound(&codec, chunk.zf - chunk.z0, chunk.xf - chunk.x0), bytes );
+
+        codec_decode_chunk(&codec, stream, result, chunk, dimmz, dimmx);
+
+        /* the error halves with every bit of rate */
+        TEST_ASSERT_TRUE( max_error(field, result, chunk) < ldexpf(1e3f, -4 - rate) );
+    }
+
+    /* cells out of the chunk are not touched */
+    TEST_ASSERT_EQUAL_FLOAT( 0.f, result[IDX(0, 0, 0, dimmz, dimmx)] );
+    TEST_ASSERT_EQUAL_FLOAT( 0.f, result[IDX(chunk.z0, chunk.x0, chunk.yf, dimmz, dimmx)] );
+
+    __free(field);
+    __free(result);
+    __free(stream);
+}
+
+TEST(codec, tolerance)
+{
+    real     *field  = (real*)     __malloc(ALIGN_REAL, nelems * sizeof(real));
+    real     *result = (real*)     __malloc(ALIGN_REAL, nelems * sizeof(real));
+    uint64_t *stream = (uint64_t*) __malloc(ALIGN_REAL, nelems * sizeof(real) * 2);
+
+    fill_wave(field, 0.5f);
+
+    const box_t chunk = { 0, dimmz, 0, dimmx, 0, 4 };
+
+    setenv("FWI_SNAPSHOT_TOLERANCE", "3", 1);
+    codec_t codec;
+    TEST_ASSERT_TRUE( codec_from_env(&codec) );
+    TEST_ASSERT_EQUAL_INT( CODEC_PRECISION, codec.mode );
+    unsetenv("FWI_SNAPSHOT_TOLERANCE");
+
+    const size_t bytes = codec_encode_chunk(&codec, field, chunk, dimmz, dimmx, stream);
+    codec_decode_chunk(&codec, stream, result, chunk, dimmz, dimmx);
+
+    /* 1e-3 of the largest value, in a fraction of the raw values */
+    TEST_ASSERT_TRUE( max_error(field, result, chunk) <= 1.f );
+    TEST_ASSERT_TRUE( bytes < box_cells(chunk) * sizeof(real) / 4 );
+
+    __free(field);
+    __free(result);
+    __free(stream);
+}
+
+TEST(codec, lossless)
+{
+    real     *field  = (real*)     __malloc(ALIGN_REAL, nelems * sizeof(real));
+    real     *result = (real*)     __malloc(ALIGN_REAL, nelems * sizeof(real));
+    uint64_t *stream = (uint64_t*) __malloc(ALIGN_REAL, nelems * sizeof(real) * 2);
+
+    /* the front has only reached the first quarter */
+    fill_wave(field, 0.f);
+    for (integer y = 0; y < dimmy; y++)
+        for (integer x = 0; x < dimmx; x++)
+            for (integer z = dimmz / 4; z < dimmz; z++)
+                field[IDX(z,x,y,dimmz,dimmx)] = 0.f;
+
+    set_array_to_constant(result, 0.f, nelems);
+
+    const box_t   chunk = { 1, dimmz - 1, 0, dimmx, 2, 6 };
+    const codec_t codec = { CODEC_LOSSLESS, 0, 0 };
+
+    const size_t bytes = codec_encode_chunk(&codec, field, chunk, dimmz, dimmx, stream);
+    TEST_ASSERT_TRUE( bytes <= codec_chunk_bound(&codec, chunk.zf - chunk.z0, chunk.xf - chunk.x0) );
+    TEST_ASSERT_TRUE( bytes < box_cells(chunk) * sizeof(real) / 2 );
+
+    codec_decode_chunk(&codec, stream, result, chunk, dimmz, dimmx);
+
+    /* the same bits */
+    for (integer y = chunk.y0; y < chunk.yf; y++)
+        for (integer x = chunk.x0; x < chunk.xf; x++)
+            TEST_ASSERT_EQUAL_MEMORY( &field [IDX(chunk.z0,x,y,dimmz,dimmx)],
+                                      &result[IDX(chunk.z0,x,y,dimmz,dimmx)],
+                                      (chunk.zf - chunk.z0) * sizeof(real) );
+
+    /* noise does not compress, it is stored as it is */
+    set_array_to_random_real(field, nelems);
+    TEST_ASSERT_TRUE( codec_encode_chunk(&codec, field, chunk, dimmz, dimmx, stream)
+                      <= codec_chunk_bound(&codec, chunk.zf - chunk.z0, chunk.xf - chunk.x0) );
+    codec_decode_chunk(&codec, stream, result, chunk, dimmz, dimmx);
+    TEST_ASSERT_EQUAL_MEMORY( &field [IDX(chunk.z0,0,chunk.y0,dimmz,dimmx)],
+                              &result[IDX(chunk.z0,0,chunk.y0,dimmz,dimmx)],
+                              (chunk.zf - chunk.z0) * sizeof(real) );
+
+    __free(field);
+    __free(result);
+    __free(stream);
+}
+
+TEST(codec, write_read_volumes)
+{
+#if defined(USE_MPI)
+    TEST_IGNORE_MESSAGE("domain_setup needs MPI to be initialized");
+#elif defined(DO_NOT_PERFORM_IO)
+    TEST_IGNORE_MESSAGE("IO is disabled in this build");
+#endif
+    domain_t d;
+    domain_setup(&d, dimmz, dimmx, dimmy);
+
+    real *volumes = (real*) __malloc(ALIGN_REAL, 2 * nelems * sizeof(real));
+    real *results = (real*) __malloc(ALIGN_REAL, 2 * nelems * sizeof(real));
+    real *fields[2] = { volumes, volumes + nelems };
+    real *read  [2] = { results, results + nelems };
+
+    fill_wave(fields[0], 0.f);
+    fill_wave(fields[1], 1.f);
+    set_array_to_constant(results, 0.f, 2 * nelems);
+
+    const codec_t codec = { CODEC_RATE, 12, 0 };
+    codec_write_volumes(&codec, "/tmp/fwi_codec_test.bin", fields, 2, &d);
+    codec_read_volumes("/tmp/fwi_codec_test.bin", read, 2, &d);
+
+    /* a single process owns every cell */
+    const box_t all = domain_local_box(&d);
+    TEST_ASSERT_TRUE( max_error(fields[0], read[0], all) < 1.f );
+    TEST_ASSERT_TRUE( max_error(fields[1], read[1], all) < 1.f );
+
+    unlink("/tmp/fwi_codec_test.bin");
+    __free(volumes);
+    __free(results);
+    domain_release(&d);
+}
+
+////// TESTS RUNNER //////
+TEST_GROUP_RUNNER(codec)
+{
+    RUN_TEST_CASE(codec, fixed_rate_chunks);
+    RUN_TEST_CASE(codec, tolerance);
+    RUN_TEST_CASE(codec, lossless);
+    RUN_TEST_CASE(codec, write_read_volumes);
+}
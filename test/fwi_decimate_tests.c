@@ -0,0 +1,129 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#include "test/fwi_tests.h"
+
+#include <unity.h>
+#include <unity_fixture.h>
+
+#include "fwi/fwi_kernel.h"
+#include "fwi/fwi_decimate.h"
+
+
+TEST_GROUP(decimate);
+
+TEST_SETUP(decimate)
+{
+    nelems = dimmz * dimmx * dimmy;
+}
+
+TEST_TEAR_DOWN(decimate)
+{
+}
+
+TEST(decimate, coarse_cells)
+{
+    /* the last fine cell is always a coarse one */
+    TEST_ASSERT_EQUAL_INT( 5, decimate_coarse_cells(9, 2) );
+    TEST_ASSERT_EQUAL_INT( 6, decimate_coarse_cells(10, 2) );
+    TEST_ASSERT_EQUAL_INT( 4, decimate_coarse_cells(10, 3) );
+
+    integer factor;
+    setenv("FWI_SNAPSHOT_DECIMATION", "1", 1);
+    TEST_ASSERT_FALSE( decimate_from_env(&factor) );
+    setenv("FWI_SNAPSHOT_DECIMATION", "2", 1);
+    TEST_ASSERT_TRUE( decimate_from_env(&factor) );
+    TEST_ASSERT_EQUAL_INT( 2, factor );
+    unsetenv("FWI_SNAPSHOT_DECIMATION");
+}
+
+TEST(decimate, write_read_volumes)
+{
+#if defined(USE_MPI)
+    TEST_IGNORE_MESSAGE("domain_setup needs MPI to be initialized");
+#elif defined(DO_NOT_PERFORM_IO)
+    TEST_IGNORE_MESSAGE("IO is disabled in this build");
+#endif
+    domain_t d;
+    domain_setup(&d, dimmz, dimmx, dimmy);
+
+    real *volumes = (real*) __malloc(ALIGN_REAL, 2 * nelems * sizeof(real));
+    real *results = (real*) __malloc(ALIGN_REAL, 2 * nelems * sizeof(real));
+    real *fields[2] = { volumes, volumes + nelems };
+    real *read  [2] = { results, results + nelems };
+
+    /* a linear field, and a wave of 32 cells per wavelength */
+    for (integer y = 0; y < dimmy; y++)
+        for (integer x = 0; x < dimmx; x++)
+            for (integer z = 0; z < dimmz; z++)
+            {
+                fields[0][IDX(z,x,y,dimmz,dimmx)] = 1.f + 0.5f * z - 0.25f * x + 0.125f * y;
+                fields[1][IDX(z,x,y,dimmz,dimmx)] = sinf(0.196f * z + 0.3f) * cosf(0.1f * x);
+            }
+
+    decimate_write_volumes(2, "/tmp/fwi_decimate_test.bin", fields, 2, &d);
+    decimate_read_volumes (2, "/tmp/fwi_decimate_test.bin", read,   2, &d);
+
+    /* a quarter of the cells are stored */
+    FILE *stream = fopen("/tmp/fwi_decimate_test.bin", "rb");
+    fseek(stream, 0, SEEK_END);
+    TEST_ASSERT_EQUAL_INT( decimate_coarse_cells(dimmz, 2) * decimate_coarse_cells(dimmx, 2)
+                         * decimate_coarse_cells(dimmy, 2) * 2 * sizeof(real), ftell(stream) );
+    fclose(stream);
+
+    /* away from the boundary, linear fields come back as they were and
+     * smooth ones within a few percent */
+    real linear = 0.f, wave = 0.f;
+
+    for (integer y = HALO; y < dimmy - HALO; y++)
+        for (integer x = HALO; x < dimmx - HALO; x++)
+            for (integer z = HALO; z < dimmz - HALO; z++)
+            {
+                const integer i = IDX(z,x,y,dimmz,dimmx);
+                linear = fmaxf(linear, fabsf(fields[0][i] - read[0][i]));
+                wave   = fmaxf(wave,   fabsf(fields[1][i] - read[1][i]));
+            }
+
+    TEST_ASSERT_FLOAT_WITHIN( 1e-4f, 0.f, linear );
+    TEST_ASSERT_TRUE( wave < 0.05f );
+
+    unlink("/tmp/fwi_decimate_test.bin");
+    __free(volumes);
+    __free(results);
+    domain_release(&d);
+}
+
+////// TESTS RUNNER //////
+
+TEST_GROUP_RUNNER(decimate)
+{
+    RUN_TEST_CASE(decimate, coarse_cells);
+    RUN_TEST_CASE(decimate, write_read_volumes);
+}
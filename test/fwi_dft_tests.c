@@ -0,0 +1,130 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#include "test/fwi_tests.h"
+
+#include <unity.h>
+#include <unity_fixture.h>
+
+#include "fwi/fwi_dft.h"
+
+
+TEST_GROUP(dft);
+
+TEST_SETUP(dft)
+{
+}
+
+TEST_TEAR_DOWN(dft)
+{
+}
+
+TEST(dft, frequencies)
+{
+    dft_t dft;
+
+    dft_setup(&dft, 3, 10.f, 0.001f, 1, 4);
+    TEST_ASSERT_FLOAT_WITHIN( 1e-3f, 2.f * 3.14159265f *  5.f, dft.omega[0] );
+    TEST_ASSERT_FLOAT_WITHIN( 1e-3f, 2.f * 3.14159265f * 10.f, dft.omega[1] );
+    TEST_ASSERT_FLOAT_WITHIN( 1e-3f, 2.f * 3.14159265f * 15.f, dft.omega[2] );
+    dft_release(&dft);
+
+    dft_setup(&dft, 1, 10.f, 0.001f, 1, 4);
+    TEST_ASSERT_FLOAT_WITHIN( 1e-3f, 2.f * 3.14159265f * 10.f, dft.omega[0] );
+    dft_release(&dft);
+}
+
+TEST(dft, image_of_tones)
+{
+    /* 0.5, 1 and 1.5 Hz, whole periods of all of them in 4 seconds */
+    const integer ncells   = 3000;
+    const int     nsamples = 400;
+    const real    dt       = 0.01f;
+    const real    duration = nsamples * dt;
+
+    dft_t forward, backward;
+    dft_setup(&forward,  3, 1.f, dt, 2, ncells);
+    dft_setup(&backward, 3, 1.f, dt, 2, ncells);
+
+    real *volumes = (real*) __malloc(ALIGN_REAL, 4 * ncells * sizeof(real));
+    real *image   = (real*) __malloc(ALIGN_REAL, 4 * ncells * sizeof(real));
+    real *power   = image + 2 * ncells;
+    real *f[2]    = { volumes,              volumes +     ncells };
+    real *b[2]    = { volumes + 2 * ncells, volumes + 3 * ncells };
+
+    const real w = forward.omega[1];
+
+    for (int n = 0; n < nsamples; n++)
+    {
+        const real t = n * dt;
+
+        /* a tone at 1 Hz, late by a phase in the backward wavefield, and
+         * tones of the other frequencies that do not correlate with it */
+        for (integer i = 0; i < ncells; i++)
+        {
+            f[0][i] = cosf(w * t);
+            b[0][i] = cosf(w * t + 0.5f);
+            f[1][i] = cosf(w * t) + sinf(forward.omega[0] * t);
+            b[1][i] = cosf(forward.omega[2] * t);
+        }
+
+        dft_accumulate(&forward,  f, t);
+        dft_accumulate(&backward, b, t);
+    }
+
+    memset(image, 0, 4 * ncells * sizeof(real));
+    dft_image(&forward, &backward, image, power);
+
+    const real expected = duration * duration / 4.f * cosf(0.5f);
+    const real tone     = duration * duration / 4.f;
+
+    for (integer i = 0; i < ncells; i += 997)
+    {
+        TEST_ASSERT_FLOAT_WITHIN( 1e-3f * expected, expected, image[i] );
+        TEST_ASSERT_FLOAT_WITHIN( 1e-3f * expected, 0.f, image[ncells + i] );
+
+        /* one tone in the first field, two in the second one */
+        TEST_ASSERT_FLOAT_WITHIN( 1e-3f * tone, tone,       power[i] );
+        TEST_ASSERT_FLOAT_WITHIN( 1e-3f * tone, 2.f * tone, power[ncells + i] );
+    }
+
+    __free(volumes);
+    __free(image);
+    dft_release(&forward);
+    dft_release(&backward);
+}
+
+////// TESTS RUNNER //////
+
+TEST_GROUP_RUNNER(dft)
+{
+    RUN_TEST_CASE(dft, frequencies);
+    RUN_TEST_CASE(dft, image_of_tones);
+}
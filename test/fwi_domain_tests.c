@@ -0,0 +1,196 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+#include "test/fwi_tests.h"
+
+#include <unity.h>
+#include <unity_fixture.h>
+
+#include "fwi/fwi_domain.h"
+
+
+TEST_GROUP(domain);
+
+TEST_SETUP(domain)
+{
+    nelems = dimmz * dimmx * dimmy;
+}
+
+TEST_TEAR_DOWN(domain)
+{
+}
+
+TEST(domain, single_process_limits)
+{
+#if defined(USE_MPI)
+    TEST_IGNORE_MESSAGE("domain_setup needs MPI to be initialized");
+#endif
+    domain_t d;
+    domain_setup(&d, dimmz, dimmx, dimmy);
+
+    TEST_ASSERT_EQUAL_INT( nelems, domain_local_cells(&d) );
+    TEST_ASSERT_EQUAL_INT( 0, d.y0 );
+
+    /* a single process owns its outer HALO cells too */
+    const box_t owned = domain_owned_box(&d);
+    TEST_ASSERT_EQUAL_INT( nelems, box_cells(owned) );
+
+    /* only the y slabs (phases ONE_L/ONE_R) are peeled */
+    const box_t compute = { HALO, dimmz-HALO, HALO, dimmx-HALO, HALO, dimmy-HALO };
+    box_t slabs[NFACES], interior;
+
+    TEST_ASSERT_EQUAL_INT( 2, domain_split_box(&d, compute, slabs, &interior) );
+    TEST_ASSERT_EQUAL_INT( HALO,         slabs[0].y0 );
+    TEST_ASSERT_EQUAL_INT( 2*HALO,       slabs[0].yf );
+    TEST_ASSERT_EQUAL_INT( dimmy-2*HALO, slabs[1].y0 );
+    TEST_ASSERT_EQUAL_INT( dimmy-HALO,   slabs[1].yf );
+    TEST_ASSERT_EQUAL_INT( 2*HALO,       interior.y0 );
+    TEST_ASSERT_EQUAL_INT( dimmy-2*HALO, interior.yf );
+    TEST_ASSERT_EQUAL_INT( HALO,         interior.x0 );
+    TEST_ASSERT_EQUAL_INT( dimmz-HALO,   interior.zf );
+
+    domain_release(&d);
+}
+
+TEST(domain, pack_unpack_roundtrip)
+{
+    real *field  = (real*) __malloc(ALIGN_REAL, nelems * sizeof(real));
+    real *result = (real*) __malloc(ALIGN_REAL, nelems * sizeof(real));
+    real *buffer = (real*) __malloc(ALIGN_REAL, nelems * sizeof(real));
+
+    init_array(field, nelems);
+    memset(result, 0, nelems * sizeof(real));
+
+    /* a z face: strided runs of HALO cells */
+    const box_t b = { dimmz-2*HALO, dimmz-HALO, HALO, dimmx-HALO, HALO, dimmy-HALO };
+
+    TEST_ASSERT_EQUAL_INT( box_cells(b), pack_box(buffer, field, b, dimmz, dimmx) );
+    TEST_ASSERT_EQUAL_INT( box_cells(b), unpack_box(result, buffer, b, dimmz, dimmx) );
+
+    for (integer y = 0; y < dimmy; y++)
+    for (integer x = 0; x < dimmx; x++)
+    for (integer z = 0; z < dimmz; z++)
+    {
+        const int inside = (z >= b.z0 && z < b.zf && x >= b.x0 && x < b.xf && y >= b.y0 && y < b.yf);
+        const integer i = IDX(z, x, y, dimmz, dimmx);
+
+        TEST_ASSERT_EQUAL_FLOAT( (inside) ? field[i] : 0.0f, result[i] );
+    }
+
+    __free(field);
+    __free(result);
+    __free(buffer);
+}
+
+TEST(domain, face_boxes_planes)
+{
+    domain_t d;
+    d.dimmz = dimmz;
+    d.dimmx = dimmx;
+    d.dimmy = dimmy;
+
+    box_t send, recv;
+
+    /* y- face: the first interior planes go, the innermost ghosts come */
+    domain_face_boxes(&d, 2*AXIS_Y, HALO-1, 2, &send, &recv);
+    TEST_ASSERT_EQUAL_INT( HALO,          send.y0 );
+    TEST_ASSERT_EQUAL_INT( 2*HALO-1,      send.yf );
+    TEST_ASSERT_EQUAL_INT( HALO-2,        recv.y0 );
+    TEST_ASSERT_EQUAL_INT( HALO,          recv.yf );
+    TEST_ASSERT_EQUAL_INT( HALO,          send.x0 );
+    TEST_ASSERT_EQUAL_INT( dimmz-HALO,    recv.zf );
+
+    /* x+ face, nothing to receive */
+    domain_face_boxes(&d, 2*AXIS_X+1, HALO, 0, &send, &recv);
+    TEST_ASSERT_EQUAL_INT( dimmx-2*HALO,  send.x0 );
+    TEST_ASSERT_EQUAL_INT( dimmx-HALO,    send.xf );
+    TEST_ASSERT_EQUAL_INT( 0,             box_cells(recv) );
+}
+
+TEST(domain, balance_planes)
+{
+    /* a process row twice as fast gets twice the planes */
+    const double rates[3] = { 1.0, 2.0, 1.0 };
+    integer planes[3];
+
+    domain_balance_planes(64, 3, rates, planes);
+    TEST_ASSERT_EQUAL_INT( 64, planes[0] + planes[1] + planes[2] );
+    TEST_ASSERT_EQUAL_INT( 32, planes[1] );
+    TEST_ASSERT_EQUAL_INT( 16, planes[0] );
+
+    /* but never less than what the stencils need */
+    const double skewed[3] = { 0.01, 1.0, 1.0 };
+
+    domain_balance_planes(64, 3, skewed, planes);
+    TEST_ASSERT_EQUAL_INT( 64,     planes[0] + planes[1] + planes[2] );
+    TEST_ASSERT_EQUAL_INT( 2*HALO, planes[0] );
+}
+
+TEST(domain, write_read_box)
+{
+#if defined(USE_MPI)
+    TEST_IGNORE_MESSAGE("domain_setup needs MPI to be initialized");
+#elif defined(DO_NOT_PERFORM_IO)
+    TEST_IGNORE_MESSAGE("IO is disabled in this build");
+#endif
+    domain_t d;
+    domain_setup(&d, dimmz, dimmx, dimmy);
+
+    real *field  = (real*) __malloc(ALIGN_REAL, nelems * sizeof(real));
+    real *result = (real*) __malloc(ALIGN_REAL, nelems * sizeof(real));
+    init_array(field, nelems);
+
+    /* second volume of the file, so that the volume offset is exercised */
+    const char *fname = "/tmp/fwi_domain_test.bin";
+    io_file_t file;
+
+    io_open_backend(&file, IO_STDIO, fname, 1, 2 * nelems * sizeof(real));
+    domain_write_box(&file, 1, field, &d, domain_owned_box(&d));
+    io_close(&file);
+
+    io_open_backend(&file, IO_STDIO, fname, 0, 0);
+    domain_read_box (&file, 1, result, &d, domain_local_box(&d));
+    io_close(&file);
+    unlink(fname);
+
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( field, result, nelems );
+
+    __free(field);
+    __free(result);
+    domain_release(&d);
+}
+
+////// TESTS RUNNER //////
+TEST_GROUP_RUNNER(domain)
+{
+    RUN_TEST_CASE(domain, single_process_limits);
+    RUN_TEST_CASE(domain, pack_unpack_roundtrip);
+    RUN_TEST_CASE(domain, face_boxes_planes);
+    RUN_TEST_CASE(domain, balance_planes);
+    RUN_TEST_CASE(domain, write_read_box);
+}
@@ -0,0 +1,102 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+#include "test/fwi_tests.h"
+
+#include <unity.h>
+#include <unity_fixture.h>
+
+#include "fwi/fwi_gradient.h"
+
+
+TEST_GROUP(gradient);
+
+TEST_SETUP(gradient)
+{
+    nelems = dimmz * dimmx * dimmy;
+}
+
+TEST_TEAR_DOWN(gradient)
+{
+}
+
+TEST(gradient, accumulate_shots)
+{
+#if defined(USE_MPI)
+    TEST_IGNORE_MESSAGE("gradient_setup needs MPI to be initialized");
+#endif
+    sched_t sched;
+    sched_load_geometry(NULL, &sched.nshots, &sched.shots);
+
+    gradient_t g;
+    gradient_setup(&g, &sched, dimmz, dimmx, dimmy, "/tmp", 1.0);
+
+    TEST_ASSERT_EQUAL_INT( nelems, g.ncells );
+
+    const integer n = nelems * WRITTEN_FIELDS;
+    real *gradient = (real*) __malloc(ALIGN_REAL, n * sizeof(real));
+    real *precond  = (real*) __malloc(ALIGN_REAL, n * sizeof(real));
+    real *expected = (real*) __malloc(ALIGN_REAL, n * sizeof(real));
+
+    init_array(gradient, n);
+    for (integer i = 0; i < n; i++)
+    {
+        precond [i] = 1.0;
+        expected[i] = 2.0 * gradient[i];
+    }
+
+    gradient_accumulate(&g, &g.domain, gradient, precond);
+    gradient_accumulate(&g, &g.domain, gradient, precond);
+
+    TEST_ASSERT_EQUAL_INT( 2, g.shots );
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( expected, g.gradient, n );
+
+    for (integer i = 0; i < n; i++)
+        expected[i] = 2.0;
+
+    CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( expected, g.precond, n );
+
+    /* nothing to reduce among groups in a single process */
+    gradient_reduce(&g);
+    TEST_ASSERT_EQUAL_INT( 2, g.total );
+
+    __free(g.gradient);
+    __free(g.precond);
+    domain_release(&g.domain);
+
+    __free(gradient);
+    __free(precond);
+    __free(expected);
+    __free(sched.shots);
+}
+
+////// TESTS RUNNER //////
+TEST_GROUP_RUNNER(gradient)
+{
+    RUN_TEST_CASE(gradient, accumulate_shots);
+}
@@ -0,0 +1,142 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+#include "test/fwi_tests.h"
+
+#include <unity.h>
+#include <unity_fixture.h>
+
+#include "fwi/fwi_imaging.h"
+
+
+TEST_GROUP(imaging);
+
+TEST_SETUP(imaging)
+{
+}
+
+TEST_TEAR_DOWN(imaging)
+{
+}
+
+TEST(imaging, forward_fields)
+{
+    const integer ncells = 100;
+
+    real *fields  = (real*) __malloc(ALIGN_REAL, 2 * ncells * sizeof(real));
+    real *mine[2] = { fields, fields + ncells };
+
+    imaging_t im;
+
+    /* without fields of the caller they live in a buffer */
+    imaging_setup(&im, 2, ncells, 0.1f, NULL, NULL, NULL);
+    TEST_ASSERT_NOT_NULL( im.buffer );
+    TEST_ASSERT_EQUAL_PTR( im.buffer,          im.forward[0] );
+    TEST_ASSERT_EQUAL_PTR( im.buffer + ncells, im.forward[1] );
+    imaging_release(&im);
+
+    imaging_setup(&im, 2, ncells, 0.1f, NULL, NULL, mine);
+    TEST_ASSERT_NULL( im.buffer );
+    TEST_ASSERT_EQUAL_PTR( mine[0], im.forward[0] );
+    TEST_ASSERT_EQUAL_PTR( mine[1], im.forward[1] );
+    imaging_release(&im);
+
+    __free(fields);
+}
+
+TEST(imaging, accumulate)
+{
+    /* not a multiple of the blocks */
+    const integer ncells = 5000;
+    const real    dt     = 0.5f;
+
+    real *volumes = (real*) __malloc(ALIGN_REAL, 8 * ncells * sizeof(real));
+    real *fw[2]   = { volumes,              volumes +     ncells };
+    real *bw[2]   = { volumes + 2 * ncells, volumes + 3 * ncells };
+    real *image   = volumes + 4 * ncells;
+    real *power   = volumes + 6 * ncells;
+
+    memset(image, 0, 4 * ncells * sizeof(real));
+
+    imaging_t im;
+    imaging_setup(&im, 1, ncells, dt, image, power, NULL);
+
+    for (int t = 0; t < 2; t++)
+    {
+        for (integer i = 0; i < ncells; i++)
+        {
+            im.forward[0][i] = (real) (i % 7) + t;
+            bw[0][i]         = (real) (i % 5) - t;
+        }
+
+        imaging_accumulate(&im, bw);
+    }
+
+    for (integer i = 0; i < ncells; i++)
+    {
+        const real f0 = (real) (i % 7), f1 = f0 + 1.f;
+        const real b0 = (real) (i % 5), b1 = b0 - 1.f;
+
+        TEST_ASSERT_EQUAL_FLOAT( (f0 * b0 + f1 * b1) * dt, image[i] );
+        TEST_ASSERT_EQUAL_FLOAT( (f0 * f0 + f1 * f1) * dt, power[i] );
+    }
+
+    imaging_release(&im);
+
+    /* the forward fields of the caller, two of them */
+    memset(image, 0, 4 * ncells * sizeof(real));
+    imaging_setup(&im, 2, ncells, dt, image, power, fw);
+
+    for (integer i = 0; i < ncells; i++)
+    {
+        fw[0][i] = 2.f; bw[0][i] = 3.f;
+        fw[1][i] = 1.f; bw[1][i] = -1.f;
+    }
+    imaging_accumulate(&im, bw);
+
+    for (integer i = 0; i < ncells; i += 1013)
+    {
+        /* a volume per field */
+        TEST_ASSERT_EQUAL_FLOAT(  6.f * dt, image[i] );
+        TEST_ASSERT_EQUAL_FLOAT( -1.f * dt, image[ncells + i] );
+        TEST_ASSERT_EQUAL_FLOAT(  4.f * dt, power[i] );
+        TEST_ASSERT_EQUAL_FLOAT(  1.f * dt, power[ncells + i] );
+    }
+
+    imaging_release(&im);
+    __free(volumes);
+}
+
+////// TESTS RUNNER //////
+
+TEST_GROUP_RUNNER(imaging)
+{
+    RUN_TEST_CASE(imaging, forward_fields);
+    RUN_TEST_CASE(imaging, accumulate);
+}
@@ -0,0 +1,167 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#include "test/fwi_tests.h"
+
+#include <unity.h>
+#include <unity_fixture.h>
+
+#include "fwi/fwi_io.h"
+
+
+TEST_GROUP(io);
+
+TEST_SETUP(io)
+{
+}
+
+TEST_TEAR_DOWN(io)
+{
+}
+
+TEST(io, round_trip)
+{
+    char fname[64];
+    sprintf(fname, "/tmp/fwi_io_test.%d.bin", (int) getpid());
+
+    /* more than a staging buffer, neither end aligned */
+    const size_t bytes = IO_DIRECT_BUFFER + 3 * IO_DIRECT_ALIGN + 123;
+    const size_t cut   = IO_DIRECT_BUFFER + 5000;
+
+    char *data   = (char*) __malloc(ALIGN_REAL, bytes);
+    char *result = (char*) __malloc(ALIGN_REAL, bytes);
+
+    for (size_t i = 0; i < bytes; i++)
+        data[i] = (char) (i * 31 + i / 4096);
+
+#if defined(USE_MPI)
+    /* the O_DIRECT fallback is logged, which needs MPI to be initialized */
+    const int nbackends = 2;
+#else
+    const int nbackends = 3;
+#endif
+    const int backends[3] = { IO_STDIO, IO_POSIX, IO_DIRECT };
+
+    for (int b = 0; b < nbackends; b++)
+    {
+        io_stats_t before, after;
+        io_stats(backends[b], &before);
+
+        io_file_t file;
+
+        /* out of order */
+        io_open_backend(&file, backends[b], fname, 1, bytes);
+        io_write(&file, data + cut, bytes - cut, cut);
+        io_write(&file, data + 100, cut - 100, 100);
+        io_write(&file, data, 100, 0);
+        io_close(&file);
+
+        memset(result, 0, bytes);
+
+        io_open_backend(&file, backends[b], fname, 0, 0);
+        io_read(&file, result + 7, bytes - 7, 7);
+        io_read(&file, result, 7, 0);
+        io_close(&file);
+
+        TEST_ASSERT_EQUAL_MEMORY( data, result, bytes );
+
+        io_stats(backends[b], &after);
+        TEST_ASSERT_EQUAL_INT( 3, after.writes - before.writes );
+        TEST_ASSERT_EQUAL_INT( 2, after.reads  - before.reads  );
+        TEST_ASSERT_EQUAL_FLOAT( (double) bytes, after.written - before.written );
+        TEST_ASSERT_EQUAL_FLOAT( (double) bytes, after.read    - before.read    );
+    }
+
+    unlink(fname);
+
+    __free(data);
+    __free(result);
+}
+
+TEST(io, null_sink)
+{
+    char fname[64];
+    sprintf(fname, "/tmp/fwi_io_null.%d.bin", (int) getpid());
+
+    real values[64];
+    for (int i = 0; i < 64; i++) values[i] = (real) i + 1.f;
+
+    unlink(fname);
+
+    io_file_t file;
+    io_open_backend(&file, IO_NULL, fname, 1, sizeof(values));
+    io_write(&file, values, sizeof(values), 0);
+    io_close(&file);
+
+    /* nothing was created */
+    TEST_ASSERT_EQUAL_INT( -1, access(fname, F_OK) );
+
+    io_open_backend(&file, IO_NULL, fname, 0, 0);
+    io_read(&file, values, sizeof(values), 0);
+    io_close(&file);
+
+    for (int i = 0; i < 64; i++)
+        TEST_ASSERT_EQUAL_FLOAT( 0.f, values[i] );
+}
+
+TEST(io, backend_from_env)
+{
+#if defined(DO_NOT_PERFORM_IO)
+    TEST_ASSERT_EQUAL_INT( IO_NULL, io_backend() );
+#else
+    setenv("FWI_IO_BACKEND", "2", 1);
+    TEST_ASSERT_EQUAL_INT( IO_DIRECT, io_backend() );
+
+    unsetenv("FWI_IO_BACKEND");
+    TEST_ASSERT_EQUAL_INT( IO_STDIO, io_backend() );
+#endif
+}
+
+TEST(io, unknown_backend)
+{
+#if defined(USE_MPI)
+    TEST_IGNORE_MESSAGE("the fallback is logged, which needs MPI to be initialized");
+#elif defined(DO_NOT_PERFORM_IO)
+    TEST_IGNORE_MESSAGE("IO is disabled in this build");
+#endif
+    /* unknown values fall back to stdio */
+    setenv("FWI_IO_BACKEND", "9", 1);
+    TEST_ASSERT_EQUAL_INT( IO_STDIO, io_backend() );
+    unsetenv("FWI_IO_BACKEND");
+}
+
+////// TESTS RUNNER //////
+TEST_GROUP_RUNNER(io)
+{
+    RUN_TEST_CASE(io, round_trip);
+    RUN_TEST_CASE(io, null_sink);
+    RUN_TEST_CASE(io, backend_from_env);
+    RUN_TEST_CASE(io, unknown_backend);
+}
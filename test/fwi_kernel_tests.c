@@ -224,9 +224,53 @@ TEST(kernel, set_array_to_constant)
     TEST_ASSERT_EQUAL_FLOAT_ARRAY( array_ref, array_cal, NELEMS );
 }
 
+TEST(kernel, random_boundary_layer)
+{
+#if defined(USE_MPI)
+    TEST_IGNORE_MESSAGE("domain_setup needs MPI to be initialized");
+#endif
+    domain_t d;
+    domain_setup(&d, dimmz, dimmx, dimmy);
+
+    const integer width = 3;
+
+    set_array_to_constant( c_cal.c11, 1.0, nelems );
+    set_array_to_constant( c_cal.c66, 1.0, nelems );
+    random_boundary_layer( &d, &c_cal, width );
+
+    int randomized = 0;
+
+    for (integer y = 0; y < dimmy; y++)
+        for (integer x = 0; x < dimmx; x++)
+            for (integer z = 0; z < dimmz; z++)
+            {
+                const integer i = IDX(z,x,y,dimmz,dimmx);
+                const int inner = ( z >= HALO + width && z < dimmz - HALO - width &&
+                                    x >= HALO + width && x < dimmx - HALO - width &&
+                                    y >= HALO + width && y < dimmy - HALO - width );
+
+                /* every coefficient of a cell gets the same factor */
+                TEST_ASSERT_EQUAL_FLOAT( c_cal.c11[i], c_cal.c66[i] );
+
+                if ( inner )
+                    TEST_ASSERT_EQUAL_FLOAT( 1.0, c_cal.c11[i] );
+                else
+                {
+                    const real vmin = 1.f - RANDOM_BOUNDARY_AMPLITUDE;
+                    TEST_ASSERT_TRUE( c_cal.c11[i] <= 1.f && c_cal.c11[i] >= vmin * vmin );
+                    randomized += ( c_cal.c11[i] < 1.f );
+                }
+            }
+
+    TEST_ASSERT_TRUE( randomized > 0 );
+
+    domain_release(&d);
+}
+
 ////// TESTS RUNNER //////
 TEST_GROUP_RUNNER(kernel)
 {
     RUN_TEST_CASE(kernel, set_array_to_random_real);
     RUN_TEST_CASE(kernel, set_array_to_constant);
+    RUN_TEST_CASE(kernel, random_boundary_layer);
 }
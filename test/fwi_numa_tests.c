@@ -0,0 +1,157 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+#include "test/fwi_tests.h"
+
+#include <unity.h>
+#include <unity_fixture.h>
+
+#include "fwi/fwi_numa.h"
+
+
+TEST_GROUP(numa);
+
+TEST_SETUP(numa)
+{
+    nelems = dimmz * dimmx * dimmy;
+
+    alloc_memory_shot(nelems, &c_ref, &s_ref, &v_ref, &rho_ref);
+    alloc_memory_shot(nelems, &c_cal, &s_cal, &v_cal, &rho_cal);
+
+    real *cr[COEFF_FIELDS],    *cc[COEFF_FIELDS];
+    real *vr[VELOCITY_FIELDS], *vc[VELOCITY_FIELDS];
+    real *sr[STRESS_FIELDS],   *sc[STRESS_FIELDS];
+
+    coeff_field_list   (&c_ref, cr); coeff_field_list   (&c_cal, cc);
+    velocity_field_list(&v_ref, vr); velocity_field_list(&v_cal, vc);
+    stress_field_list  (&s_ref, sr); stress_field_list  (&s_cal, sc);
+
+    /* start from equal solutions */
+    for (int f = 0; f < COEFF_FIELDS; f++) {
+        init_array(cr[f], nelems);
+        copy_array(cc[f], cr[f], nelems);
+    }
+    for (int f = 0; f < VELOCITY_FIELDS; f++) {
+        init_array(vr[f], nelems);
+        copy_array(vc[f], vr[f], nelems);
+    }
+    for (int f = 0; f < STRESS_FIELDS; f++) {
+        init_array(sr[f], nelems);
+        copy_array(sc[f], sr[f], nelems);
+    }
+    init_array(rho_ref, nelems);
+    copy_array(rho_cal, rho_ref, nelems);
+}
+
+TEST_TEAR_DOWN(numa)
+{
+    free_memory_shot(&c_ref, &s_ref, &v_ref, &rho_ref);
+    free_memory_shot(&c_cal, &s_cal, &v_cal, &rho_cal);
+}
+
+TEST(numa, setup_limits)
+{
+#if defined(USE_MPI)
+    TEST_IGNORE_MESSAGE("NUMA sub-domains are disabled in MPI builds");
+#endif
+    TEST_ASSERT_TRUE( numa_setup(v_cal, s_cal, c_cal, rho_cal, 0, dimmy, dimmz, dimmx, 1) == NULL );
+
+    /* 8 interior planes can only feed two sub-domains of HALO planes */
+    numa_t *numa = numa_setup(v_cal, s_cal, c_cal, rho_cal, 0, dimmy, dimmz, dimmx, 3);
+
+    TEST_ASSERT_TRUE( numa != NULL );
+    TEST_ASSERT_EQUAL_INT( 2, numa->ndomains );
+    TEST_ASSERT_EQUAL_INT( 0,               numa->domains[0].y0 );
+    TEST_ASSERT_EQUAL_INT( (dimmy-2*HALO)/2, numa->domains[1].y0 );
+    TEST_ASSERT_EQUAL_INT( (dimmy-2*HALO)/2 + 2*HALO, numa->domains[1].nplanes );
+
+    numa_release(numa);
+}
+
+TEST(numa, propagation_matches_single_domain)
+{
+#if defined(USE_MPI)
+    TEST_IGNORE_MESSAGE("NUMA sub-domains are disabled in MPI builds");
+#endif
+    const real     dt  = 1.0;
+    const real     dzi = 1.0;
+    const real     dxi = 1.0;
+    const real     dyi = 1.0;
+    const integer  nz0 = HALO;
+    const integer  nzf = dimmz-HALO;
+    const integer  nx0 = HALO;
+    const integer  nxf = dimmx-HALO;
+    const integer  timesteps = 2;
+
+    // REFERENCE CALCULATION
+    for (int t = 0; t < timesteps; t++)
+    {
+        velocity_propagator(v_ref, s_ref, c_ref, rho_ref, dt, dzi, dxi, dyi,
+                nz0, nzf, nx0, nxf, HALO, dimmy-HALO, dimmz, dimmx, TWO);
+
+        stress_propagator(s_ref, v_ref, c_ref, rho_ref, dt, dzi, dxi, dyi,
+                nz0, nzf, nx0, nxf, HALO, dimmy-HALO, dimmz, dimmx, TWO);
+    }
+    ///////////////////////////////////////
+
+    {
+        numa_t *numa = numa_setup(v_cal, s_cal, c_cal, rho_cal, 0, dimmy, dimmz, dimmx, 2);
+
+        for (int t = 0; t < timesteps; t++)
+        {
+            numa_velocity_propagator(numa, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf);
+            numa_exchange_velocity_halos(numa);
+
+            numa_stress_propagator(numa, dt, dzi, dxi, dyi, nz0, nzf, nx0, nxf);
+            numa_exchange_stress_halos(numa);
+        }
+
+        numa_gather_velocity(numa, v_cal);
+        numa_gather_stress  (numa, s_cal);
+        numa_release(numa);
+    }
+
+    real *vr[VELOCITY_FIELDS], *vc[VELOCITY_FIELDS];
+    real *sr[STRESS_FIELDS],   *sc[STRESS_FIELDS];
+
+    velocity_field_list(&v_ref, vr); velocity_field_list(&v_cal, vc);
+    stress_field_list  (&s_ref, sr); stress_field_list  (&s_cal, sc);
+
+    for (int f = 0; f < VELOCITY_FIELDS; f++)
+        CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( vr[f], vc[f], nelems );
+
+    for (int f = 0; f < STRESS_FIELDS; f++)
+        CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( sr[f], sc[f], nelems );
+}
+
+////// TESTS RUNNER //////
+TEST_GROUP_RUNNER(numa)
+{
+    RUN_TEST_CASE(numa, setup_limits);
+    RUN_TEST_CASE(numa, propagation_matches_single_domain);
+}
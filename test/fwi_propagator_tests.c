@@ -1193,6 +1193,55 @@ TEST(propagator, stress_propagator)
     CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( s_ref.tr.xy, s_cal.tr.xy, nelems );
 }
 
+TEST(propagator, velocity_propagator_reads)
+{
+    stencil_read_t reads[PROPAGATOR_STENCIL_READS];
+    velocity_propagator_reads(s_ref, reads);
+
+    /* d/dy is only applied to the yz, xy and yy components */
+    const point_s_t nodes[4] = { s_ref.tl, s_ref.tr, s_ref.bl, s_ref.br };
+
+    for (int n = 0; n < 4; n++)
+    {
+        int yreads = 0, zzreads = 0;
+
+        for (int r = 0; r < PROPAGATOR_STENCIL_READS; r++)
+        {
+            if ( reads[r].axis != AXIS_Y ) continue;
+
+            if ( reads[r].field == nodes[n].yz || reads[r].field == nodes[n].xy ||
+                 reads[r].field == nodes[n].yy ) yreads++;
+            if ( reads[r].field == nodes[n].zz || reads[r].field == nodes[n].xz ||
+                 reads[r].field == nodes[n].xx ) zzreads++;
+        }
+
+        TEST_ASSERT_EQUAL_INT( 3, yreads  );
+        TEST_ASSERT_EQUAL_INT( 0, zzreads );
+    }
+}
+
+TEST(propagator, stress_propagator_reads)
+{
+    stencil_read_t reads[PROPAGATOR_STENCIL_READS];
+    stress_propagator_reads(v_ref, reads);
+
+    /* every velocity component is differentiated once along each axis */
+    real *fields[VELOCITY_FIELDS];
+    velocity_field_list(&v_ref, fields);
+
+    for (int f = 0; f < VELOCITY_FIELDS; f++)
+    {
+        int axes[3] = { 0, 0, 0 };
+
+        for (int r = 0; r < PROPAGATOR_STENCIL_READS; r++)
+            if ( reads[r].field == fields[f] ) axes[ reads[r].axis ]++;
+
+        TEST_ASSERT_EQUAL_INT( 1, axes[AXIS_Y] );
+        TEST_ASSERT_EQUAL_INT( 1, axes[AXIS_X] );
+        TEST_ASSERT_EQUAL_INT( 1, axes[AXIS_Z] );
+    }
+}
+
 ////// TESTS RUNNER //////
 TEST_GROUP_RUNNER(propagator)
 {
@@ -1234,4 +1283,7 @@ TEST_GROUP_RUNNER(propagator)
     RUN_TEST_CASE(propagator, compute_component_scell_BL);
 
     RUN_TEST_CASE(propagator, stress_propagator);
+
+    RUN_TEST_CASE(propagator, velocity_propagator_reads);
+    RUN_TEST_CASE(propagator, stress_propagator_reads);
 }
@@ -0,0 +1,142 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+
+
+#include "test/fwi_tests.h"
+
+#include <unity.h>
+#include <unity_fixture.h>
+
+#include "fwi/fwi_revolve.h"
+
+
+TEST_GROUP(revolve);
+
+TEST_SETUP(revolve)
+{
+}
+
+TEST_TEAR_DOWN(revolve)
+{
+}
+
+/* fewest intervals computed forward, by exhaustive search of the splits */
+static int fewest_advances ( const int n, const int s )
+{
+    static int cost[64][8];
+
+    for (int k = 1; k <= n; k++)
+        for (int j = 0; j <= s; j++)
+        {
+            if ( k == 1 ) { cost[k][j] = 0; continue; }
+            if ( j == 0 ) { cost[k][j] = k * (k - 1) / 2; continue; }
+
+            cost[k][j] = cost[k][j-1];
+            for (int m = 1; m < k; m++)
+                if ( m + cost[k-m][j-1] + cost[m][j] < cost[k][j] )
+                    cost[k][j] = m + cost[k-m][j-1] + cost[m][j];
+        }
+
+    return cost[n][s];
+}
+
+TEST(revolve, valid_schedule)
+{
+    int state[8];
+
+    for (int nslots = 1; nslots <= 5; nslots++)
+        for (int nsteps = 1; nsteps <= 40; nsteps++)
+        {
+            revolve_t r;
+            revolve_setup(&r, nsteps, nslots);
+
+            int at   = 0;
+            int next = nsteps - 1;
+
+            for (int i = 0; i < nslots; i++) state[i] = -1;
+
+            for (int i = 0; i < r.nactions; i++)
+            {
+                const revolve_action_t *action = &r.actions[i];
+
+                switch ( action->kind )
+                {
+                case( REVOLVE_ADVANCE ):
+                    TEST_ASSERT_EQUAL_INT( at, action->from );
+                    TEST_ASSERT_TRUE( action->to > at && action->to < nsteps );
+                    at = action->to;
+                    break;
+                case( REVOLVE_TAKESHOT ):
+                    TEST_ASSERT_TRUE( action->slot >= 0 && action->slot < nslots );
+                    state[ action->slot ] = at;
+                    break;
+                case( REVOLVE_RESTORE ):
+                    TEST_ASSERT_EQUAL_INT( action->from, state[ action->slot ] );
+                    at = action->from;
+                    break;
+                default:
+                    /* every state once, the last one first */
+                    TEST_ASSERT_EQUAL_INT( next, action->from );
+                    TEST_ASSERT_EQUAL_INT( at,   action->from );
+                    next--;
+                }
+            }
+
+            TEST_ASSERT_EQUAL_INT( -1, next );
+            revolve_release(&r);
+        }
+}
+
+TEST(revolve, fewest_advances)
+{
+    for (int nslots = 1; nslots <= 6; nslots++)
+        for (int nsteps = 1; nsteps <= 60; nsteps++)
+        {
+            revolve_t r;
+            revolve_setup(&r, nsteps, nslots);
+
+            TEST_ASSERT_EQUAL_INT( fewest_advances(nsteps, nslots - 1), r.advances );
+
+            revolve_release(&r);
+        }
+
+    /* a slot per interval: computed once, as when every snapshot is stored */
+    revolve_t r;
+    revolve_setup(&r, 25, 25);
+    TEST_ASSERT_EQUAL_INT( 24, r.advances );
+    TEST_ASSERT_EQUAL_INT(  1, r.repetitions );
+    revolve_release(&r);
+}
+
+////// TESTS RUNNER //////
+TEST_GROUP_RUNNER(revolve)
+{
+    RUN_TEST_CASE(revolve, valid_schedule);
+    RUN_TEST_CASE(revolve, fewest_advances);
+}
@@ -0,0 +1,91 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+#include "test/fwi_tests.h"
+
+#include <unity.h>
+#include <unity_fixture.h>
+
+#include "fwi/fwi_sched.h"
+
+
+TEST_GROUP(sched);
+
+TEST_SETUP(sched)
+{
+}
+
+TEST_TEAR_DOWN(sched)
+{
+}
+
+TEST(sched, default_geometry)
+{
+    int     nshots;
+    shot_t *shots;
+
+    sched_load_geometry(NULL, &nshots, &shots);
+
+    TEST_ASSERT_EQUAL_INT( 1, nshots );
+    TEST_ASSERT_EQUAL_FLOAT( 0.0, shots[0].z );
+    TEST_ASSERT_EQUAL_FLOAT( 0.0, shots[0].x );
+    TEST_ASSERT_EQUAL_FLOAT( 0.0, shots[0].y );
+
+    __free(shots);
+}
+
+TEST(sched, load_geometry)
+{
+    char fname[] = "/tmp/fwi_sched_test_XXXXXX";
+    const int fd = mkstemp(fname);
+    TEST_ASSERT_TRUE( fd >= 0 );
+
+    FILE* stream = fdopen(fd, "w");
+    fprintf(stream, "10.0 20.0 30.0\n40.5 50.5 60.5\n\n70 80 90\n");
+    fclose(stream);
+
+    int     nshots;
+    shot_t *shots;
+
+    sched_load_geometry(fname, &nshots, &shots);
+    unlink(fname);
+
+    TEST_ASSERT_EQUAL_INT( 3, nshots );
+    TEST_ASSERT_EQUAL_FLOAT( 10.0, shots[0].z );
+    TEST_ASSERT_EQUAL_FLOAT( 50.5, shots[1].x );
+    TEST_ASSERT_EQUAL_FLOAT( 90.0, shots[2].y );
+
+    __free(shots);
+}
+
+////// TESTS RUNNER //////
+TEST_GROUP_RUNNER(sched)
+{
+    RUN_TEST_CASE(sched, default_geometry);
+    RUN_TEST_CASE(sched, load_geometry);
+}
@@ -0,0 +1,225 @@
+/*
+ * =============================================================================
+ * Copyright (c) 2016, Barcelona Supercomputing Center (BSC)
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * =============================================================================
+ */
+#include "test/fwi_tests.h"
+
+#include <unity.h>
+#include <unity_fixture.h>
+
+#include "fwi/fwi_kernel.h"
+
+
+TEST_GROUP(snapshot);
+
+TEST_SETUP(snapshot)
+{
+    nelems = dimmz * dimmx * dimmy;
+}
+
+TEST_TEAR_DOWN(snapshot)
+{
+}
+
+static void fill_snapshot ( real* fields[VELOCITY_FIELDS], const int suffix )
+{
+    for (int f = 0; f < VELOCITY_FIELDS; f++)
+        set_array_to_constant( fields[f], suffix * 100 + f, nelems );
+}
+
+TEST(snapshot, lifo_eviction)
+{
+#if defined(USE_MPI)
+    TEST_IGNORE_MESSAGE("domain_setup needs MPI to be initialized");
+#elif defined(DO_NOT_PERFORM_IO)
+    TEST_IGNORE_MESSAGE("IO is disabled in this build");
+#endif
+    domain_t d;
+    domain_setup(&d, dimmz, dimmx, dimmy);
+
+    real *volumes = (real*) __malloc(ALIGN_REAL, nelems * VELOCITY_FIELDS * sizeof(real));
+    real *ref     = (real*) __malloc(ALIGN_REAL, nelems * sizeof(real));
+    real *fields[VELOCITY_FIELDS];
+    for (int f = 0; f < VELOCITY_FIELDS; f++)
+        fields[f] = volumes + f * nelems;
+
+    char folder[] = "/tmp";
+    snapshots_t store;
+    snapshots_setup(&store, folder, &d);
+
+    /* one snapshot in memory, the rest in scratch */
+    sprintf(store.scratch, "/tmp");
+    store.capacity[SNAPSHOT_MEMORY]  =  1;
+    store.capacity[SNAPSHOT_SCRATCH] = -1;
+
+    /* the lowest suffix is read last: every new snapshot evicts the previous one */
+    for (int suffix = 1; suffix <= 3; suffix++)
+    {
+        fill_snapshot(fields, suffix);
+        snapshots_put(&store, suffix, fields);
+    }
+
+    TEST_ASSERT_EQUAL_INT( 1, store.count[SNAPSHOT_MEMORY]  );
+    TEST_ASSERT_EQUAL_INT( 2, store.count[SNAPSHOT_SCRATCH] );
+    TEST_ASSERT_EQUAL_INT( 2, store.demoted );
+
+    for (int suffix = 3; suffix >= 1; suffix--)
+    {
+        set_array_to_constant(volumes, 0, nelems * VELOCITY_FIELDS);
+        snapshots_get(&store, suffix, fields);
+
+        for (int f = 0; f < VELOCITY_FIELDS; f++)
+        {
+            set_array_to_constant(ref, suffix * 100 + f, nelems);
+            CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( ref, fields[f], nelems );
+        }
+    }
+
+    TEST_ASSERT_EQUAL_INT( 0, store.nentries );
+
+    snapshots_release(&store);
+    __free(volumes);
+    __free(ref);
+    domain_release(&d);
+}
+
+TEST(snapshot, background_writer)
+{
+#if defined(USE_MPI)
+    TEST_IGNORE_MESSAGE("domain_setup needs MPI to be initialized");
+#endif
+    domain_t d;
+    domain_setup(&d, dimmz, dimmx, dimmy);
+
+    real *volumes = (real*) __malloc(ALIGN_REAL, nelems * VELOCITY_FIELDS * sizeof(real));
+    real *ref     = (real*) __malloc(ALIGN_REAL, nelems * sizeof(real));
+    real *fields[VELOCITY_FIELDS];
+    for (int f = 0; f < VELOCITY_FIELDS; f++)
+        fields[f] = volumes + f * nelems;
+
+    /* a single queue buffer: every put waits for the previous one */
+    char folder[] = "/tmp";
+    setenv("FWI_SNAPSHOT_WRITER", "1", 1);
+    snapshots_t store;
+    snapshots_setup(&store, folder, &d);
+    unsetenv("FWI_SNAPSHOT_WRITER");
+
+    TEST_ASSERT_EQUAL_INT( 1, store.depth );
+    store.capacity[SNAPSHOT_MEMORY] = 4;
+
+    for (int suffix = 4; suffix >= 1; suffix--)
+    {
+        fill_snapshot(fields, suffix);
+        snapshots_put(&store, suffix, fields);
+    }
+
+    /* the propagation may overwrite its arrays as soon as put returns */
+    set_array_to_constant(volumes, -1, nelems * VELOCITY_FIELDS);
+
+    for (int suffix = 4; suffix >= 1; suffix--)
+    {
+        snapshots_get(&store, suffix, fields);
+
+        for (int f = 0; f < VELOCITY_FIELDS; f++)
+        {
+            set_array_to_constant(ref, suffix * 100 + f, nelems);
+            CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( ref, fields[f], nelems );
+        }
+    }
+
+    TEST_ASSERT_EQUAL_INT( 4, store.stored[SNAPSHOT_MEMORY] );
+    TEST_ASSERT_TRUE( store.maxqueued <= 1 );
+
+    snapshots_release(&store);
+    __free(volumes);
+    __free(ref);
+    domain_release(&d);
+}
+
+TEST(snapshot, prefetch)
+{
+#if defined(USE_MPI)
+    TEST_IGNORE_MESSAGE("domain_setup needs MPI to be initialized");
+#elif defined(DO_NOT_PERFORM_IO)
+    TEST_IGNORE_MESSAGE("IO is disabled in this build");
+#endif
+    domain_t d;
+    domain_setup(&d, dimmz, dimmx, dimmy);
+
+    real *volumes = (real*) __malloc(ALIGN_REAL, nelems * VELOCITY_FIELDS * sizeof(real));
+    real *ref     = (real*) __malloc(ALIGN_REAL, nelems * sizeof(real));
+    real *fields[VELOCITY_FIELDS];
+    for (int f = 0; f < VELOCITY_FIELDS; f++)
+        fields[f] = volumes + f * nelems;
+
+    char folder[] = "/tmp";
+    setenv("FWI_SNAPSHOT_PREFETCH", "2", 1);
+    snapshots_t store;
+    snapshots_setup(&store, folder, &d);
+    unsetenv("FWI_SNAPSHOT_PREFETCH");
+
+    TEST_ASSERT_EQUAL_INT( 2, store.ahead );
+
+    /* the highest suffix in memory, the rest are staged from scratch */
+    sprintf(store.scratch, "/tmp");
+    store.capacity[SNAPSHOT_MEMORY]  =  1;
+    store.capacity[SNAPSHOT_SCRATCH] = -1;
+
+    for (int suffix = 5; suffix >= 1; suffix--)
+    {
+        fill_snapshot(fields, suffix);
+        snapshots_put(&store, suffix, fields);
+    }
+
+    for (int suffix = 5; suffix >= 1; suffix--)
+    {
+        set_array_to_constant(volumes, 0, nelems * VELOCITY_FIELDS);
+        snapshots_get(&store, suffix, fields);
+
+        for (int f = 0; f < VELOCITY_FIELDS; f++)
+        {
+            set_array_to_constant(ref, suffix * 100 + f, nelems);
+            CUSTOM_ASSERT_EQUAL_FLOAT_ARRAY( ref, fields[f], nelems );
+        }
+    }
+
+    TEST_ASSERT_EQUAL_INT( 4, store.hits + store.waits );
+    TEST_ASSERT_EQUAL_INT( 0, store.nentries );
+
+    snapshots_release(&store);
+    __free(volumes);
+    __free(ref);
+    domain_release(&d);
+}
+
+////// TESTS RUNNER //////
+TEST_GROUP_RUNNER(snapshot)
+{
+    RUN_TEST_CASE(snapshot, lifo_eviction);
+    RUN_TEST_CASE(snapshot, background_writer);
+    RUN_TEST_CASE(snapshot, prefetch);
+}
@@ -115,6 +115,18 @@ static void run_all_tests(void)
     RUN_TEST_GROUP(common);
     RUN_TEST_GROUP(propagator);
     RUN_TEST_GROUP(kernel);
+    RUN_TEST_GROUP(numa);
+    RUN_TEST_GROUP(domain);
+    RUN_TEST_GROUP(sched);
+    RUN_TEST_GROUP(gradient);
+    RUN_TEST_GROUP(snapshot);
+    RUN_TEST_GROUP(revolve);
+    RUN_TEST_GROUP(boundary);
+    RUN_TEST_GROUP(codec);
+    RUN_TEST_GROUP(decimate);
+    RUN_TEST_GROUP(dft);
+    RUN_TEST_GROUP(imaging);
+    RUN_TEST_GROUP(io);
 }
 
 int main(int argc, const char* argv[])